@@ -6,18 +6,18 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <set>
 
 
 
 #include "Commons.h"
-
-namespace tinyxml2
-{
-	class XMLNode;
-};
+#include "MemoryUsage.h"
+#include "Hash.h"
 
 namespace dfp
 {
+    class XmlNode;
+    class XmlDocument;
     class Anim;
     class Cell;
     class CellSpr;
@@ -40,9 +40,19 @@ namespace dfp
     *       </cell>
     *   </anim>
     * </animations>
-    *------------------------------------------------------------*/
+    *------------------------------------------------------------
+    * Thread safety: after ParseFile/ParseText returned, all the const
+    * functions (GetAnim, GetAnims, GetSpriteFileName...) can be called from
+    * many threads at the same time without locks. They never change the
+    * animations. Do not call ParseFile/ParseText or operator= while other
+    * threads read, use a SnapshotHolder to swap in reloaded content.
+    * Each Anim returned by GetAnim is a new instance, so it belongs to the
+    * caller and can be updated without locks.*/
     class Animations
     {
+        friend class AnimationsParseTask;
+        friend class AnimationsStreamParser;
+        friend class ParseCache;
     public:
 
         /** The (default) constructor */
@@ -64,19 +74,34 @@ namespace dfp
         * animations. The path is relative to the *.anim file location.
         * @param onlyFileName used to specify if we want only the filename, or the filename withthe path.
         * @return a string with path and filename of the sprite.*/
-        std::string GetSpriteFileName(bool onlyFileName = false);
+        std::string GetSpriteFileName(bool onlyFileName = false) const;
 
         /** Get the text for latest error!
         * @return a string with a text that describe the error.*/
-        std::string GetErrorText();
+        std::string GetErrorText() const;
 
         /** Getter for an Anim. This will return a new shared pointer.
         * Do not use this too often. I will create a new instance each time
         * you call it. Also the animations are stored in a map which is not so 
         * fast => So use it only to load the animations, not to draw them.
+        * A name that is not found will not change the animations.
         * @param animName is the animation name.
         * @return an shared pointer to an Anim, OR a null shared pointer*/
-		std::shared_ptr<Anim> GetAnim(const std::string& animName);
+		std::shared_ptr<Anim> GetAnim(const std::string& animName) const;
+
+		/** Same as GetAnim(const std::string&), but the anim is found by the
+		* hash of the name, without any string compare. The ids of all the
+		* anims are checked for collisions when the file is parsed, a name
+		* of GetIdCollisions is not found by id.
+		* @param id is the id of the name (ex: dfp::AnimId("Walk")).
+		* @return an shared pointer to an Anim, OR a null shared pointer*/
+		std::shared_ptr<Anim> GetAnim(AnimId id) const;
+
+		/** Getter for the anim names that have the same AnimId as another
+		* name. They are rare (the id is a 32 bit hash) and are found only
+		* with GetAnim(const std::string&).
+		* @return the names, empty if there is no collision.*/
+		const std::vector<std::string>& GetIdCollisions() const;
 
         /** Read a file and parse it.
         * Note: use '/' instead of '\\' as it is using '/' to find the path.
@@ -89,12 +114,74 @@ namespace dfp
         * @return ParseResult::OK if everithing was fine, or an error code!*/
         ParseResult ParseText(const std::string &text);
 
+        /** Same as ParseText(const std::string&), without a copy of the text.
+        * @param text is the xml, it does not need to be null terminated.
+        * @param size is the size of the text in bytes.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseText(const char *text, size_t size);
+
+        /** Parse a file that is already in memory (from a bundle, a network
+        * packet...). The fileName is used only to compute the path, like in ParseFile.
+        * @param data is the content of the file.
+        * @param size is the size of the data in bytes.
+        * @param fileName is the filename and path of the file.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseBuffer(const char *data, size_t size, const std::string &fileName);
+
 
 		std::map< std::string, std::shared_ptr<Anim> >& GetAnims();
 
+		/** Read only getter for all the anims. Safe to call from many threads. */
+		const std::map< std::string, std::shared_ptr<Anim> >& GetAnims() const;
+
+		/** Get an estimation of the memory used by these animations, by node
+		* type and by category. It is computed once, at the end of the parsing,
+		* so it is cheap to call. The Anim instances returned by GetAnim are
+		* not counted, but the cells they share with this document are.
+		* @return the report.*/
+		MemoryUsage GetMemoryUsage() const;
+
+		/** Share the identical cells between all the anims. The CellSpr with
+		* the same name, x, y and z become one shared object, then the cells
+		* with the same delay, index and list of CellSpr become one shared Cell.
+		* The cells are never changed after the parsing, so the anims can share
+		* them. The Anim instances already returned by GetAnim keep the old cells,
+		* and no Cell or CellSpr is changed: a cell is copied when it must use
+		* the shared CellSpr, then the list of cells of each anim is replaced.
+		* Not thread safe: call it after the parsing, not while other threads
+		* read the anims of GetAnims (the copies from GetAnim can be used).
+		* @param ignoreIndex if true, the cells with different index are shared
+		*        too (Cell::GetIndex will return the index of one of them).
+		* @return the number of bytes saved, from GetMemoryUsage. */
+		size_t DeduplicateCells(bool ignoreIndex = false);
+
 
     private:
 
+        /** Set m_animationPath from the path of the *.anim file */
+        void SetFilePath(const std::string &fileName);
+
+        /** Walk the anims and update m_memoryUsage */
+        void ComputeMemoryUsage();
+
+        /** Fill m_animIndex, m_animById and m_idCollisions from m_anim.
+        * @return ParseResult::OK, 2 names with the same id are not an error.*/
+        ParseResult BuildIndex();
+
+        /** Check the parsed document and read the attributes of <animations>.
+        * @param doc is the parsed document.
+        * @param firstChild will be the first child of <animations>.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseRoot(const XmlDocument &doc, XmlNode &firstChild);
+
+        /** Read the attributes of <animations>, not the childs.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseRootAttributes(const XmlNode &imgElem);
+
+        /** Parse one child of <animations>, the <anim> nodes are added to m_anim.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseChild(const XmlNode &node);
+
         /** Is the text for latest error */
         std::string m_errorText;
         
@@ -112,6 +199,18 @@ namespace dfp
         * of pair (Anim name, Anim instance)*/
         std::map< std::string, std::shared_ptr<Anim> > m_anim;
 
+        /** The memory report, computed by ComputeMemoryUsage */
+        MemoryUsage m_memoryUsage;
+
+        /** All the anims, in the order of m_anim */
+        std::vector< std::shared_ptr<Anim> > m_animById;
+
+        /** Pair (AnimId, index in m_animById) */
+        HashIndex m_animIndex;
+
+        /** The names that are not in m_animIndex, see GetIdCollisions */
+        std::vector<std::string> m_idCollisions;
+
     };
 
 
@@ -125,11 +224,33 @@ namespace dfp
     *       <cell index = "1" delay = "4">
     *           <spr name = "/broun/10" x = "0" y = "0" z = "0" / >
     *       </cell>
-    *   </anim>*/
+    *   </anim>
+    * Thread safety: the const functions can be called from many threads,
+    * but Update changes the instance, so one instance must be updated
+    * only by one thread at a time.*/
     class Anim
     {
+        friend class Animations;
+        friend class AnimationsStreamParser;
+        friend class Recorder;
+        friend class ParseCache;
     public:
 
+        /** The kind of timing of an Anim, found when it is parsed. Update
+        * has one code path for each kind. */
+        enum Playback
+        {
+            /** 0 or 1 cell, Update does nothing */
+            PLAYBACK_STATIC = 0,
+
+            /** All the cells have the same delay, Update moves to the new
+            * cell with one division, no matter how many cells are skipped */
+            PLAYBACK_UNIFORM,
+
+            /** The cells have different delays, Update walks the cells */
+            PLAYBACK_VARIABLE,
+        };
+
         /** The constructor */
         Anim();
 
@@ -145,16 +266,19 @@ namespace dfp
 		Anim& operator=(const Anim& other);
 
         /** Getter for the name of the node. */
-        std::string GetName();
+        std::string GetName() const;
+
+        /** Getter for the attribute loops. */
+        int GetLoops() const;
 
         /** Get the text for latest error!
         * @return a string with a text that describe the error.*/
-        std::string GetErrorText();
+        std::string GetErrorText() const;
 
         /** Parse text containing spr XML node.
         * @param dataNode is the xml node for <anim name = "Animation" loops = "0"> .
         * @return ParseResult::OK if everithing was fine, or an error code! */
-        ParseResult ParseXML(const tinyxml2::XMLNode *dataNode);
+        ParseResult ParseXML(const XmlNode &dataNode);
 
 
         /**
@@ -168,11 +292,34 @@ namespace dfp
 
         /** Use this to get the current cell, aka the frame of animation. 
         * The return value is changed by the Update function.
-        * @return a shared pointerto an Cell instance.*/
-		std::shared_ptr<Cell> GetCurrentCell();
+        * @return a shared pointerto an Cell instance, or nullptr if there
+        *         is no cell (or the cells were removed since the last Update).*/
+		std::shared_ptr<Cell> GetCurrentCell() const;
+
+        /** Getter for the index of the current cell in GetCells().
+        * Cheaper than GetCurrentCell, there is no shared pointer copy.
+        * It is used by the library too, so it is not recorded (see Recorder). */
+        uint32_t GetCurrentCellIndex() const;
         
 		std::vector< std::shared_ptr<Cell> >& GetCells();
 
+		/** Read only getter for all the cells. */
+		const std::vector< std::shared_ptr<Cell> >& GetCells() const;
+
+        /** Getter for the kind of timing, used by Update. */
+        Playback GetPlayback() const;
+
+        /** Find the kind of timing from the cells. It is done by ParseXML,
+        * and by Update when the number of cells changed. Call it again if
+        * the cells or their delays are changed in place. */
+        void ClassifyPlayback();
+
+        /** Add the memory used by this Anim and its cells to a report.
+        * @param usage is the report.
+        * @param visited are the cells and cellspr already counted, because
+        *        they can be shared by many anims. */
+        void AddMemoryUsage(MemoryUsage& usage, std::set<const void*>& visited) const;
+
     protected:
 
         /** Is the text for latest error */
@@ -192,6 +339,24 @@ namespace dfp
 
         /** This is the time elapsed from the last Update call */
         float m_timestampLastChange;
+
+        /** The kind of timing, from ClassifyPlayback */
+        Playback m_playback;
+
+        /** The delay of each cell in milliseconds. Update reads them here
+        * instead of through the Cell pointers. */
+        std::vector<uint32_t> m_cellDelay;
+
+    private:
+
+        /** The cell loop of Update, for PLAYBACK_UNIFORM or PLAYBACK_VARIABLE */
+        template <Playback PLAYBACK>
+        void UpdateCells(float dtSeconds, float animSpeedFactor);
+
+        /** The recording of this instance (see Recorder), 0 if it is not
+        * recorded. The copies are not recorded. */
+        uint32_t m_recordSession;
+        uint32_t m_recordId;
     };
 
 
@@ -204,6 +369,9 @@ namespace dfp
     *       </cell>*/
     class Cell
     {
+        friend class Animations;
+        friend class AnimationsStreamParser;
+        friend class ParseCache;
     public:
 
         /** The constructor */
@@ -212,23 +380,28 @@ namespace dfp
 		~Cell();
 
         /** Getter for the Index */
-        unsigned int GetIndex();
+        unsigned int GetIndex() const;
 
         /** Getter for the Delay */
-        unsigned int GetDelay();
+        unsigned int GetDelay() const;
 
         /** Get the text for latest error!
         * @return a string with a text that describe the error.*/
-        std::string GetErrorText();
+        std::string GetErrorText() const;
 
         /** Parse text containing spr XML node.
         * @param dataNode is the xml node for <cell index = "0" delay = "4"> .
         * @return ParseResult::OK if everithing was fine, or an error code! */
-        ParseResult ParseXML(const tinyxml2::XMLNode *dataNode);
+        ParseResult ParseXML(const XmlNode &dataNode);
 
         /** Getter for the vector with all cellspr from a cell. 
         * @return a reference to the vector with CellSpr shared pointers. */
-        const std::vector< std::shared_ptr<CellSpr> >& GetCellsSpr();
+        const std::vector< std::shared_ptr<CellSpr> >& GetCellsSpr() const;
+
+        /** Add the memory used by this Cell and its cellspr to a report.
+        * @param usage is the report.
+        * @param visited are the cellspr already counted. */
+        void AddMemoryUsage(MemoryUsage& usage, std::set<const void*>& visited) const;
 
     protected:
 
@@ -252,6 +425,7 @@ namespace dfp
     *   <spr name = "/broun/2" x = "0" y = "0" z = "0" / >*/
     class CellSpr
     {
+        friend class ParseCache;
     public:
 
         /** The constructor*/
@@ -260,25 +434,29 @@ namespace dfp
 		~CellSpr();
 
         /** Getter for the name of the node. */
-        std::string GetName();
+        std::string GetName() const;
 
         /** Getter for the sprite x */
-        int GetX();
+        int GetX() const;
 
         /** Getter for the sprite y */
-        int GetY();
+        int GetY() const;
 
         /** Getter for the sprite z */
-        int GetZ();
+        int GetZ() const;
 
         /** Get the text for latest error!
         * @return a string with a text that describe the error.*/
-        std::string GetErrorText();
+        std::string GetErrorText() const;
 
         /** Parse text containing spr XML node.
         * @param dataNode is the xml node for <spr name = "/broun/2" x = "0" y = "0" z = "0" / > .
         * @return ParseResult::OK if everithing was fine, or an error code! */
-        ParseResult ParseXML(const tinyxml2::XMLNode *dataNode);
+        ParseResult ParseXML(const XmlNode &dataNode);
+
+        /** Add the memory used by this CellSpr to a report.
+        * @param usage is the report. */
+        void AddMemoryUsage(MemoryUsage& usage) const;
 
     protected:
 
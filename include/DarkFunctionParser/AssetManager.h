@@ -0,0 +1,174 @@
+#ifndef DFP_ASSETMANAGER_H
+#define DFP_ASSETMANAGER_H
+
+#include <cstdint>
+#include <string>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "Commons.h"
+
+namespace dfp
+{
+    class Sprite;
+    class Animations;
+    class Bundle;
+
+    /** This class keeps the parsed Sprite and Animations documents, so a
+    * file is parsed only once, and removes the least recently used ones
+    * when the memory used is bigger than a budget. The size of a document
+    * is the one from GetMemoryUsage.
+    * A document is pinned while the caller keeps a shared pointer to it:
+    * pinned documents are never removed, so the memory used can be bigger
+    * than the budget if all the documents are in use.
+    *   dfp::AssetManager assets(64 * 1024 * 1024);
+    *   std::shared_ptr<const dfp::Animations> hero;
+    *   if (assets.GetAnimations("data/hero.anim", hero) == dfp::ParseResult::OK) ...
+    * Thread safety: all the functions can be called from many threads.
+    * The files are parsed without holding the lock, so 2 threads that ask
+    * for the same new file at the same time can both parse it (only one
+    * copy is kept). */
+    class AssetManager
+    {
+    public:
+
+        /** The counters */
+        struct Stats
+        {
+            /** The documents found in the cache */
+            uint64_t hits;
+
+            /** The documents that had to be parsed */
+            uint64_t misses;
+
+            /** The documents removed to stay under the budget */
+            uint64_t evictions;
+
+            /** The files that could not be parsed */
+            uint64_t failures;
+
+            /** The number of documents in the cache */
+            size_t documentCount;
+
+            /** The number of documents in use (pinned) */
+            size_t pinnedCount;
+
+            /** The memory used by all the documents */
+            size_t usedBytes;
+
+            /** The budget */
+            size_t budgetBytes;
+        };
+
+        /** The constructor
+        * @param budgetBytes is the memory that can be used by the documents. */
+        AssetManager(size_t budgetBytes);
+
+        ~AssetManager();
+
+        /** Change the budget, the documents are removed if needed */
+        void SetBudget(size_t budgetBytes);
+
+        /** Getter for the budget */
+        size_t GetBudget() const;
+
+        /** Read the files from a bundle. The files that are not in the bundle
+        * are read from the disk. The bundle must live longer than the manager.
+        * @param bundle is the bundle, or null to read only from the disk. */
+        void SetBundle(const Bundle *bundle);
+
+        /** Get a *.sprites document, parse it if it is not in the cache.
+        * @param fileName is the filename and path of the file (the logical path in the bundle).
+        * @param sprite will be the document, or null if it fails.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult GetSprite(const std::string &fileName, std::shared_ptr<const Sprite> &sprite);
+
+        /** Get a *.anim document, parse it if it is not in the cache.
+        * @param fileName is the filename and path of the file (the logical path in the bundle).
+        * @param animations will be the document, or null if it fails.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult GetAnimations(const std::string &fileName, std::shared_ptr<const Animations> &animations);
+
+        /** Remove the documents that are not in use, from the least recently
+        * used, until the memory used is not bigger than the budget. This is
+        * done by GetSprite/GetAnimations too, call it when the game releases
+        * many documents at once (ex: at the end of a level). */
+        void Trim();
+
+        /** Remove all the documents that are not in use */
+        void Clear();
+
+        /** Getter for the counters */
+        Stats GetStats() const;
+
+        /** Set the hits, misses, evictions and failures to 0 */
+        void ResetStats();
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        std::string GetErrorText() const;
+
+    private:
+
+        AssetManager(const AssetManager&);
+        AssetManager& operator=(const AssetManager&);
+
+        /** One document */
+        struct Entry
+        {
+            /** The key: the file name, with a prefix for the type */
+            std::string key;
+
+            /** Only one of them is set */
+            std::shared_ptr<const Sprite> sprite;
+            std::shared_ptr<const Animations> animations;
+
+            /** The memory used */
+            size_t bytes;
+        };
+
+        typedef std::list<Entry> EntryList;
+
+        /** Find a document and move it to the front of the LRU list.
+        * The lock must be held.
+        * @return the entry or null */
+        Entry* Find(const std::string &key);
+
+        /** Add a document, or return the one added by another thread.
+        * The lock must be held. */
+        Entry& Insert(Entry &entry);
+
+        /** Remove documents until the budget is respected. The lock must be held. */
+        void Evict(size_t budgetBytes);
+
+        /** Check if the caller uses the document */
+        static bool IsPinned(const Entry &entry);
+
+        mutable std::mutex m_mutex;
+
+        /** The documents, the most recently used first */
+        EntryList m_entries;
+
+        /** Pair (key, entry) */
+        std::map<std::string, EntryList::iterator> m_index;
+
+        /** The optional bundle */
+        const Bundle *m_bundle;
+
+        size_t m_budgetBytes;
+        size_t m_usedBytes;
+
+        uint64_t m_hits;
+        uint64_t m_misses;
+        uint64_t m_evictions;
+        uint64_t m_failures;
+
+        /** Is the text for latest error */
+        std::string m_errorText;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_ASSETMANAGER_H
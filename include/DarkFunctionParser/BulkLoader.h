@@ -0,0 +1,113 @@
+#ifndef DFP_BULKLOADER_H
+#define DFP_BULKLOADER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Commons.h"
+
+namespace dfp
+{
+    class Sprite;
+    class Animations;
+
+    /** This class loads many files at once. ParseFile does one blocking
+    * open/read/close after the other, here the reads of many files are in
+    * flight at the same time and each file is parsed, on the calling
+    * thread, as soon as its read is done:
+    *   dfp::BulkLoader loader;
+    *   loader.Add("hero.sprites", heroSprite);
+    *   loader.Add("hero.anim", heroAnimations);
+    *   ...
+    *   if (loader.Load() != dfp::ParseResult::OK) ...
+    * On Linux, when the library is built with DFP_USE_IO_URING (link with
+    * liburing), the reads are submitted through one io_uring. Otherwise,
+    * or if the kernel does not allow io_uring or is older than Linux 5.6
+    * (no IORING_OP_READ), a few threads read the files with pread (fread
+    * on Windows).
+    * The documents must live until Load returns. */
+    class BulkLoader
+    {
+    public:
+
+        /** The constructor */
+        BulkLoader();
+
+        /** Setter for the number of reads in flight (default 64). It is
+        * also the max number of files in memory waiting to be parsed. */
+        void SetQueueDepth(uint32_t queueDepth);
+
+        /** Setter for the number of threads of the fallback (default 4). */
+        void SetThreadCount(uint32_t threadCount);
+
+        /** Add a file to load.
+        * Note: use '/' instead of '\\' as it is using '/' to find the path.
+        * @param fileName is the filename and path of the file (xml format).
+        * @param sprite is the document that will be filled. */
+        void Add(const std::string &fileName, Sprite &sprite);
+
+        /** Add a file to load.
+        * @param fileName is the filename and path of the file (xml format).
+        * @param animations is the document that will be filled. */
+        void Add(const std::string &fileName, Animations &animations);
+
+        /** Remove all the files */
+        void Clear();
+
+        /** Read and parse all the files.
+        * @return ParseResult::OK if all the files were fine, or the error
+        *         code of the first file that failed (see GetResult). */
+        ParseResult Load();
+
+        /** Getter for the number of files */
+        size_t GetCount() const;
+
+        /** Getter for the result of a file, valid after Load.
+        * @param index is the index of the file, in the order of Add. */
+        ParseResult GetResult(size_t index) const;
+
+        /** Get the text for the error of a file, valid after Load.
+        * @param index is the index of the file, in the order of Add. */
+        std::string GetErrorText(size_t index) const;
+
+        /** True if the latest Load used io_uring */
+        bool IsUsingIoUring() const;
+
+    private:
+
+        /** One file */
+        struct Item
+        {
+            std::string fileName;
+            Sprite *sprite;
+            Animations *animations;
+            ParseResult result;
+            std::string errorText;
+        };
+
+        /** Parse a file that is read */
+        void Complete(Item &item, const char *data, size_t size);
+
+        /** Stop a file with an error */
+        void Fail(Item &item, ParseResult result, const std::string &errorText);
+
+        /** Load with io_uring.
+        * @return false if the ring can not be created or can not read,
+        *         nothing is done. */
+        bool LoadIoUring();
+
+        /** Load with the reader threads */
+        void LoadThreads();
+
+        /** The files */
+        std::vector<Item> m_items;
+
+        uint32_t m_queueDepth;
+        uint32_t m_threadCount;
+        bool m_usingIoUring;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_BULKLOADER_H
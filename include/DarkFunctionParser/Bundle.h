@@ -0,0 +1,191 @@
+#ifndef DFP_BUNDLE_H
+#define DFP_BUNDLE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Commons.h"
+
+namespace dfp
+{
+    class Sprite;
+    class Animations;
+
+    /** This class is used to read many *.sprites and *.anim files packed
+    * in one file (see BundleWriter and the dfp-bundle tool).
+    * The bundle is mapped in memory once by Open (mmap / MapViewOfFile),
+    * so reading an entry does not need any other system call.
+    * Format (all the numbers are little endian):
+    *------------------------------------------------------------
+    *   header   : "DFPB", u32 version, u32 entryCount, u32 slotCount,
+    *              u64 entriesOffset, u64 slotsOffset
+    *   entries  : entryCount * (u32 pathHash, u32 pathOffset, u32 pathSize,
+    *              u32 flags, u64 dataOffset, u32 storedSize, u32 size)
+    *   slots    : slotCount * u32 (entry index + 1, 0 is empty), the table of
+    *              contents, open addressing with HashPath(path) & (slotCount - 1)
+    *   paths and data
+    *------------------------------------------------------------
+    * An entry with the flag BUNDLE_FLAG_LZ4 is compressed with LZ4 and can
+    * be read only when the library is built with DFP_USE_LZ4.
+    * Thread safety: after Open, all the const functions can be called from
+    * many threads at the same time, GetErrorText returns the latest error
+    * of any of them. */
+    class Bundle
+    {
+    public:
+
+        /** The entry is compressed with LZ4 */
+        static const uint32_t BUNDLE_FLAG_LZ4 = 1;
+
+        /** The constructor */
+        Bundle();
+
+        ~Bundle();
+
+        /** Map a bundle file in memory.
+        * @param fileName is the filename and path of the bundle.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult Open(const std::string &fileName);
+
+        /** Unmap the file. Called by the destructor. */
+        void Close();
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        std::string GetErrorText() const;
+
+        /** Getter for the number of entries */
+        uint32_t GetEntryCount() const;
+
+        /** Getter for the logical path of an entry */
+        std::string GetEntryPath(uint32_t index) const;
+
+        /** Check if an entry exists.
+        * @param path is the logical path, as it was added in the BundleWriter. */
+        bool Contains(const std::string &path) const;
+
+        /** Get the content of an entry. For an uncompressed entry the data
+        * points into the mapped file (no copy). For a compressed one, the
+        * data is unpacked in "scratch".
+        * @param path is the logical path.
+        * @param data will point to the content.
+        * @param size will be the size of the content.
+        * @param scratch is used as buffer for compressed entries.
+        * @return ParseResult::OK, ERROR_NOT_FOUND or ERROR_UNSUPPORTED.*/
+        ParseResult GetData(const std::string &path, const char *&data, size_t &size, std::vector<char> &scratch) const;
+
+        /** Parse a *.sprites entry.
+        * @param path is the logical path.
+        * @param sprite is the object that will be filled.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseSprite(const std::string &path, Sprite &sprite) const;
+
+        /** Parse a *.anim entry. Animations::GetSpriteFileName will return
+        * the logical path of the sprite sheet, so it can be used with ParseSprite.
+        * @param path is the logical path.
+        * @param animations is the object that will be filled.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseAnimations(const std::string &path, Animations &animations) const;
+
+    private:
+
+        Bundle(const Bundle&);
+        Bundle& operator=(const Bundle&);
+
+        /** One entry from the table of contents */
+        struct Entry
+        {
+            uint32_t pathHash;
+            uint32_t pathOffset;
+            uint32_t pathSize;
+            uint32_t flags;
+            uint64_t dataOffset;
+            uint32_t storedSize;
+            uint32_t size;
+        };
+
+        /** Find the index of an entry, or -1 */
+        int FindEntry(const std::string &path) const;
+
+        /** Set m_errorText, the const functions can fail from many threads */
+        void SetErrorText(const std::string &errorText) const;
+
+        /** Is the text for latest error, guarded by m_errorMutex */
+        mutable std::string m_errorText;
+        mutable std::mutex m_errorMutex;
+
+        /** The mapped (or loaded) file */
+        const char *m_data;
+
+        /** The size of the file */
+        size_t m_size;
+
+        /** The platform handles used by the mapping */
+        void *m_fileHandle;
+        void *m_mapHandle;
+
+        /** True if m_data was allocated with new[] (no mmap on this platform) */
+        bool m_ownsData;
+
+        /** The decoded entries */
+        std::vector<Entry> m_entry;
+
+        /** The slots of the hash table, points in m_data */
+        const char *m_slots;
+
+        /** The number of slots, a power of 2 */
+        uint32_t m_slotCount;
+    };
+
+
+
+    /** This class is used to create a bundle file. */
+    class BundleWriter
+    {
+    public:
+
+        /** The constructor */
+        BundleWriter();
+
+        /** Add a file from the disk.
+        * @param path is the logical path used by Bundle to find it (ex: "chars/hero.anim").
+        * @param fileName is the file to read.
+        * @return ParseResult::OK or ERROR_COULDNT_OPEN. */
+        ParseResult AddFile(const std::string &path, const std::string &fileName);
+
+        /** Add a file from memory.
+        * @param path is the logical path used by Bundle to find it.
+        * @param data is the content.
+        * @param size is the size of the content. */
+        void AddData(const std::string &path, const char *data, size_t size);
+
+        /** Write the bundle.
+        * @param fileName is the output file.
+        * @param compress if true, the entries are compressed with LZ4 when it
+        *        makes them smaller. Ignored if the library is built without DFP_USE_LZ4.
+        * @return ParseResult::OK or ERROR_COULDNT_WRITE (also when an offset
+        *         or a size of an entry is over 4 GB), ERROR_NAME_WRONG
+        *         (duplicated path). */
+        ParseResult Write(const std::string &fileName, bool compress = false);
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        std::string GetErrorText() const;
+
+    private:
+
+        /** Is the text for latest error */
+        std::string m_errorText;
+
+        /** The logical paths */
+        std::vector<std::string> m_path;
+
+        /** The contents */
+        std::vector< std::vector<char> > m_data;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_BUNDLE_H
@@ -15,6 +15,10 @@ namespace dfp
         ERROR_NAME_WRONG,
         ERROR_NUMERIC_ATTRIBUTE_WRONG,
         ERROR_ROOT_MISSING,
+        ERROR_NOT_FOUND,
+        ERROR_UNSUPPORTED,
+        ERROR_COULDNT_WRITE,
+        ERROR_HASH_COLLISION,
     };
 
 }// namespace dfp
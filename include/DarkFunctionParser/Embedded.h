@@ -0,0 +1,217 @@
+#ifndef DFP_EMBEDDED_H
+#define DFP_EMBEDDED_H
+
+#include <cstdint>
+
+#include "Hash.h"
+
+namespace dfp
+{
+    /** These are the types used by the headers generated with the
+    * dfp-embed tool (see tools/dfp-embed). The sprite sheets and the
+    * animations are stored as constexpr arrays, so there is no XML,
+    * no tinyxml2 and no parsing at run time. This header does not need
+    * the rest of the library.
+    * The arrays with sprites and anims are sorted by hash, so the lookup
+    * is a binary search, done at compile time when the argument is a
+    * constant:
+    *   constexpr const dfp::embedded::SprRect* spr = hero_sprites.GetSpr("/brown/0");
+    *   static_assert(spr->w == 17 && spr->h == 24, "the sprite has changed");
+    * A missing sprite is a null pointer, so this does not compile either.*/
+    namespace embedded
+    {
+        /** Used for "no index" */
+        static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+        /** Compare two null terminated strings, at compile time too. */
+        constexpr bool StringEqual(const char* a, const char* b)
+        {
+            return (*a != *b) ? false : (*a == 0) ? true : StringEqual(a + 1, b + 1);
+        }
+
+        /** This is a <spr> node from a sprite sheet. */
+        struct SprRect
+        {
+            /** HashPath(path) */
+            uint32_t hash;
+
+            /** The full path, ex: "/brown/0" */
+            const char* path;
+
+            uint32_t x;
+            uint32_t y;
+            uint32_t w;
+            uint32_t h;
+        };
+
+        /** This is a sprite sheet (a *.sprites file). */
+        struct SpriteSheet
+        {
+            /** The image file name, as it is in the xml */
+            const char* imageFileName;
+
+            /** The width of the image */
+            uint32_t imageW;
+
+            /** The height of the image */
+            uint32_t imageH;
+
+            /** The sprites, sorted by hash */
+            const SprRect* spr;
+
+            /** The number of sprites */
+            uint32_t sprCount;
+
+            /** Find a sprite by the hash of the path.
+            * @return a pointer to the sprite OR nullptr. */
+            constexpr const SprRect* GetSpr(uint32_t hash) const
+            {
+                return Find(hash, 0, sprCount);
+            }
+
+            /** Find a sprite by path, same as Sprite::GetSpr. The path is
+            * compared too, so a path that only has the same hash is not found.
+            * @return a pointer to the sprite OR nullptr. */
+            constexpr const SprRect* GetSpr(const char* xmlPath) const
+            {
+                return CheckPath(Find(HashPath(xmlPath), 0, sprCount), xmlPath);
+            }
+
+            /** The sprite found by hash if it has this path, else nullptr */
+            constexpr const SprRect* CheckPath(const SprRect* found, const char* xmlPath) const
+            {
+                return (found && StringEqual(found->path, xmlPath)) ? found : nullptr;
+            }
+
+            /** Binary search in [first, last) */
+            constexpr const SprRect* Find(uint32_t hash, uint32_t first, uint32_t last) const
+            {
+                return (first >= last) ? nullptr
+                    : (spr[(first + last) / 2].hash == hash) ? &spr[(first + last) / 2]
+                    : (spr[(first + last) / 2].hash < hash) ? Find(hash, (first + last) / 2 + 1, last)
+                    : Find(hash, first, (first + last) / 2);
+            }
+        };
+
+        /** This is a <spr> node from a <cell>. */
+        struct CellSpr
+        {
+            /** The sprite path, ex: "/broun/2" */
+            const char* name;
+
+            /** The index of the sprite in SpriteSheet::spr, OR INVALID_INDEX
+            * if the sheet was not available or the sprite is missing. */
+            uint32_t sprIndex;
+
+            int32_t x;
+            int32_t y;
+            int32_t z;
+        };
+
+        /** This is a <cell> node. */
+        struct Cell
+        {
+            uint32_t index;
+
+            /** The delay in milliseconds */
+            uint32_t delay;
+
+            /** The first entry in Animations::cellSpr */
+            uint32_t firstCellSpr;
+
+            /** The number of entries in Animations::cellSpr */
+            uint32_t cellSprCount;
+        };
+
+        /** This is an <anim> node. */
+        struct Anim
+        {
+            /** HashPath(name) */
+            uint32_t hash;
+
+            /** The name of the anim */
+            const char* name;
+
+            /** The loops attribute */
+            int32_t loops;
+
+            /** The first entry in Animations::cell */
+            uint32_t firstCell;
+
+            /** The number of entries in Animations::cell */
+            uint32_t cellCount;
+        };
+
+        /** This is an *.anim file. */
+        struct Animations
+        {
+            /** The spriteSheet attribute */
+            const char* spriteFileName;
+
+            /** The sprite sheet used by the anims, OR nullptr */
+            const SpriteSheet* sheet;
+
+            /** The anims, sorted by hash */
+            const Anim* anim;
+            uint32_t animCount;
+
+            /** All the cells of all the anims */
+            const Cell* cell;
+            uint32_t cellCount;
+
+            /** All the cell sprites of all the cells */
+            const CellSpr* cellSpr;
+            uint32_t cellSprCount;
+
+            /** Find an anim by the hash of the name.
+            * @return a pointer to the anim OR nullptr. */
+            constexpr const Anim* GetAnim(uint32_t hash) const
+            {
+                return Find(hash, 0, animCount);
+            }
+
+            /** Find an anim by name, same as Animations::GetAnim. The name
+            * is compared too, so a name that only has the same hash is not found.
+            * @return a pointer to the anim OR nullptr. */
+            constexpr const Anim* GetAnim(const char* animName) const
+            {
+                return CheckName(Find(HashPath(animName), 0, animCount), animName);
+            }
+
+            /** The anim found by hash if it has this name, else nullptr */
+            constexpr const Anim* CheckName(const Anim* found, const char* animName) const
+            {
+                return (found && StringEqual(found->name, animName)) ? found : nullptr;
+            }
+
+            /** Get a cell of an anim.
+            * @param a is the anim (returned by GetAnim).
+            * @param cellIndex must be < a.cellCount. */
+            constexpr const Cell& GetCell(const Anim& a, uint32_t cellIndex) const
+            {
+                return cell[a.firstCell + cellIndex];
+            }
+
+            /** Get a sprite of a cell.
+            * @param c is the cell (returned by GetCell).
+            * @param i must be < c.cellSprCount. */
+            constexpr const CellSpr& GetCellSpr(const Cell& c, uint32_t i) const
+            {
+                return cellSpr[c.firstCellSpr + i];
+            }
+
+            /** Binary search in [first, last) */
+            constexpr const Anim* Find(uint32_t hash, uint32_t first, uint32_t last) const
+            {
+                return (first >= last) ? nullptr
+                    : (anim[(first + last) / 2].hash == hash) ? &anim[(first + last) / 2]
+                    : (anim[(first + last) / 2].hash < hash) ? Find(hash, (first + last) / 2 + 1, last)
+                    : Find(hash, first, (first + last) / 2);
+            }
+        };
+
+    }; //namespace embedded
+
+}; //namespace dfp
+
+#endif //DFP_EMBEDDED_H
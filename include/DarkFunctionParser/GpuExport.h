@@ -0,0 +1,148 @@
+#ifndef DFP_GPUEXPORT_H
+#define DFP_GPUEXPORT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Commons.h"
+
+namespace dfp
+{
+    class Sprite;
+    class Animations;
+
+    /** One <anim> (16 bytes, std140 and std430 compatible) */
+    struct GpuAnim
+    {
+        /** The first cell in GpuAnimBuffers::cells */
+        uint32_t firstCell;
+
+        /** The number of cells */
+        uint32_t cellCount;
+
+        /** The sum of all the delays (milliseconds) */
+        uint32_t period;
+
+        /** The attribute loops of the <anim> */
+        int32_t loops;
+    };
+
+    /** One <cell> (16 bytes, std140 and std430 compatible) */
+    struct GpuCell
+    {
+        /** The end time of the cell from the start of the anim (milliseconds),
+        * it is the cumulative sum of the delays. */
+        uint32_t endTime;
+
+        /** The first sprite in GpuAnimBuffers::cellSprs */
+        uint32_t firstSpr;
+
+        /** The number of sprites */
+        uint32_t sprCount;
+
+        uint32_t padding;
+    };
+
+    /** One <spr> of a <cell> (16 bytes, std140 and std430 compatible) */
+    struct GpuCellSpr
+    {
+        int32_t x;
+        int32_t y;
+        int32_t z;
+
+        /** The rect in GpuAnimBuffers::rects */
+        uint32_t rect;
+    };
+
+    /** One rect from the sprite sheet (32 bytes, std140 and std430 compatible).
+    * The UVs are normalized by the image size, (0, 0) is the top-left corner
+    * of the image, as in the *.sprites file. */
+    struct GpuRect
+    {
+        float u0;
+        float v0;
+        float u1;
+        float v1;
+
+        /** The size in pixels */
+        uint32_t w;
+        uint32_t h;
+
+        uint32_t padding[2];
+    };
+
+    /** This class converts an Animations document and its Sprite in flat
+    * tables, ready to be uploaded in GPU buffers (SSBO, UBO, texture
+    * buffer...) so the shader can pick the cell of each instance by itself,
+    * without any work per instance on the CPU.
+    * The cell of an anim at the time t (milliseconds, already multiplied
+    * by the speed factor) is found with the rules of Anim::Update:
+    *   - a delay of 0 is replaced by 1 millisecond;
+    *   - the cell is changed only when the time is strictly bigger than
+    *     the end of the cell, so a cell covers (start, end];
+    *   - the animation is always looping.
+    * In GLSL:
+    *------------------------------------------------------------
+    *   uint r = (t == 0u) ? 0u : (t - 1u) % anim.period + 1u;
+    *   uint cell = anim.firstCell;
+    *   while (cells[cell].endTime < r) cell++;
+    *------------------------------------------------------------
+    * EvaluateCell gives the same result on the CPU (with a binary search). */
+    class GpuAnimBuffers
+    {
+    public:
+
+        /** The constructor */
+        GpuAnimBuffers();
+
+        /** Build the tables. The old content is removed.
+        * @param animations is the parsed *.anim.
+        * @param sprite is the parsed sprite sheet of the animations.
+        * @return ParseResult::OK, ERROR_NOT_FOUND if a sprite is missing in the
+        *         sprite sheet or ERROR_NUMERIC_ATTRIBUTE_WRONG if the image size is 0. */
+        ParseResult Build(const Animations &animations, const Sprite &sprite);
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        std::string GetErrorText() const;
+
+        /** Get the index of an anim in anims.
+        * @return the index, or INVALID_INDEX */
+        uint32_t FindAnim(const std::string &animName) const;
+
+        /** The CPU reference of the shader code: get the cell of an anim at a time.
+        * @param animIndex is the index in anims.
+        * @param timeMilliseconds is the time from the start of the anim.
+        * @return the index of the cell in the anim (0 to cellCount-1), or
+        *         INVALID_INDEX if the anim does not exist or has no cells. */
+        uint32_t EvaluateCell(uint32_t animIndex, uint32_t timeMilliseconds) const;
+
+        /** Returned when an index is not found */
+        static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+        /** The tables. Each one can be uploaded as it is. */
+        std::vector<GpuAnim> anims;
+        std::vector<GpuCell> cells;
+        std::vector<GpuCellSpr> cellSprs;
+        std::vector<GpuRect> rects;
+
+        /** The names of the anims, in the same order as anims */
+        std::vector<std::string> animNames;
+
+        /** The sprite path of each rect, in the same order as rects */
+        std::vector<std::string> rectPaths;
+
+    private:
+
+        /** Is the text for latest error */
+        std::string m_errorText;
+
+        /** Pair (anim name, index in anims) */
+        std::map<std::string, uint32_t> m_animIndex;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_GPUEXPORT_H
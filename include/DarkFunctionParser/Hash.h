@@ -0,0 +1,138 @@
+#ifndef DFP_HASH_H
+#define DFP_HASH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dfp
+{
+    /** The FNV-1a 32 bit offset basis */
+    static const uint32_t HASH_FNV1A_OFFSET = 2166136261u;
+
+    /** The FNV-1a 32 bit prime */
+    static const uint32_t HASH_FNV1A_PRIME = 16777619u;
+
+    /** One step of FNV-1a, used by HashPath. */
+    constexpr uint32_t HashPathStep(const char* text, uint32_t hash)
+    {
+        return (*text == 0) ? hash : HashPathStep(text + 1, (hash ^ (uint8_t)(*text)) * HASH_FNV1A_PRIME);
+    }
+
+    /** The FNV-1a hash of a sprite path ("/brown/0") or of an anim name.
+    * It is constexpr, so with a string literal it is computed at compile time.
+    * @param text is a null terminated string.
+    * @return the 32 bit hash. */
+    constexpr uint32_t HashPath(const char* text)
+    {
+        return HashPathStep(text, HASH_FNV1A_OFFSET);
+    }
+
+    /** The same hash as HashPath(const char*), computed at run time.
+    * @param text is the string.
+    * @return the 32 bit hash. */
+    inline uint32_t HashPath(const std::string& text)
+    {
+        uint32_t hash = HASH_FNV1A_OFFSET;
+        for (size_t i = 0; i < text.size(); i++)
+            hash = (hash ^ (uint8_t)text[i]) * HASH_FNV1A_PRIME;
+
+        return hash;
+    }
+
+    /** The id of an anim, it is the hash of the anim name. Use it with
+    * Animations::GetAnim to find an anim without any string compare:
+    *   static constexpr dfp::AnimId WALK("Walk");
+    *   std::shared_ptr<dfp::Anim> anim = animations.GetAnim(WALK); */
+    struct AnimId
+    {
+        /** The hash of the name */
+        uint32_t hash;
+
+        /** Create the id from a name, at compile time for a literal. */
+        constexpr explicit AnimId(const char* name) : hash(HashPath(name)) {}
+
+        /** Create the id from a name, at run time. */
+        explicit AnimId(const std::string& name) : hash(HashPath(name)) {}
+
+        constexpr bool operator==(const AnimId& other) const { return hash == other.hash; }
+        constexpr bool operator!=(const AnimId& other) const { return hash != other.hash; }
+    };
+
+    /** The id of a sprite, it is the hash of the sprite path ("/brown/0").
+    * Use it with Sprite::GetSpr to find a sprite without any string compare. */
+    struct SprId
+    {
+        /** The hash of the path */
+        uint32_t hash;
+
+        /** Create the id from a path, at compile time for a literal. */
+        constexpr explicit SprId(const char* path) : hash(HashPath(path)) {}
+
+        /** Create the id from a path, at run time. */
+        explicit SprId(const std::string& path) : hash(HashPath(path)) {}
+
+        constexpr bool operator==(const SprId& other) const { return hash == other.hash; }
+        constexpr bool operator!=(const SprId& other) const { return hash != other.hash; }
+    };
+
+
+
+    /** A table from a hash to an index, with open addressing. It is used by
+    * Animations and Sprite to find an anim or a sprite by id with one probe
+    * in most cases. A hash can be added only once, so two names with the
+    * same hash (a collision) are found when the table is built. */
+    class HashIndex
+    {
+    public:
+
+        /** Returned by Find when the hash is not in the table */
+        static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+        /** The constructor */
+        HashIndex();
+
+        /** Remove all */
+        void Clear();
+
+        /** Add a hash.
+        * @param hash is the key.
+        * @param index is the value, must not be INVALID_INDEX.
+        * @return false if the hash is already in the table (nothing is changed). */
+        bool Insert(uint32_t hash, uint32_t index);
+
+        /** Find a hash.
+        * @return the index added with the hash, or INVALID_INDEX. */
+        uint32_t Find(uint32_t hash) const;
+
+        /** Remove a hash. The table is not made smaller.
+        * @return false if the hash is not in the table. */
+        bool Erase(uint32_t hash);
+
+        /** Getter for the number of hashes */
+        size_t GetCount() const;
+
+        /** Getter for the size of the slots, in bytes */
+        size_t GetMemoryBytes() const;
+
+    private:
+
+        struct Slot
+        {
+            uint32_t hash;
+            uint32_t index;
+        };
+
+        /** Make the table 2 times bigger and add again all the slots */
+        void Grow();
+
+        /** The slots, the size is a power of 2. Empty slots have index == INVALID_INDEX */
+        std::vector<Slot> m_slots;
+
+        /** The number of used slots */
+        size_t m_count;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_HASH_H
@@ -0,0 +1,115 @@
+#ifndef DFP_JOBPOOL_H
+#define DFP_JOBPOOL_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace dfp
+{
+    /** This is the interface used by UpdateAnims to run its jobs. Implement
+    * it to plug the job system of your engine, or use JobPool. */
+    class IJobSystem
+    {
+    public:
+
+        /** A job. It is called once for each index. */
+        typedef void (*JobFunction)(void *context, uint32_t index);
+
+        virtual ~IJobSystem() {}
+
+        /** Getter for the number of threads that can run jobs at the same time */
+        virtual uint32_t GetWorkerCount() const = 0;
+
+        /** Run job(context, index) for each index in [0, count), in any order
+        * and on any thread. Return only when all the jobs are done.
+        * @param count is the number of jobs.
+        * @param job is the function to call.
+        * @param context is passed to the function. */
+        virtual void ParallelFor(uint32_t count, JobFunction job, void *context) = 0;
+    };
+
+
+
+    /** A work-stealing thread pool. The jobs of a ParallelFor are split in
+    * contiguous blocks, one block in the queue of each worker. A worker
+    * takes the jobs from the back of its own queue and, when it is empty,
+    * steals from the front of the other queues, so a slow block does not
+    * keep the other threads waiting. The calling thread works too.
+    * ParallelFor can be called by one thread at a time and must not be
+    * called from inside a job. */
+    class JobPool : public IJobSystem
+    {
+    public:
+
+        /** The constructor, the threads are started here.
+        * @param threadCount is the number of threads to start, 0 means
+        *        one less than std::thread::hardware_concurrency(). */
+        JobPool(uint32_t threadCount = 0);
+
+        /** The destructor, the threads are stopped here. */
+        virtual ~JobPool();
+
+        /** Getter for the number of workers (the threads + the caller) */
+        virtual uint32_t GetWorkerCount() const;
+
+        virtual void ParallelFor(uint32_t count, JobFunction job, void *context);
+
+    private:
+
+        JobPool(const JobPool&);
+        JobPool& operator=(const JobPool&);
+
+        /** One job in a queue */
+        struct Task
+        {
+            JobFunction job;
+            void *context;
+            uint32_t index;
+        };
+
+        /** The queue of a worker */
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        /** The loop of a thread */
+        void WorkerMain(uint32_t worker);
+
+        /** Run tasks until all the queues are empty */
+        void RunTasks(uint32_t worker);
+
+        /** Take a task from the own queue or steal one.
+        * @return false if all the queues are empty */
+        bool PopTask(uint32_t worker, Task &task);
+
+        /** The threads */
+        std::vector<std::thread> m_threads;
+
+        /** The queues, one for each worker. The last one is for the caller */
+        std::vector< std::unique_ptr<Queue> > m_queues;
+
+        /** The number of tasks not finished */
+        std::atomic<uint32_t> m_pending;
+
+        /** Used to wake up the threads when there is a new ParallelFor */
+        std::mutex m_wakeMutex;
+        std::condition_variable m_wakeCondition;
+        uint64_t m_generation;
+        bool m_stop;
+
+        /** Used to wake up the caller when all the tasks are done */
+        std::mutex m_doneMutex;
+        std::condition_variable m_doneCondition;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_JOBPOOL_H
@@ -0,0 +1,82 @@
+#ifndef DFP_MEMORYUSAGE_H
+#define DFP_MEMORYUSAGE_H
+
+#include <cstddef>
+#include <string>
+
+namespace dfp
+{
+    /** This is the report returned by Sprite::GetMemoryUsage and
+    * Animations::GetMemoryUsage. It is an estimation of the heap used by
+    * a parsed document, done with the sizes of the types from this
+    * platform. The map node and shared_ptr control block overheads are
+    * estimated with the layout used by the common standard libraries.
+    * The bytes are counted two times: once by node type, and once
+    * by category, so both sums are equal to GetTotal(). */
+    struct MemoryUsage
+    {
+        /** The node types */
+        enum NodeType
+        {
+            NODE_DOCUMENT = 0,
+            NODE_DIR,
+            NODE_SPR,
+            NODE_ANIM,
+            NODE_CELL,
+            NODE_CELLSPR,
+            NODE_TYPE_COUNT,
+        };
+
+        /** The number of nodes of each type */
+        size_t nodeCount[NODE_TYPE_COUNT];
+
+        /** The bytes used by each node type */
+        size_t nodeBytes[NODE_TYPE_COUNT];
+
+        /** The bytes used by the objects (sizeof) */
+        size_t objects;
+
+        /** The bytes used by the text of the strings (short strings stored
+        * inside the std::string object are not counted here) */
+        size_t strings;
+
+        /** The bytes used by the map nodes and by the vector buffers */
+        size_t containers;
+
+        /** The bytes used by the shared_ptr control blocks */
+        size_t controlBlocks;
+
+        /** The constructor, all to 0 */
+        MemoryUsage();
+
+        /** The sum of all the categories */
+        size_t GetTotal() const;
+
+        /** Add another report to this one */
+        MemoryUsage& operator+=(const MemoryUsage& other);
+
+        /** Count one object created with std::make_shared.
+        * @param type is the node type.
+        * @param objectSize is sizeof the object. */
+        void AddSharedObject(NodeType type, size_t objectSize);
+
+        /** Count an object that is not in a shared_ptr */
+        void AddObject(NodeType type, size_t objectSize);
+
+        /** Count the heap buffer of a string. */
+        void AddString(NodeType type, const std::string& text);
+
+        /** Count the nodes of a std::map.
+        * @param count is the number of elements.
+        * @param valueSize is sizeof(map::value_type). */
+        void AddMapNodes(NodeType type, size_t count, size_t valueSize);
+
+        /** Count the buffer of a std::vector.
+        * @param capacity is vector::capacity().
+        * @param valueSize is sizeof(vector::value_type). */
+        void AddVectorBuffer(NodeType type, size_t capacity, size_t valueSize);
+    };
+
+}; //namespace dfp
+
+#endif //DFP_MEMORYUSAGE_H
@@ -0,0 +1,159 @@
+#ifndef DFP_METRICS_H
+#define DFP_METRICS_H
+
+#include <cstdint>
+#include <string>
+
+namespace dfp
+{
+    /** This class counts what the playback and the lookups do at run time,
+    * to feed a metrics exporter:
+    *   dfp::Metrics::Snapshot previous, current;
+    *   dfp::Metrics::GetSnapshot(previous);
+    *   ... one second later ...
+    *   dfp::Metrics::GetSnapshot(current);
+    *   current.Subtract(previous); // the counts of this second
+    *   current.counters[dfp::Metrics::COUNTER_CELLS_ADVANCED]; // cells/s
+    * The library counts only when it is built with DFP_ENABLE_METRICS
+    * defined. Without it, the DFP_METRICS macros do nothing, so there is
+    * no cost at all, and the snapshot stays at zero.
+    * Each thread counts in its own block, without lock and without atomic
+    * read-modify-write. GetSnapshot sums the blocks, it can be called from
+    * any thread while the others count. */
+    class Metrics
+    {
+    public:
+
+        /** The counters, they only grow */
+        enum Counter
+        {
+            COUNTER_ANIM_UPDATES,           ///< Calls of Anim::Update
+            COUNTER_CELLS_ADVANCED,         ///< Cells moved by Anim::Update
+            COUNTER_TICK_INSTANCE_UPDATES,  ///< Visible instances moved by TickEngine::Advance
+            COUNTER_TICK_CATCHUPS,          ///< Hidden instances brought up to date by TickEngine
+            COUNTER_SPR_LOOKUPS,            ///< Calls of Sprite::GetSpr (path or id)
+            COUNTER_SPR_LOOKUP_MISSES,      ///< Calls of Sprite::GetSpr that found nothing
+            COUNTER_COUNT
+        };
+
+        /** The gauges, they go up and down */
+        enum Gauge
+        {
+            GAUGE_TICK_INSTANCES,           ///< Alive instances of all the TickEngines
+            GAUGE_COUNT
+        };
+
+        /** The histograms */
+        enum Histogram
+        {
+            HISTOGRAM_UPDATE_ITERATIONS,    ///< Iterations of the catch-up loop of one Anim::Update
+            HISTOGRAM_COUNT
+        };
+
+        /** The number of buckets of a histogram. The bucket 0 counts the
+        * value 0, the bucket b counts the values in [2^(b-1), 2^b - 1],
+        * the last bucket also counts all the bigger values. */
+        static const uint32_t BUCKET_COUNT = 16;
+
+        /** The values of all the metrics at one time */
+        struct Snapshot
+        {
+            /** The constructor, all the values are 0 */
+            Snapshot();
+
+            /** Keep only what happened after an older snapshot: the
+            * counters and the buckets become differences. The gauges and
+            * the maxima (since the start) are not changed.
+            * @param older is a snapshot taken before this one. */
+            void Subtract(const Snapshot &older);
+
+            /** The upper bound of the highest bucket that is not empty,
+            * 0 if the histogram is empty. After Subtract, it is the worst
+            * case of the interval (rounded up to a power of 2 minus 1). */
+            uint64_t GetBucketMax(Histogram histogram) const;
+
+            /** The time of the snapshot (see Trace::Now), after Subtract
+            * the duration of the interval, in microseconds. */
+            uint64_t timeMicroseconds;
+
+            uint64_t counters[COUNTER_COUNT];
+            int64_t gauges[GAUGE_COUNT];
+            uint64_t buckets[HISTOGRAM_COUNT][BUCKET_COUNT];
+            uint64_t maxima[HISTOGRAM_COUNT];
+        };
+
+        /** True if the library is built with DFP_ENABLE_METRICS */
+        static bool IsEnabled();
+
+        /** Add to a counter.
+        * @param counter is the counter.
+        * @param value is added. */
+        static void Add(Counter counter, uint64_t value);
+
+        /** Change a gauge.
+        * @param gauge is the gauge.
+        * @param delta is added, it can be negative. */
+        static void AddGauge(Gauge gauge, int64_t delta);
+
+        /** Add a value to a histogram.
+        * @param histogram is the histogram.
+        * @param value is counted in its bucket. */
+        static void Record(Histogram histogram, uint64_t value);
+
+        /** Get the values of all the metrics.
+        * @param snapshot is filled. */
+        static void GetSnapshot(Snapshot &snapshot);
+
+        /** Getters for the names of the metrics, like "cells_advanced" */
+        static const char *GetName(Counter counter);
+        static const char *GetName(Gauge gauge);
+        static const char *GetName(Histogram histogram);
+
+        /** Get a snapshot in the Prometheus text format, every name starts
+        * with "dfp_". The histograms are cumulative, as Prometheus wants.
+        * @param snapshot is the snapshot.
+        * @return the text. */
+        static std::string GetText(const Snapshot &snapshot);
+    };
+
+
+
+    /** The part of a gauge owned by an object (like the instances of one
+    * TickEngine). A copy of the object adds its value again, and the value
+    * is removed from the gauge when the object is destroyed. */
+    class MetricsGauge
+    {
+    public:
+
+        /** The constructor, the value is 0 */
+        MetricsGauge(Metrics::Gauge gauge);
+
+        MetricsGauge(const MetricsGauge &other);
+        MetricsGauge& operator=(const MetricsGauge &other);
+        ~MetricsGauge();
+
+        /** Change the value, and the gauge.
+        * @param delta is added, it can be negative. */
+        void Add(int64_t delta);
+
+    private:
+
+        Metrics::Gauge m_gauge;
+        int64_t m_value;
+    };
+
+}; //namespace dfp
+
+
+#ifdef DFP_ENABLE_METRICS
+/** Add to a counter */
+#define DFP_METRICS_ADD(counter, value) dfp::Metrics::Add(counter, value)
+/** Add a value to a histogram */
+#define DFP_METRICS_RECORD(histogram, value) dfp::Metrics::Record(histogram, value)
+#else
+/// The value is not computed, but the variables stay used.
+#define DFP_METRICS_ADD(counter, value) ((void)sizeof(value))
+#define DFP_METRICS_RECORD(histogram, value) ((void)sizeof(value))
+#endif
+
+#endif //DFP_METRICS_H
@@ -0,0 +1,35 @@
+#ifndef DFP_PARALLELUPDATE_H
+#define DFP_PARALLELUPDATE_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "JobPool.h"
+
+namespace dfp
+{
+    class Anim;
+
+    /** The default number of Anim instances in one job of UpdateAnims */
+    static const uint32_t UPDATE_RANGE_SIZE = 1024;
+
+    /** Call Anim::Update for many instances, on many threads.
+    * The instances are split in ranges of rangeSize, and each range is one
+    * job of the job system. Each instance is updated by exactly one thread,
+    * with the same code as Anim::Update, so the result is identical to a
+    * loop on one thread, no matter how many threads are used.
+    * The null instances and the instances without cells are skipped.
+    * @param anims are the instances. All must be different objects.
+    * @param dtSeconds time diference from last call (in seconds).
+    * @param animSpeedFactor is the speed factor, see Anim::Update.
+    * @param jobSystem runs the jobs. If null, all is done on this thread.
+    * @param changed if not null, is resized to anims.size() and changed[i] is
+    *        1 if the current cell of anims[i] was changed, or 0.
+    * @param rangeSize is the number of instances in one job. */
+    void UpdateAnims(const std::vector< std::shared_ptr<Anim> > &anims, float dtSeconds, float animSpeedFactor,
+        IJobSystem *jobSystem = nullptr, std::vector<uint8_t> *changed = nullptr, uint32_t rangeSize = UPDATE_RANGE_SIZE);
+
+}; //namespace dfp
+
+#endif //DFP_PARALLELUPDATE_H
@@ -0,0 +1,116 @@
+#ifndef DFP_PARSECACHE_H
+#define DFP_PARSECACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Commons.h"
+
+namespace dfp
+{
+    class Sprite;
+    class Animations;
+    class Dir;
+    class BinaryReader;
+
+    /** This class keeps the parsed documents in a directory, so the next
+    * launch does not parse the XML again:
+    *   dfp::ParseCache::SetDirectory("cache/dfp");
+    *   sprite.ParseFile("data/hero.sprites"); // parsed once, then cached
+    * When a directory is set, Sprite::ParseFile and Animations::ParseFile
+    * look for an entry of the file first. An entry is used only if the
+    * file has not changed since it was written: same path, same size and
+    * same modification time (VALIDATE_MTIME, nothing is read from the
+    * file), or same content hash (VALIDATE_CONTENT, the file is read but
+    * not parsed). Otherwise the file is parsed and the entry is written
+    * again, so the stale entries are replaced automatically.
+    * An entry is written in a temporary file then renamed, so a reader
+    * never sees half an entry, even with many processes. A broken entry
+    * is ignored. The cache is not used for a Sprite with a LoadFilter.
+    * Format of an entry (the numbers are LEB128, see src/BinaryIO.h):
+    *------------------------------------------------------------
+    *   "DFPC", u8 version, u8 kind (1: sprites, 2: anim),
+    *   path, size, mtime, content hash, then the document:
+    *   sprites : image name, w, h, root <dir> (name, dirs, sprs (name, x, y, w, h))
+    *   anim    : sprite sheet, ver, anims (name, loops, cells (index, delay,
+    *             sprs (name, x, y, z)))
+    *------------------------------------------------------------*/
+    class ParseCache
+    {
+    public:
+
+        /** How an entry is checked against its file */
+        enum Validation
+        {
+            VALIDATE_MTIME,     ///< The size and the modification time, the default
+            VALIDATE_CONTENT    ///< The FNV-1a 64 hash of the content
+        };
+
+        /** The counts since the start, or since ResetStats */
+        struct Stats
+        {
+            uint64_t hits;      ///< Documents loaded from the cache
+            uint64_t misses;    ///< Documents parsed: no entry, or a stale one
+            uint64_t writes;    ///< Entries written
+            uint64_t errors;    ///< Entries that could not be read or written
+        };
+
+        /** Select the cache directory, it is created if it does not exist
+        * (not its parents). Thread safe, a parse already started keeps the
+        * old directory.
+        * @param directory is the directory, "" disables the cache.
+        * @param validation is how the entries are checked. */
+        static void SetDirectory(const std::string &directory, Validation validation = VALIDATE_MTIME);
+
+        /** Getter for the cache directory, "" if the cache is disabled */
+        static std::string GetDirectory();
+
+        /** Getter for the counts */
+        static Stats GetStats();
+
+        /** Set all the counts to 0 */
+        static void ResetStats();
+
+        /** Used by Sprite::ParseFile.
+        * @param fileName is the file to parse.
+        * @param sprite is the document that will be filled.
+        * @param result gets the result of the parse.
+        * @return false if the cache is not used for this file, then the
+        *         caller parses the file as usual. */
+        static bool ParseFile(const std::string &fileName, Sprite &sprite, ParseResult &result);
+
+        /** Used by Animations::ParseFile, same as above. */
+        static bool ParseFile(const std::string &fileName, Animations &animations, ParseResult &result);
+
+        /** Write the compact form of a document.
+        * @param sprite is the parsed document.
+        * @param data gets the document part of an entry. */
+        static void Serialize(const Sprite &sprite, std::vector<uint8_t> &data);
+        static void Serialize(const Animations &animations, std::vector<uint8_t> &data);
+
+        /** Fill a document from its compact form, like a parse of the file
+        * would do.
+        * @param data is the document part of an entry.
+        * @param size is the size of the data.
+        * @param fileName is the file of the entry, for the path of the images.
+        * @param sprite is the document that will be filled.
+        * @return false if the data is broken, the document is not changed. */
+        static bool Deserialize(const uint8_t *data, size_t size, const std::string &fileName, Sprite &sprite);
+        static bool Deserialize(const uint8_t *data, size_t size, const std::string &fileName, Animations &animations);
+
+    private:
+
+        /** The common part of the two ParseFile */
+        template <typename Document>
+        static bool ParseCachedFile(const std::string &fileName, Document &document, uint8_t kind, ParseResult &result);
+
+        /** Write and read a <dir> and all its children */
+        static void WriteDir(std::vector<uint8_t> &data, const Dir &dir);
+        static std::shared_ptr<Dir> ReadDir(BinaryReader &reader, uint32_t depth);
+    };
+
+}; //namespace dfp
+
+#endif //DFP_PARSECACHE_H
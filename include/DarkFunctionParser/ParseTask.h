@@ -0,0 +1,224 @@
+#ifndef DFP_PARSETASK_H
+#define DFP_PARSETASK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Commons.h"
+#include "XmlReader.h"
+
+namespace dfp
+{
+    class Sprite;
+    class Animations;
+    class Dir;
+
+    /** This is a parse that can be done in small steps, for platforms
+    * where a background thread can not be used. Each call of Step does
+    * a bounded amount of work and returns, so a big file can be loaded
+    * on the main thread without frame hitches:
+    *   dfp::Sprite sprite;
+    *   dfp::SpriteParseTask task(sprite);
+    *   task.Start("hero.sprites");
+    *   // each frame:
+    *   if (task.Step(2000) != dfp::ParseTask::STATUS_IN_PROGRESS) ...
+    * The work is done in 3 phases: the file is read in chunks, the xml
+    * is parsed by the selected XmlBackend (this phase can not be split,
+    * it is done in one Step), and the nodes are built a few at a time.
+    * The document must not be used until the status is STATUS_DONE. */
+    class ParseTask
+    {
+    public:
+
+        enum Status
+        {
+            STATUS_IN_PROGRESS = 0,
+            STATUS_DONE,
+            STATUS_FAILED,
+        };
+
+        virtual ~ParseTask();
+
+        /** Prepare to parse a file. Only the file is opened here.
+        * Note: use '/' instead of '\\' as it is using '/' to find the path.
+        * @param fileName is the filename and path of the file (xml format).
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult Start(const std::string &fileName);
+
+        /** Prepare to parse a text that is already in memory. The text is copied.
+        * @param text is the xml.
+        * @return ParseResult::OK */
+        ParseResult StartText(const std::string &text);
+
+        /** Do some work. At least one unit of work is done, even if the
+        * budget is 0.
+        * @param budgetMicroseconds is the time that can be used by this call.
+        * @return the status after this step. */
+        Status Step(uint32_t budgetMicroseconds);
+
+        /** Getter for the status */
+        Status GetStatus() const;
+
+        /** Getter for the progress, from 0 to 1. */
+        float GetProgress() const;
+
+        /** Getter for the result, valid when the status is not STATUS_IN_PROGRESS. */
+        ParseResult GetResult() const;
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        std::string GetErrorText() const;
+
+    protected:
+
+        enum Phase
+        {
+            PHASE_IDLE = 0,
+            PHASE_READ,
+            PHASE_PARSE,
+            PHASE_BUILD,
+            PHASE_DONE,
+        };
+
+        /** The constructor, used only by the derived classes */
+        ParseTask();
+
+        /** Set the path of the document from the file name */
+        virtual void SetFilePath(const std::string &fileName) = 0;
+
+        /** Read the root node and prepare the build.
+        * @param doc is the parsed xml.
+        * @param nodeCount will be the number of units of work for BuildStep.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        virtual ParseResult BeginBuild(const XmlDocument &doc, uint32_t &nodeCount) = 0;
+
+        /** Build one node.
+        * @param finished will be true when there are no more nodes.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        virtual ParseResult BuildStep(bool &finished) = 0;
+
+        /** Getter for the error text of the document */
+        virtual std::string GetDocumentErrorText() const = 0;
+
+        /** Close the file and free the memory used while parsing */
+        void Release();
+
+        /** Stop with an error */
+        Status Fail(ParseResult result, const std::string &errorText);
+
+        /** The current phase */
+        Phase m_phase;
+
+        /** The result */
+        ParseResult m_result;
+
+        /** Is the text for latest error */
+        std::string m_errorText;
+
+        /** The file, while reading (FILE* or SDL_RWops*) */
+        void *m_file;
+
+        /** The text of the file */
+        std::vector<char> m_text;
+
+        /** The number of bytes read */
+        size_t m_read;
+
+        /** The parsed xml */
+        XmlDocument *m_doc;
+
+        /** The number of nodes to build, and the number already built */
+        uint32_t m_nodeCount;
+        uint32_t m_nodeDone;
+
+    private:
+
+        ParseTask(const ParseTask&);
+        ParseTask& operator=(const ParseTask&);
+    };
+
+
+
+    /** The ParseTask for a *.sprites file. The Sprite must live longer than the task. */
+    class SpriteParseTask : public ParseTask
+    {
+    public:
+
+        /** The constructor
+        * @param sprite is the object that will be filled. */
+        SpriteParseTask(Sprite &sprite);
+
+    protected:
+
+        virtual void SetFilePath(const std::string &fileName);
+        virtual ParseResult BeginBuild(const XmlDocument &doc, uint32_t &nodeCount);
+        virtual ParseResult BuildStep(bool &finished);
+        virtual std::string GetDocumentErrorText() const;
+
+        /** One <dir> that is not finished */
+        struct Frame
+        {
+            /** The next child to build */
+            XmlNode node;
+
+            /** The Dir that receives the childs */
+            std::shared_ptr<Dir> dir;
+
+            /** The path of the dir, with a '/' at the end */
+            std::string path;
+
+            /** False if the <spr> childs are skipped by the load filter */
+            bool loadSpr;
+        };
+
+        /** Set the error of a child of the open <dir> nodes, the text is the
+        * same as the one of Sprite::ParseText.
+        * @param nodeName is the name of the child ("dir" or "spr").
+        * @param errorText is the error of the child.
+        * @return result. */
+        ParseResult FailDir(ParseResult result, const char *nodeName, std::string errorText);
+
+        /** The target */
+        Sprite &m_sprite;
+
+        /** The <dir> nodes from <definitions>, they are root candidates */
+        std::vector<XmlNode> m_rootNodes;
+
+        /** The next entry in m_rootNodes */
+        size_t m_rootIndex;
+
+        /** The <dir> nodes that are built now, the first is the root */
+        std::vector<Frame> m_stack;
+    };
+
+
+
+    /** The ParseTask for a *.anim file. One <anim> is built in one unit of
+    * work. The Animations must live longer than the task. */
+    class AnimationsParseTask : public ParseTask
+    {
+    public:
+
+        /** The constructor
+        * @param animations is the object that will be filled. */
+        AnimationsParseTask(Animations &animations);
+
+    protected:
+
+        virtual void SetFilePath(const std::string &fileName);
+        virtual ParseResult BeginBuild(const XmlDocument &doc, uint32_t &nodeCount);
+        virtual ParseResult BuildStep(bool &finished);
+        virtual std::string GetDocumentErrorText() const;
+
+        /** The target */
+        Animations &m_animations;
+
+        /** The next child of <animations> */
+        XmlNode m_node;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_PARSETASK_H
@@ -0,0 +1,119 @@
+#ifndef DFP_RECORDER_H
+#define DFP_RECORDER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Commons.h"
+
+namespace dfp
+{
+    class Anim;
+
+    /** This class records the playback calls of a live session in a
+    * compact binary file, so the same work can be replayed later against
+    * another build (see tools/dfp-replay):
+    *   dfp::Recorder::Start();
+    *   ... play the game ...
+    *   dfp::Recorder::Stop();
+    *   dfp::Recorder::WriteFile("session.dfpr");
+    * The calls recorded are Animations::GetAnim (an instance starts),
+    * Anim::Update, Anim::GetCurrentCell (the index is kept, the replay
+    * checks that it gets the same) and the destruction of
+    * the instance. The delays of each anim are written once, so the file
+    * can be replayed without the *.anim files.
+    * The library records the calls only when it is built with
+    * DFP_ENABLE_RECORDING defined. Without it, the DFP_RECORD macro is
+    * empty, so there is no cost at all, and the recording is always empty.
+    * The calls of all the threads go in one buffer, under a lock, in the
+    * order they happen. Only the instances returned by GetAnim while the
+    * recording is on are recorded (not their copies). */
+    class Recorder
+    {
+    public:
+
+        /** The kinds of events in the file */
+        enum EventType
+        {
+            EVENT_ANIM = 1,         ///< The timing of an anim: name, loops, delays
+            EVENT_SPAWN,            ///< GetAnim returned a new instance of an anim
+            EVENT_UPDATE,           ///< Anim::Update(dtSeconds, animSpeedFactor)
+            EVENT_UPDATE_REPEAT,    ///< Anim::Update with the same values as the previous EVENT_UPDATE
+            EVENT_CELL,             ///< GetCurrentCell returned the cell cellIndex
+            EVENT_RELEASE           ///< The instance is destroyed
+        };
+
+        /** One decoded event, only the fields of its type are set. */
+        struct Event
+        {
+            EventType type;
+
+            /** The instance (not EVENT_ANIM) */
+            uint32_t instance;
+
+            /** EVENT_ANIM and EVENT_SPAWN: the id of the anim in the file */
+            uint32_t anim;
+
+            /** EVENT_ANIM */
+            std::string name;
+            int loops;
+            std::vector<int> delays;
+
+            /** EVENT_UPDATE and EVENT_UPDATE_REPEAT */
+            float dtSeconds;
+            float animSpeedFactor;
+
+            /** EVENT_CELL */
+            uint32_t cellIndex;
+        };
+
+        /** Remove the old events and start the recording */
+        static void Start();
+
+        /** Stop the recording, the events are kept */
+        static void Stop();
+
+        /** Check if the recording is on */
+        static bool IsEnabled();
+
+        /** Getter for the recorded file, in memory */
+        static std::vector<uint8_t> GetData();
+
+        /** Write the recorded events in a file.
+        * @param fileName is the output file.
+        * @return ParseResult::OK or ERROR_COULDNT_WRITE. */
+        static ParseResult WriteFile(const std::string &fileName);
+
+        /** Decode a recorded file.
+        * @param data is the content of the file.
+        * @param size is the size of the data in bytes.
+        * @param events will get all the events, in order.
+        * @return ParseResult::OK, or ERROR_PARSING_FAILED if the data is
+        *         not a recording or is truncated. */
+        static ParseResult Decode(const uint8_t *data, size_t size, std::vector<Event> &events);
+
+        /** The hooks called by the library, use the DFP_RECORD macro. */
+        static void OnSpawn(Anim &anim);
+        static void OnUpdate(const Anim &anim, float dtSeconds, float animSpeedFactor);
+        static void OnCell(const Anim &anim, uint32_t cellIndex);
+        static void OnRelease(const Anim &anim);
+
+    private:
+
+        /** True if the instance was spawned by the current recording,
+        * call it with the lock. */
+        static bool IsRecorded(const Anim &anim);
+    };
+
+}; //namespace dfp
+
+
+#ifdef DFP_ENABLE_RECORDING
+/** Call a hook of the Recorder, ex: DFP_RECORD(OnUpdate(*this, dt, speed)) */
+#define DFP_RECORD(hook) dfp::Recorder::hook
+#else
+#define DFP_RECORD(hook)
+#endif
+
+#endif //DFP_RECORDER_H
@@ -0,0 +1,133 @@
+#ifndef DFP_SNAPSHOT_H
+#define DFP_SNAPSHOT_H
+
+#include <cstdint>
+#include <memory>
+#include <atomic>
+
+namespace dfp
+{
+    /** This class is used to swap a document (Sprite, Animations) while
+    * other threads are reading it, in RCU style: the document is never
+    * changed after it was published. A background loader will parse a
+    * new instance and will call Publish. The readers will keep using the
+    * old version until they ask again, and the old version is deleted
+    * when the last reader releases it.
+    * Usage:
+    *   dfp::SnapshotHolder<dfp::Animations> g_anims;
+    *
+    *   // loader thread
+    *   std::shared_ptr<dfp::Animations> anims = std::make_shared<dfp::Animations>();
+    *   if (anims->ParseFile("hero.anim") == dfp::ParseResult::OK)
+    *       g_anims.Publish(anims);
+    *
+    *   // render thread
+    *   dfp::SnapshotReader<dfp::Animations> reader(g_anims);
+    *   std::shared_ptr<dfp::Anim> walk = reader.Get()->GetAnim("Walk");
+    *
+    * Never call ParseFile/ParseText or operator= on a published instance,
+    * create a new one and publish it. */
+    template <class T>
+    class SnapshotHolder
+    {
+    public:
+
+        typedef std::shared_ptr<const T> Ptr;
+
+        /** The constructor
+        * @param initial is the first snapshot, can be null. */
+        explicit SnapshotHolder(Ptr initial = Ptr())
+            : m_current(initial)
+            , m_version(1)
+        {}
+
+        /** Replace the current snapshot. The readers that already have the
+        * old one will keep it alive until they release it.
+        * @param snapshot is the new version. */
+        void Publish(Ptr snapshot)
+        {
+            std::atomic_store_explicit(&m_current, snapshot, std::memory_order_release);
+            m_version.fetch_add(1, std::memory_order_release);
+        }
+
+        /** Get the current snapshot. This will take the lock used by the
+        * std::shared_ptr atomic functions on some platforms, so on hot
+        * paths use a SnapshotReader. */
+        Ptr Acquire() const
+        {
+            return std::atomic_load_explicit(&m_current, std::memory_order_acquire);
+        }
+
+        /** Getter for the version. It is changed by each Publish. */
+        uint64_t GetVersion() const
+        {
+            return m_version.load(std::memory_order_acquire);
+        }
+
+    private:
+
+        SnapshotHolder(const SnapshotHolder&);
+        SnapshotHolder& operator=(const SnapshotHolder&);
+
+        /** The current snapshot. Only accessed with std::atomic_load/atomic_store. */
+        Ptr m_current;
+
+        /** Incremented after each Publish */
+        std::atomic<uint64_t> m_version;
+    };
+
+
+
+    /** This is the reader side of a SnapshotHolder. Keep one instance per
+    * thread (it is not thread safe by itself). Get() is wait-free while no
+    * new version was published: it is only one atomic load of the version
+    * and it will return the cached snapshot. */
+    template <class T>
+    class SnapshotReader
+    {
+    public:
+
+        /** The constructor
+        * @param holder is the source of the snapshots. Must live longer than the reader. */
+        explicit SnapshotReader(const SnapshotHolder<T>& holder)
+            : m_holder(holder)
+            , m_version(0)
+        {}
+
+        /** Get the latest snapshot.
+        * @return a reference to the cached snapshot, valid until the next call. */
+        const typename SnapshotHolder<T>::Ptr& Get()
+        {
+            uint64_t version = m_holder.GetVersion();
+            if (version != m_version)
+            {
+                m_cached = m_holder.Acquire();
+                m_version = version;
+            }
+
+            return m_cached;
+        }
+
+        /** Drop the cached snapshot, so an old version can be deleted
+        * even if this reader is not used for a while. */
+        void Release()
+        {
+            m_cached.reset();
+            m_version = 0;
+        }
+
+    private:
+
+        /** The holder */
+        const SnapshotHolder<T>& m_holder;
+
+        /** The latest snapshot taken from the holder */
+        typename SnapshotHolder<T>::Ptr m_cached;
+
+        /** The version of m_cached */
+        uint64_t m_version;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_SNAPSHOT_H
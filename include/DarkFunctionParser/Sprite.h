@@ -6,21 +6,80 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <functional>
 
 
 #include "Commons.h"
+#include "MemoryUsage.h"
+#include "Hash.h"
 
 
-namespace tinyxml2
-{
-	class XMLNode;
-};
-
 namespace dfp
 {
+    class XmlNode;
+    class XmlDocument;
     class Spr;
     class Dir;
 
+    /** This is used to load only a part of a sprite sheet (see
+    * Sprite::SetLoadFilter). The <dir> nodes that are not selected are
+    * skipped without creating any Dir or Spr object.
+    * The dir paths are like the sprite paths, with a '/' at the end:
+    * '/' is the root, '/enemies/slime/' is the dir 'slime' from 'enemies'.
+    * An empty filter selects all. If the root '/' is skipped, the root dir
+    * is kept but empty: none of its <spr> and <dir> childs is loaded.
+    *   dfp::LoadFilter filter;
+    *   filter.AddPrefix("/enemies/slime");
+    *   sprite.SetLoadFilter(filter);
+    *   sprite.ParseFile("all.sprites"); // only /enemies/slime/... is loaded */
+    class LoadFilter
+    {
+    public:
+
+        /** What is loaded from a <dir> */
+        enum Decision
+        {
+            /** Nothing, the dir and all its childs are skipped */
+            DIR_SKIP = 0,
+
+            /** The dir is created only because a selected dir is inside,
+            * its <spr> childs are skipped */
+            DIR_PATH_ONLY,
+
+            /** The dir and its <spr> childs are loaded */
+            DIR_LOAD,
+        };
+
+        /** The constructor, the filter selects all */
+        LoadFilter();
+
+        /** Select a dir and all its childs. If there is at least one
+        * prefix, the dirs that are not inside a prefix are skipped.
+        * @param dirPath is the path of the dir (ex: '/enemies/slime'). */
+        void AddPrefix(const std::string &dirPath);
+
+        /** Set a function that can skip a dir (and all its childs) by
+        * returning false. It is called with the path of each dir that
+        * is not already skipped by the prefixes. */
+        void SetPredicate(const std::function<bool(const std::string &dirPath)> &predicate);
+
+        /** Check if the filter selects all */
+        bool IsEmpty() const;
+
+        /** Find what is loaded from a dir.
+        * @param dirPath is the path of the dir, with a '/' at the end.
+        * @return the decision. */
+        Decision CheckDir(const std::string &dirPath) const;
+
+    private:
+
+        /** The prefixes, all with a '/' at the end */
+        std::vector<std::string> m_prefix;
+
+        /** The optional predicate */
+        std::function<bool(const std::string &dirPath)> m_predicate;
+    };
+
     /** This class is designed to read XML files generated
 	* by DarkFunction editor (http://darkfunction.com/editor/)
 	* with format like this:
@@ -36,9 +95,17 @@ namespace dfp
     *         < / dir>
     *     < / definitions>
     * < / img>
-    * ------------------------------------------------------------*/
+    * ------------------------------------------------------------
+    * Thread safety: after ParseFile/ParseText returned, all the const
+    * functions (GetSpr, GetAllSpr, GetImageFileName...) can be called from
+    * many threads at the same time without locks. They never change the
+    * sprite tree. Do not call ParseFile/ParseText while other threads read,
+    * use a SnapshotHolder to swap in reloaded content.*/
     class Sprite
     {
+        friend class SpriteParseTask;
+        friend class SpriteStreamParser;
+        friend class ParseCache;
     public:
 
         /** The (default) constructor */
@@ -48,11 +115,17 @@ namespace dfp
         * associated with this sprite. The path is relative to the *.sprite file location.
         * @param onlyFileName used to specify if we want only the filename, or the filename withthe path.
         * @return a string with path and filename of the image.*/
-        std::string GetImageFileName(bool onlyFileName = false);
+        std::string GetImageFileName(bool onlyFileName = false) const;
+
+        /** Getter for the width of the image (attribute 'w' from <img>) */
+        unsigned int GetImageW() const;
+
+        /** Getter for the height of the image (attribute 'h' from <img>) */
+        unsigned int GetImageH() const;
 
         /** Get the text for latest error!
         * @return a string with a text that describe the error.*/
-        std::string GetErrorText();
+        std::string GetErrorText() const;
 
         /** Read a file and parse it.
         * Note: use '/' instead of '\\' as it is using '/' to find the path.
@@ -65,6 +138,20 @@ namespace dfp
         * @return ParseResult::OK if everithing was fine, or an error code!*/
         ParseResult ParseText(const std::string &text);
 
+        /** Same as ParseText(const std::string&), without a copy of the text.
+        * @param text is the xml, it does not need to be null terminated.
+        * @param size is the size of the text in bytes.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseText(const char *text, size_t size);
+
+        /** Parse a file that is already in memory (from a bundle, a network
+        * packet...). The fileName is used only to compute the path, like in ParseFile.
+        * @param data is the content of the file.
+        * @param size is the size of the data in bytes.
+        * @param fileName is the filename and path of the file.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseBuffer(const char *data, size_t size, const std::string &fileName);
+
         /** This will return a shared pointer to a sprite (Spr) found at location
         * described by the xmlPath. For example if the sprite file is:
         * ------------------------------------------------------------
@@ -81,18 +168,79 @@ namespace dfp
         * ------------------------------------------------------------
         * The xmlPath for sprite with name '0' is: '/brown/0' .
         *
+        * A path that is not found will not change the sprite tree.
+        *
         * @param xmlPath is the path to the sprite.
-        * @return a shared pointer for a Sprite object.*/
-		std::shared_ptr<Spr> GetSpr(const std::string& xmlPath);
+        * @return a shared pointer for a Sprite object, OR a null shared pointer.*/
+		std::shared_ptr<Spr> GetSpr(const std::string& xmlPath) const;
+
+		/** Same as GetSpr(const std::string&), but the sprite is found by the
+		* hash of the path, without any string compare. The ids of all the
+		* sprites are checked for collisions when the file is parsed, a path
+		* of GetIdCollisions is not found by id.
+		* @param id is the id of the path (ex: dfp::SprId("/brown/0")).
+		* @return a shared pointer for a Sprite object, OR a null shared pointer.*/
+		std::shared_ptr<Spr> GetSpr(SprId id) const;
+
+		/** Getter for the paths that have the same SprId as another path.
+		* They are rare (the id is a 32 bit hash) and are found only with
+		* GetSpr(const std::string&).
+		* @return the paths, empty if there is no collision.*/
+		const std::vector<std::string>& GetIdCollisions() const;
 
 		/**
 		* Use this to return all the Spr entiryes (aka <spr name="0" x="5" y="7" w="17" h="24"/>)
 		* This is a costly to call often!
 		* @return a vector of shared pointers.*/
-		std::vector<std::shared_ptr<Spr> > GetAllSpr();
+		std::vector<std::shared_ptr<Spr> > GetAllSpr() const;
+
+		/**
+		* Same as GetAllSpr, but each Spr comes with the full path that
+		* can be used with GetSpr (ex: '/brown/0').
+		* This is a costly to call often!
+		* @return a vector of pairs (path, Spr).*/
+		std::vector< std::pair<std::string, std::shared_ptr<Spr> > > GetAllSprWithPath() const;
+
+		/** Get an estimation of the memory used by this sprite sheet, by node
+		* type and by category. It is computed once, at the end of the parsing,
+		* so it is cheap to call.
+		* @return the report.*/
+		MemoryUsage GetMemoryUsage() const;
+
+		/** Set the filter used by the next ParseFile/ParseText/ParseBuffer
+		* (and by SpriteParseTask) to load only a part of the sprite sheet.
+		* @param filter is the filter, an empty LoadFilter loads all. */
+		void SetLoadFilter(const LoadFilter& filter);
+
+		/** Getter for the load filter */
+		const LoadFilter& GetLoadFilter() const;
 
     private:
 
+        /** Set m_imagePath from the path of the *.sprites file */
+        void SetFilePath(const std::string &fileName);
+
+        /** Walk the tree and update m_memoryUsage */
+        void ComputeMemoryUsage();
+
+        /** Fill m_sprIndex, m_sprById and m_idCollisions from the tree.
+        * @return ParseResult::OK, 2 paths with the same id are not an error.*/
+        ParseResult BuildIndex();
+
+        /** Check the parsed document and read the attributes of <img>.
+        * @param doc is the parsed document.
+        * @param firstChild will be the first child of <img>.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseRoot(const XmlDocument &doc, XmlNode &firstChild);
+
+        /** Read the attributes of <img>, not the childs.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseRootAttributes(const XmlNode &imgElem);
+
+        /** Use a parsed <dir> as the root.
+        * @return ParseResult::OK or ERROR_ROOT_MISSING if the name is not '/'.*/
+        ParseResult SetRoot(std::shared_ptr<Dir> dir);
+
         /** Is the text for latest error */
         std::string m_errorText;
 
@@ -112,7 +260,25 @@ namespace dfp
         /** The object that contains in a tree format all the other <dir> notes from xml*/
         std::shared_ptr<Dir> m_root;
 
-		std::vector<std::shared_ptr<Spr> > GetAllSpr(std::shared_ptr<Dir> dir);
+        /** The memory report, computed by ComputeMemoryUsage */
+        MemoryUsage m_memoryUsage;
+
+        /** All the sprites, in the order of the paths from GetAllSprWithPath */
+        std::vector< std::shared_ptr<Spr> > m_sprById;
+
+        /** Pair (SprId, index in m_sprById) */
+        HashIndex m_sprIndex;
+
+        /** The paths that are not in m_sprIndex, see GetIdCollisions */
+        std::vector<std::string> m_idCollisions;
+
+        /** The filter used by the parsing */
+        LoadFilter m_loadFilter;
+
+		static std::vector<std::shared_ptr<Spr> > GetAllSpr(std::shared_ptr<Dir> dir);
+
+		static void GetAllSprWithPath(const std::shared_ptr<Dir>& dir, const std::string& path,
+			std::vector< std::pair<std::string, std::shared_ptr<Spr> > >& results);
     };
 
 
@@ -128,22 +294,30 @@ namespace dfp
     {
         friend class Spr;
 		friend class Sprite;
+		friend class SpriteParseTask;
+		friend class SpriteStreamParser;
+		friend class ParseCache;
     public:
 
         /** The constructor */
         Dir();
 
         /** Getter for the Dir name */
-        std::string GetName();
+        std::string GetName() const;
 
         /** Get the text for latest error!
         * @return a string with a text that describe the error.*/
-        std::string GetErrorText();
+        std::string GetErrorText() const;
 
         /** Parse text containing spr XML node.
         * @param dataNode is the xml node for <dir name="brown"> .
         * @return ParseResult::OK if everithing was fine, or an error code! */
-        ParseResult ParseXML(const tinyxml2::XMLNode *dataNode);
+        ParseResult ParseXML(const XmlNode &dataNode);
+
+        /** Parse only the attributes of a <dir> node, not the childs.
+        * @param dataNode is the xml node for <dir name="brown"> .
+        * @return ParseResult::OK if everithing was fine, or an error code! */
+        ParseResult ParseAttributes(const XmlNode &dataNode);
 
         /** This will return a shared pointer to a sprite (Spr) found at location
         * described by the xmlPath. For example if the sprite is file is:
@@ -161,12 +335,26 @@ namespace dfp
         * ------------------------------------------------------------
         * The xmlPath for sprite with name '0' is: '/brown/0' .
         *
+        * A path that is not found will not change the Dir.
+        *
         * @param xmlPath is the path to the sprite.
-        * @return a shared pointer for a Sprite object.*/
-        std::shared_ptr<Spr> GetSpr(const std::string& xmlPath);
+        * @return a shared pointer for a Sprite object, OR a null shared pointer.*/
+        std::shared_ptr<Spr> GetSpr(const std::string& xmlPath) const;
+
+        /** Add the memory used by this Dir and all its childs to a report.
+        * @param usage is the report. */
+        void AddMemoryUsage(MemoryUsage& usage) const;
 
     protected:
 
+        /** Same as ParseXML, with a filter.
+        * @param dataNode is the xml node for <dir name="brown"> .
+        * @param filter is used to skip the child dirs, can be null.
+        * @param path is the path of this dir, with a '/' at the end.
+        * @param loadSpr if false, the <spr> childs are skipped.
+        * @return ParseResult::OK if everithing was fine, or an error code! */
+        ParseResult ParseXML(const XmlNode &dataNode, const LoadFilter *filter, const std::string &path, bool loadSpr);
+
         /** Is the text for latest error */
         std::string m_errorText;
 
@@ -200,28 +388,32 @@ namespace dfp
 			unsigned int w = 0, unsigned int h = 0);
 
         /** Getter for the sprite name */
-        std::string GetName();
+        std::string GetName() const;
 
         /** Getter for the sprite x */
-        unsigned int GetX();
+        unsigned int GetX() const;
 
         /** Getter for the sprite y */
-		unsigned int GetY();
+		unsigned int GetY() const;
 
         /** Getter for the sprite w */
-		unsigned int GetW();
+		unsigned int GetW() const;
 
         /** Getter for the sprite h */
-		unsigned int GetH();
+		unsigned int GetH() const;
 
         /** Parse text containing spr XML node.
         * @param dataNode is the xml node for <spr name="0" x="5" y="7" w="17" h="24"/> .
         * @return ParseResult::OK if everithing was fine, or an error code! */
-        ParseResult ParseXML(const tinyxml2::XMLNode *dataNode);
+        ParseResult ParseXML(const XmlNode &dataNode);
 
         /** Get the text for latest error!
         * @return a string with a text that describe the error.*/
-        std::string GetErrorText();
+        std::string GetErrorText() const;
+
+        /** Add the memory used by this Spr to a report.
+        * @param usage is the report. */
+        void AddMemoryUsage(MemoryUsage& usage) const;
 
     protected:
 
@@ -0,0 +1,121 @@
+#ifndef DFP_SPRITEREGISTRY_H
+#define DFP_SPRITEREGISTRY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Commons.h"
+#include "Hash.h"
+
+namespace dfp
+{
+    class Sprite;
+
+    /** The id of a sprite in the SpriteRegistry. It is the FNV-1a hash of
+    * the sheet name, a '\0' and the sprite path, so the same path in two
+    * sheets has two ids:
+    *   static constexpr dfp::SheetSprId SLIME("enemies", "/slime/0");
+    * The id keeps the two pointers, so Find can compare the names when
+    * two sprites have the same hash. Create it from string literals, or
+    * from strings that live as long as the id. */
+    struct SheetSprId
+    {
+        /** The hash of the sheet name and the path */
+        uint32_t hash;
+
+        /** The names of the id, null terminated */
+        const char* sheetName;
+        const char* path;
+
+        /** Create the id, at compile time for literals. */
+        constexpr SheetSprId(const char* sheetName, const char* path)
+            : hash(HashPathStep(path, HashPath(sheetName) * HASH_FNV1A_PRIME)), sheetName(sheetName), path(path)
+        {}
+
+        constexpr bool operator==(const SheetSprId& other) const { return hash == other.hash; }
+        constexpr bool operator!=(const SheetSprId& other) const { return hash != other.hash; }
+    };
+
+    /** This class finds a sprite in all the loaded sheets, without knowing
+    * which sheet has it. Each sheet is registered with a name, then its
+    * sprites are found by (sheet name, path) with one probe in one table:
+    *   dfp::SpriteRegistry::Register("enemies", enemiesSprite);
+    *   dfp::SpriteRegistry::Entry entry;
+    *   if (dfp::SpriteRegistry::Find(dfp::SheetSprId("enemies", "/slime/0"), entry))
+    *       Draw(entry.sheet->GetImageFileName(), entry.x, entry.y, entry.w, entry.h);
+    *   dfp::SpriteRegistry::Unregister("enemies");
+    * The ids with the same hash are chained, and a lookup compares the
+    * sheet name and the path, so a collision never finds another sprite.
+    * Only the sprites of one sheet are added or removed by Register and
+    * Unregister, the other sheets are not changed. The registry keeps a
+    * shared pointer to each sheet until it is unregistered, so the sheet
+    * of an Entry is always valid. Register a sheet after it is parsed and
+    * do not parse it again while it is registered.
+    * Thread safety: all the functions can be called from many threads.
+    * The table is split in shards, each one with its own lock, so the
+    * lookups of many threads do not wait for each other. Register and
+    * Unregister are done one at a time. */
+    class SpriteRegistry
+    {
+    public:
+
+        /** The number of shards of the table, a power of 2 */
+        static const uint32_t SHARD_COUNT = 32;
+
+        /** A registered sprite */
+        struct Entry
+        {
+            /** The sheet that has the sprite */
+            std::shared_ptr<const Sprite> sheet;
+
+            /** The rectangle of the sprite in the image of the sheet */
+            unsigned int x;
+            unsigned int y;
+            unsigned int w;
+            unsigned int h;
+        };
+
+        /** Add all the sprites of a sheet. A sheet already registered with
+        * the same name is replaced.
+        * @param sheetName is the name of the sheet, it is used in the ids.
+        * @param sheet is the parsed sheet.
+        * @return ParseResult::OK, or ERROR_NOT_FOUND if the sheet is null. */
+        static ParseResult Register(const std::string &sheetName, const std::shared_ptr<const Sprite> &sheet);
+
+        /** Remove all the sprites of a sheet.
+        * @param sheetName is the name used by Register.
+        * @return false if the sheet is not registered. */
+        static bool Unregister(const std::string &sheetName);
+
+        /** Remove all the sheets */
+        static void Clear();
+
+        /** Find a sprite.
+        * @param id is the id of the sheet name and the path.
+        * @param entry gets the sheet and the rectangle.
+        * @return false if the sprite is not registered. */
+        static bool Find(SheetSprId id, Entry &entry);
+
+        /** Same as Find(SheetSprId, Entry&), with the hash computed at run time. */
+        static bool Find(const std::string &sheetName, const std::string &path, Entry &entry);
+
+        /** Getter for a registered sheet.
+        * @return the sheet, or null if it is not registered. */
+        static std::shared_ptr<const Sprite> GetSheet(const std::string &sheetName);
+
+        /** Getter for the names of the registered sheets */
+        static std::vector<std::string> GetSheetNames();
+
+        /** Getter for the number of registered sprites */
+        static size_t GetCount();
+
+        /** Get the text for latest error of Register!
+        * @return a string with a text that describe the error.*/
+        static std::string GetErrorText();
+    };
+
+}; //namespace dfp
+
+#endif //DFP_SPRITEREGISTRY_H
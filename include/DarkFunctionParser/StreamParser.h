@@ -0,0 +1,238 @@
+#ifndef DFP_STREAMPARSER_H
+#define DFP_STREAMPARSER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Commons.h"
+#include "XmlReader.h"
+
+namespace dfp
+{
+    class Sprite;
+    class Animations;
+    class Dir;
+    class Anim;
+    class Cell;
+
+    /** This is a parse that gets the text in chunks, for a file that comes
+    * from a decompressor, a pipe or the network. The chunks can be cut
+    * anywhere (even in a tag or in a UTF-8 char), and they are not kept:
+    * the objects are built while the text arrives, so the memory used is
+    * the memory of the document, plus one tag. The whole text and the
+    * xml nodes are never in memory, like with ParseText.
+    *   dfp::Sprite sprite;
+    *   dfp::SpriteStreamParser parser(sprite);
+    *   parser.Start("data/hero.sprites"); // only to compute the path
+    *   while (size_t size = Decompress(chunk, sizeof(chunk)))
+    *       if (parser.Feed(chunk, size) != dfp::ParseResult::OK) break;
+    *   dfp::ParseResult result = parser.Finish();
+    * The xml is read by XmlStreamReader, it supports the same xml as the
+    * "scanner" backend, the selected XmlBackend is not used. The document
+    * must not be used until Finish returned ParseResult::OK, after an
+    * error it can be partly filled. */
+    class StreamParser : protected XmlStreamHandler
+    {
+    public:
+
+        virtual ~StreamParser();
+
+        /** Prepare a new parse. It is not needed for the first parse,
+        * only to parse again or to set the path.
+        * Note: use '/' instead of '\\' as it is using '/' to find the path.
+        * @param fileName is the filename and path of the file, only used to
+        *        compute the path like in ParseBuffer. "" keeps the path. */
+        void Start(const std::string &fileName = "");
+
+        /** Parse the next chunk of the text.
+        * @param data is the chunk, it does not need to be null terminated.
+        * @param size is the size of the chunk in bytes.
+        * @return ParseResult::OK, or the error code of the parse. After an
+        *         error the next calls return the same error until Start. */
+        ParseResult Feed(const char *data, size_t size);
+
+        /** End the parse, after the last chunk: the xml is checked and the
+        * document is indexed.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult Finish();
+
+        /** Read a file in chunks and parse it: Start, Feed and Finish.
+        * @param fileName is the filename and path of the file (xml format).
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        ParseResult ParseFile(const std::string &fileName);
+
+        /** Getter for the result of the parse so far */
+        ParseResult GetResult() const;
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        std::string GetErrorText() const;
+
+    protected:
+
+        /** The constructor, used only by the derived classes */
+        StreamParser();
+
+        /** Set the path of the document from the file name */
+        virtual void SetFilePath(const std::string &fileName) = 0;
+
+        /** Forget the elements of the previous parse */
+        virtual void BeginDocument() = 0;
+
+        /** Check the document and build its index, when the xml is complete.
+        * @return ParseResult::OK if everithing was fine, or an error code!*/
+        virtual ParseResult EndDocument() = 0;
+
+        /** Getter and setter for the error text of the document */
+        virtual std::string GetDocumentErrorText() const = 0;
+        virtual void SetDocumentErrorText(const std::string &errorText) = 0;
+
+        /** Stop the parse with an error, from OnStartElement or OnEndElement.
+        * The error text must be already set in the document.
+        * @return false, for the XmlStreamReader. */
+        bool Stop(ParseResult result);
+
+        /** Stop with an error and its text */
+        ParseResult Fail(ParseResult result, const std::string &errorText);
+
+        /** The xml parser */
+        XmlStreamReader m_reader;
+
+        /** The result */
+        ParseResult m_result;
+
+        /** True after Finish */
+        bool m_finished;
+    };
+
+
+
+    /** The StreamParser for a *.sprites file. The Sprite must live longer
+    * than the parser. The load filter of the Sprite is used. */
+    class SpriteStreamParser : public StreamParser
+    {
+    public:
+
+        /** The constructor
+        * @param sprite is the object that will be filled. */
+        SpriteStreamParser(Sprite &sprite);
+
+    protected:
+
+        virtual void SetFilePath(const std::string &fileName);
+        virtual void BeginDocument();
+        virtual ParseResult EndDocument();
+        virtual std::string GetDocumentErrorText() const;
+        virtual void SetDocumentErrorText(const std::string &errorText);
+        virtual bool OnStartElement(const XmlNode &node, size_t depth);
+        virtual bool OnEndElement(size_t depth);
+
+        /** Stop with the error of a child of the open <dir> nodes, the text
+        * is the same as the one of Sprite::ParseText.
+        * @param nodeName is the name of the child ("dir" or "spr").
+        * @param errorText is the error of the child. */
+        bool FailDir(ParseResult result, const char *nodeName, std::string errorText);
+
+        /** What an open element is */
+        enum Context
+        {
+            CONTEXT_SKIP = 0,       ///< Not used, its childs are skipped too
+            CONTEXT_IMG,
+            CONTEXT_DEFINITIONS,
+            CONTEXT_DIR,
+        };
+
+        /** One open element */
+        struct Frame
+        {
+            Context context;
+
+            /** The Dir of a CONTEXT_DIR */
+            std::shared_ptr<Dir> dir;
+
+            /** The path of the dir, with a '/' at the end, only with a load filter */
+            std::string path;
+
+            /** False if the <spr> childs are skipped by the load filter */
+            bool loadSpr;
+
+            /** False if the <dir> childs are skipped, the root was skipped by the load filter */
+            bool loadDir;
+
+            /** True if the element has a child element */
+            bool hasChild;
+        };
+
+        /** The target */
+        Sprite &m_sprite;
+
+        /** The open elements, the first is the top level one */
+        std::vector<Frame> m_stack;
+
+        /** True when the <img> node was found */
+        bool m_hasRoot;
+    };
+
+
+
+    /** The StreamParser for a *.anim file. The Animations must live longer
+    * than the parser. */
+    class AnimationsStreamParser : public StreamParser
+    {
+    public:
+
+        /** The constructor
+        * @param animations is the object that will be filled. */
+        AnimationsStreamParser(Animations &animations);
+
+    protected:
+
+        virtual void SetFilePath(const std::string &fileName);
+        virtual void BeginDocument();
+        virtual ParseResult EndDocument();
+        virtual std::string GetDocumentErrorText() const;
+        virtual void SetDocumentErrorText(const std::string &errorText);
+        virtual bool OnStartElement(const XmlNode &node, size_t depth);
+        virtual bool OnEndElement(size_t depth);
+
+        /** Stop with the error of the current <anim>, or of its current <cell> */
+        bool FailAnim(ParseResult result);
+        bool FailCell(ParseResult result);
+
+        /** What an open element is */
+        enum Context
+        {
+            CONTEXT_SKIP = 0,       ///< Not used, its childs are skipped too
+            CONTEXT_ANIMATIONS,
+            CONTEXT_ANIM,
+            CONTEXT_CELL,
+        };
+
+        /** One open element */
+        struct Frame
+        {
+            Context context;
+
+            /** True if the element has a child element */
+            bool hasChild;
+        };
+
+        /** The target */
+        Animations &m_animations;
+
+        /** The open elements, the first is the top level one */
+        std::vector<Frame> m_stack;
+
+        /** The <anim> and the <cell> that are open */
+        std::shared_ptr<Anim> m_anim;
+        std::shared_ptr<Cell> m_cell;
+
+        /** True when the <animations> node was found */
+        bool m_hasRoot;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_STREAMPARSER_H
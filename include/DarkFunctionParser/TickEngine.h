@@ -0,0 +1,208 @@
+#ifndef DFP_TICKENGINE_H
+#define DFP_TICKENGINE_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "Commons.h"
+#include "Metrics.h"
+
+namespace dfp
+{
+    class Anim;
+    class Cell;
+
+    /** This is the integer version of the timing used by Anim::Update.
+    * All the delays of an <anim> are converted to fixed point microseconds
+    * (Q16, aka microseconds * 65536) so the playback does not depend on
+    * the float precision of the machine or of the compiler.
+    * The rules are the same as in Anim::Update:
+    *   - a delay of 0 is replaced by 1 millisecond;
+    *   - the cell is changed only when the elapsed time is strictly bigger
+    *     than the delay of the current cell;
+    *   - the animation is always looping. */
+    class TickTimeline
+    {
+    public:
+
+        /** The constructor */
+        TickTimeline();
+
+        /** Build the timeline from the cells of an Anim.
+        * @param anim is the animation. Can have 0 cells.
+        * @return ParseResult::OK or ERROR_MISSING_NODE if anim is null. */
+        ParseResult Build(std::shared_ptr<Anim> anim);
+
+        /** Getter for the number of cells */
+        uint32_t GetCellCount() const;
+
+        /** Getter for the sum of all delays (Q16 microseconds) */
+        uint64_t GetPeriod() const;
+
+        /** Getter for the delay (Q16 microseconds) of a cell */
+        uint64_t GetDelay(uint32_t cellIndex) const;
+
+        /** Getter for a cell.
+        * @return a shared pointer to the Cell, OR a null shared pointer */
+        std::shared_ptr<Cell> GetCell(uint32_t cellIndex) const;
+
+        /** Move the pair (cellIndex, elapsed) forward with "advance" time.
+        * The result is the same as calling the cell loop from Anim::Update,
+        * but it will cost O(log(cells)) no matter how big "advance" is, and
+        * O(1) when all the cells have the same delay.
+        * @param cellIndex is the current cell, will be changed.
+        * @param elapsed is the time spent in the current cell (Q16 microseconds), will be changed.
+        * @param advance is the time to add (Q16 microseconds). */
+        void Advance(uint32_t& cellIndex, uint64_t& elapsed, uint64_t advance) const;
+
+    protected:
+
+        /** The delay of each cell (Q16 microseconds) */
+        std::vector<uint64_t> m_delay;
+
+        /** m_start[i] is the sum of delays for the cells before i.
+        * It has m_delay.size() + 1 entries, the last one is the period. */
+        std::vector<uint64_t> m_start;
+
+        /** The cells, so we can return them without the Anim */
+        std::vector< std::shared_ptr<Cell> > m_cell;
+
+        /** The delay of all the cells if it is the same for all, or 0 */
+        uint64_t m_uniformDelay;
+    };
+
+
+
+    /** This is a deterministic playback engine for a population of
+    * animation instances. The time is counted in integer ticks, and each
+    * tick has a fixed duration in microseconds. The speed factor of
+    * each instance is a Q16 fixed point number (65536 == 1.0).
+    * Advance(K) will give bit-identical results on any platform, and
+    * is the same as calling Advance(1) K times.
+    * Usage:
+    *   dfp::TickEngine engine(1000); // 1 tick == 1 ms
+    *   uint32_t walk = engine.AddTimeline(animations.GetAnim("Walk"));
+    *   uint32_t id = engine.Spawn(walk, dfp::TickEngine::SPEED_ONE);
+    *   engine.Advance(16);
+    *   engine.GetCurrentCell(id);
+    * The instances that are not visible (see SetVisible) are skipped by
+    * Advance. The engine keeps the tick when they were hidden, and their
+    * cell is computed in O(log(cells)) when they are shown again or when
+    * GetCellIndex/GetCurrentCell is called. The result is the same as if
+    * they were advanced on every tick.*/
+    class TickEngine
+    {
+    public:
+
+        /** The Q16 value for a speed factor of 1.0 */
+        static const uint32_t SPEED_ONE = 65536;
+
+        /** This is returned by Spawn/AddTimeline when it fails */
+        static const uint32_t INVALID_ID = 0xFFFFFFFF;
+
+        /** The constructor
+        * @param tickMicroseconds is the duration of one tick. If 0, 1000 (1ms) is used. */
+        TickEngine(uint32_t tickMicroseconds = 1000);
+
+        /** Convert a float speed factor (like the one used by Anim::Update)
+        * to Q16. Do this only once, at setup, not every tick.
+        * @param animSpeedFactor if <= 0, it will be 1.0 (same as Anim::Update). */
+        static uint32_t ToSpeedQ16(float animSpeedFactor);
+
+        /** Getter for the tick duration in microseconds */
+        uint32_t GetTickMicroseconds() const;
+
+        /** Getter for the number of ticks since the engine was created */
+        uint64_t GetTick() const;
+
+        /** Add an animation that can be played by instances.
+        * @param anim is the animation.
+        * @return the id of the timeline OR INVALID_ID if anim is null or has no cells. */
+        uint32_t AddTimeline(std::shared_ptr<Anim> anim);
+
+        /** Getter for a timeline */
+        const TickTimeline& GetTimeline(uint32_t timelineId) const;
+
+        /** Create a new instance that plays a timeline from the first cell.
+        * @param timelineId is the value returned by AddTimeline.
+        * @param speedQ16 is the speed factor (Q16). If 0, SPEED_ONE is used.
+        * @return the instance id OR INVALID_ID if the timeline does not exist. */
+        uint32_t Spawn(uint32_t timelineId, uint32_t speedQ16 = SPEED_ONE);
+
+        /** Remove an instance. The id can be reused by a later Spawn. */
+        void Despawn(uint32_t instanceId);
+
+        /** Change the speed factor of an instance (Q16). If 0, SPEED_ONE is used.
+        * A hidden instance is first brought up to date with the old speed. */
+        void SetSpeed(uint32_t instanceId, uint32_t speedQ16);
+
+        /** Show or hide an instance. A hidden instance costs nothing in
+        * Advance, and it is brought up to date when it is shown again.
+        * The new instances are visible.
+        * @param instanceId is the instance.
+        * @param visible is the new state. */
+        void SetVisible(uint32_t instanceId, bool visible);
+
+        /** Getter for the visibility of an instance */
+        bool IsVisible(uint32_t instanceId) const;
+
+        /** Advance all the instances with a number of ticks.
+        * @param ticks is the number of ticks. */
+        void Advance(uint32_t ticks);
+
+        /** Getter for the current cell index of an instance. For a hidden
+        * instance, it is computed from the ticks since it was hidden. */
+        uint32_t GetCellIndex(uint32_t instanceId) const;
+
+        /** Getter for the current cell of an instance.
+        * @return a shared pointer to the Cell, OR a null shared pointer */
+        std::shared_ptr<Cell> GetCurrentCell(uint32_t instanceId) const;
+
+        /** Getter for the number of alive instances */
+        uint32_t GetInstanceCount() const;
+
+    protected:
+
+        /** The time to add to an instance for a number of ticks (Q16 microseconds).
+        * When the product is too big, the result is reduced modulo the period.
+        * @param timeline is the timeline of the instance.
+        * @param ticks is the number of ticks.
+        * @param speedQ16 is the speed of the instance. */
+        uint64_t GetAdvance(const TickTimeline& timeline, uint64_t ticks, uint32_t speedQ16) const;
+
+        /** Bring a hidden instance up to date, after this its cell is valid
+        * for the current tick. */
+        void CatchUp(uint32_t instanceId);
+
+        /** The duration of one tick */
+        uint32_t m_tickMicroseconds;
+
+        /** The number of ticks from the creation */
+        uint64_t m_tick;
+
+        /** All the timelines added with AddTimeline */
+        std::vector<TickTimeline> m_timeline;
+
+        /** The instances are stored as a structure of arrays,
+        * the index in each vector is the instance id. */
+        std::vector<uint32_t> m_instTimeline;
+        std::vector<uint32_t> m_instCell;
+        std::vector<uint64_t> m_instElapsed;
+        std::vector<uint32_t> m_instSpeed;
+        std::vector<uint8_t> m_instAlive;
+        std::vector<uint8_t> m_instVisible;
+
+        /** For a hidden instance, the tick when its cell was computed */
+        std::vector<uint64_t> m_instSyncTick;
+
+        /** The ids released by Despawn */
+        std::vector<uint32_t> m_freeIds;
+
+        /** The alive instances, in Metrics::GAUGE_TICK_INSTANCES */
+        MetricsGauge m_instanceGauge;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_TICKENGINE_H
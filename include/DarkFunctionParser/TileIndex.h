@@ -0,0 +1,174 @@
+#ifndef DFP_TILEINDEX_H
+#define DFP_TILEINDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Commons.h"
+#include "Hash.h"
+
+namespace dfp
+{
+    class Sprite;
+    class Animations;
+
+    /** A set of texture tiles, stored as a bit array. Used to collect the
+    * tiles of many anims without duplicates. The tile id is
+    * tileY * tilesX + tileX (see TileIndex). */
+    class TileSet
+    {
+    public:
+
+        /** The constructor, the set is empty and can hold 0 tiles */
+        TileSet();
+
+        /** Remove all the tiles and set the number of tiles that can be added.
+        * @param tileCount is TileIndex::GetTileCount(). */
+        void Reset(uint32_t tileCount);
+
+        /** Remove all the tiles */
+        void Clear();
+
+        /** Add a tile, ignored if it is out of range */
+        void Add(uint32_t tile);
+
+        /** Check if a tile is in the set */
+        bool Contains(uint32_t tile) const;
+
+        /** Getter for the number of tiles in the set */
+        uint32_t GetCount() const;
+
+        /** Get all the tiles in the set, sorted.
+        * @param tiles will receive the tile ids (the old content is removed). */
+        void GetTiles(std::vector<uint32_t> &tiles) const;
+
+    private:
+
+        /** One bit for each tile */
+        std::vector<uint64_t> m_bits;
+
+        /** The number of tiles that can be added */
+        uint32_t m_tileCount;
+
+        /** The number of tiles in the set */
+        uint32_t m_count;
+    };
+
+
+
+    /** This class finds the texture tiles used by anims, for the streaming
+    * of big sprite sheets. The sheet is split in square tiles of tileSize
+    * pixels, and Build computes once the tiles covered by the rect of each
+    * Spr, by each cell and by each anim. After that, a query only copies
+    * a few precomputed tile ids in a TileSet, so it can run every frame:
+    *   dfp::TileIndex index;
+    *   index.Build(animations, sprite, 256);
+    *   dfp::TileSet tiles;
+    *   tiles.Reset(index.GetTileCount());
+    *   index.AddAnimTiles(index.FindAnim(dfp::AnimId("Walk")), tiles);
+    *   tiles.GetTiles(tileIds); // prefetch these
+    * The position of a <spr> in a cell (x, y) is the position on the
+    * screen, so it does not change the tiles. */
+    class TileIndex
+    {
+    public:
+
+        /** Returned when an index is not found */
+        static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+        /** The constructor */
+        TileIndex();
+
+        /** Compute the tiles of all the anims. The old content is removed.
+        * A sprite that is missing in the sprite sheet has no tiles, it is
+        * reported by GetMissingSprites. Like Animations::GetAnim(AnimId),
+        * an anim of Animations::GetIdCollisions is not found by FindAnim.
+        * @param animations is the parsed *.anim.
+        * @param sprite is the parsed sprite sheet of the animations.
+        * @param tileSize is the size of a tile in pixels.
+        * @return ParseResult::OK or ERROR_NUMERIC_ATTRIBUTE_WRONG if the tile
+        *         or image size is 0. */
+        ParseResult Build(const Animations &animations, const Sprite &sprite, uint32_t tileSize);
+
+        /** Getter for the sprite paths used by the cells that are not in the
+        * sprite sheet, found by the last Build.
+        * @return the paths, empty if all the sprites were found. */
+        const std::vector<std::string>& GetMissingSprites() const;
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        std::string GetErrorText() const;
+
+        /** Getter for the tile size in pixels */
+        uint32_t GetTileSize() const;
+
+        /** Getter for the number of tiles on x */
+        uint32_t GetTilesX() const;
+
+        /** Getter for the number of tiles on y */
+        uint32_t GetTilesY() const;
+
+        /** Getter for the number of tiles (GetTilesX() * GetTilesY()) */
+        uint32_t GetTileCount() const;
+
+        /** Getter for the number of anims */
+        uint32_t GetAnimCount() const;
+
+        /** Get the index of an anim.
+        * @param id is the id of the anim name.
+        * @return the index, or INVALID_INDEX */
+        uint32_t FindAnim(AnimId id) const;
+
+        /** Add the tiles used by all the cells of an anim.
+        * @param animIndex is the value returned by FindAnim.
+        * @param tiles is the set that receives the tiles. */
+        void AddAnimTiles(uint32_t animIndex, TileSet &tiles) const;
+
+        /** Add the tiles used by one cell of an anim.
+        * @param animIndex is the value returned by FindAnim.
+        * @param cellIndex is the index of the cell in Anim::GetCells (see Anim::GetCurrentCellIndex).
+        * @param tiles is the set that receives the tiles. */
+        void AddCellTiles(uint32_t animIndex, uint32_t cellIndex, TileSet &tiles) const;
+
+    private:
+
+        /** A range in m_tiles */
+        struct TileRange
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+
+        /** Add the tiles of a rect to a sorted list without duplicates */
+        void AddRectTiles(uint32_t x, uint32_t y, uint32_t w, uint32_t h, std::vector<uint32_t> &tiles) const;
+
+        /** Is the text for latest error */
+        std::string m_errorText;
+
+        uint32_t m_tileSize;
+        uint32_t m_tilesX;
+        uint32_t m_tilesY;
+
+        /** All the tile lists, each list is sorted */
+        std::vector<uint32_t> m_tiles;
+
+        /** The tiles of each anim (all its cells) */
+        std::vector<TileRange> m_animTiles;
+
+        /** The first cell of each anim in m_cellTiles */
+        std::vector<TileRange> m_animCells;
+
+        /** The tiles of each cell */
+        std::vector<TileRange> m_cellTiles;
+
+        /** Pair (AnimId, anim index) */
+        HashIndex m_animIndex;
+
+        /** See GetMissingSprites */
+        std::vector<std::string> m_missingSprites;
+    };
+
+}; //namespace dfp
+
+#endif //DFP_TILEINDEX_H
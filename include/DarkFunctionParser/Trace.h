@@ -0,0 +1,106 @@
+#ifndef DFP_TRACE_H
+#define DFP_TRACE_H
+
+#include <cstdint>
+#include <string>
+
+#include "Commons.h"
+
+namespace dfp
+{
+    /** This class records a timeline of the parsing, and writes it in the
+    * Chrome trace event format (JSON), that can be opened with
+    * chrome://tracing or https://ui.perfetto.dev
+    * The library records the events only when it is built with
+    * DFP_ENABLE_TRACE defined. Without it, the DFP_TRACE_SCOPE macros are
+    * empty, so there is no cost at all, and the trace is always empty.
+    *   dfp::Trace::Start();
+    *   ... load the assets, from any thread ...
+    *   dfp::Trace::Stop();
+    *   dfp::Trace::WriteJson("load.json");
+    * Each thread records in its own buffer, so the threads do not wait
+    * for each other while the trace is on. */
+    class Trace
+    {
+    public:
+
+        /** Remove the old events and start the recording */
+        static void Start();
+
+        /** Stop the recording, the events are kept */
+        static void Stop();
+
+        /** Check if the recording is on */
+        static bool IsEnabled();
+
+        /** Getter for the time used by the events.
+        * @return microseconds from an unspecified point. */
+        static uint64_t Now();
+
+        /** Add an event ("complete" event of the Chrome format).
+        * @param name must be a literal, it is not copied.
+        * @param fileName is an optional argument, shown with the event.
+        * @param start is the start time (see Now).
+        * @param duration is the duration in microseconds. */
+        static void AddEvent(const char *name, const std::string &fileName, uint64_t start, uint64_t duration);
+
+        /** Getter for the number of recorded events */
+        static size_t GetEventCount();
+
+        /** Get all the recorded events as JSON.
+        * @return the text of the trace. */
+        static std::string GetJson();
+
+        /** Write the recorded events in a file.
+        * @param fileName is the output file.
+        * @return ParseResult::OK or ERROR_COULDNT_WRITE. */
+        static ParseResult WriteJson(const std::string &fileName);
+    };
+
+
+
+    /** Record an event for the lifetime of this object. Use DFP_TRACE_SCOPE
+    * instead of this class, so it is removed when the trace is not enabled. */
+    class TraceScope
+    {
+    public:
+
+        /** The constructor, the event starts.
+        * @param name must be a literal, it is not copied. */
+        TraceScope(const char *name);
+
+        /** The constructor, the event starts.
+        * @param name must be a literal, it is not copied.
+        * @param fileName is shown with the event. */
+        TraceScope(const char *name, const std::string &fileName);
+
+        /** The destructor, the event ends. */
+        ~TraceScope();
+
+    private:
+
+        TraceScope(const TraceScope&);
+        TraceScope& operator=(const TraceScope&);
+
+        const char *m_name;
+        std::string m_fileName;
+        uint64_t m_start;
+    };
+
+}; //namespace dfp
+
+
+#define DFP_TRACE_CONCAT_IMPL(a, b) a##b
+#define DFP_TRACE_CONCAT(a, b) DFP_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef DFP_ENABLE_TRACE
+/** Record the current scope */
+#define DFP_TRACE_SCOPE(name) dfp::TraceScope DFP_TRACE_CONCAT(dfpTraceScope, __LINE__)(name)
+/** Record the current scope, with a file name */
+#define DFP_TRACE_SCOPE_FILE(name, fileName) dfp::TraceScope DFP_TRACE_CONCAT(dfpTraceScope, __LINE__)(name, fileName)
+#else
+#define DFP_TRACE_SCOPE(name)
+#define DFP_TRACE_SCOPE_FILE(name, fileName)
+#endif
+
+#endif //DFP_TRACE_H
@@ -0,0 +1,288 @@
+#ifndef DFP_XMLREADER_H
+#define DFP_XMLREADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dfp
+{
+    class XmlBackend;
+
+    /** A read-only handle to an element of a parsed XmlDocument. It is a
+    * small value (two pointers), it is valid while the document lives.
+    * Only the elements are visited: the text, the comments and the
+    * declarations are skipped by all the backends. */
+    class XmlNode
+    {
+    public:
+
+        /** The constructor of an invalid node */
+        XmlNode()
+            : m_backend(nullptr)
+            , m_node(nullptr)
+        {}
+
+        /** The constructor, used by the backends
+        * @param backend is the backend that created the node.
+        * @param node is the node of the backend, nullptr for an invalid node. */
+        XmlNode(const XmlBackend *backend, const void *node)
+            : m_backend(node ? backend : nullptr)
+            , m_node(node)
+        {}
+
+        /** True if the node exists */
+        explicit operator bool() const
+        {
+            return m_node != nullptr;
+        }
+
+        /** Getter for the name of the element.
+        * @return the name, or "" for an invalid node. */
+        const char *Value() const;
+
+        /** Getter for an attribute.
+        * @param name is the name of the attribute.
+        * @return the value, or nullptr if the attribute does not exist. */
+        const char *Attribute(const char *name) const;
+
+        /** Getter for the first child element, invalid if there is none */
+        XmlNode FirstChild() const;
+
+        /** Getter for the next sibling element, invalid if there is none */
+        XmlNode NextSibling() const;
+
+        /** Getter for the node of the backend */
+        const void *GetHandle() const
+        {
+            return m_node;
+        }
+
+    private:
+
+        const XmlBackend *m_backend;
+        const void *m_node;
+    };
+
+
+
+    /** A parsed XML document, created by XmlBackend::CreateDocument. */
+    class XmlDocument
+    {
+    public:
+
+        virtual ~XmlDocument() {}
+
+        /** Parse a text. The document does not keep any pointer to the
+        * text, it can be released when this returns. The old content
+        * is removed.
+        * @param text is the xml, it does not need a '\0' at the end.
+        * @param size is the size of the text in bytes.
+        * @return false if the text is not valid. */
+        virtual bool Parse(const char *text, size_t size) = 0;
+
+        /** True if the latest Parse failed */
+        virtual bool Error() const = 0;
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        virtual std::string GetErrorText() const = 0;
+
+        /** Getter for the first top level element, invalid if there is
+        * none. The other top level elements are its siblings. */
+        virtual XmlNode GetRoot() const = 0;
+    };
+
+
+
+    /** The interface of an XML parser. The node building code of Sprite,
+    * Animations and the ParseTasks only uses this interface, so the
+    * parser can be chosen for each platform:
+    *   - "tinyxml2": the default, not built if DFP_NO_TINYXML2 is defined;
+    *   - "scanner": the built-in parser, always available. It copies the
+    *     text once and builds a flat array of nodes, with no allocation
+    *     per node. It supports what the darkFunction Editor writes (no
+    *     DTD, the text content is ignored);
+    *   - "pugixml": built if DFP_USE_PUGIXML is defined;
+    *   - "rapidxml": built if DFP_USE_RAPIDXML is defined.
+    * The backend is selected at run time with SetXmlBackend. */
+    class XmlBackend
+    {
+    public:
+
+        virtual ~XmlBackend() {}
+
+        /** Getter for the name of the backend */
+        virtual const char *GetName() const = 0;
+
+        /** Create an empty document, it is deleted by the caller. */
+        virtual XmlDocument *CreateDocument() const = 0;
+
+        /** The implementation of XmlNode, the nodes are never nullptr */
+        virtual const char *GetNodeName(const void *node) const = 0;
+        virtual const char *GetAttribute(const void *node, const char *name) const = 0;
+        virtual const void *GetFirstChild(const void *node) const = 0;
+        virtual const void *GetNextSibling(const void *node) const = 0;
+    };
+
+    /** Getters for the backends.
+    * @return the backend, or nullptr if it is not built. */
+    const XmlBackend *GetTinyXml2Backend();
+    const XmlBackend *GetScannerBackend();
+    const XmlBackend *GetPugiXmlBackend();
+    const XmlBackend *GetRapidXmlBackend();
+
+    /** Getter for all the backends that are built */
+    std::vector<const XmlBackend *> GetXmlBackends();
+
+    /** Find a backend.
+    * @param name is the name of the backend ("tinyxml2", "scanner"...).
+    * @return the backend, or nullptr if it is not built. */
+    const XmlBackend *FindXmlBackend(const std::string &name);
+
+    /** Select the backend used by all the next parses (thread safe, a
+    * parse already started keeps its backend).
+    * @param backend is the backend, nullptr selects the default one. */
+    void SetXmlBackend(const XmlBackend *backend);
+
+    /** Getter for the backend used by the parses */
+    const XmlBackend *GetXmlBackend();
+
+
+
+    /** The receiver of the elements read by an XmlStreamReader. */
+    class XmlStreamHandler
+    {
+    public:
+
+        virtual ~XmlStreamHandler() {}
+
+        /** Called for each start tag.
+        * @param node is the element, with its attributes but without any
+        *        child or sibling. It is valid only during the call.
+        * @param depth is the number of open parents, 0 for a top level element.
+        * @return false to stop the parse. */
+        virtual bool OnStartElement(const XmlNode &node, size_t depth) = 0;
+
+        /** Called for each end tag, and after OnStartElement for an empty
+        * element (<spr .../>).
+        * @param depth is the same as in OnStartElement.
+        * @return false to stop the parse. */
+        virtual bool OnEndElement(size_t depth) = 0;
+    };
+
+    /** An XML parser that gets the text in chunks, cut anywhere, and
+    * calls a handler for each element, so the text and the nodes are
+    * never all in memory. Only the markup being read (one tag), the
+    * names of the open elements and a few counters are kept. It supports
+    * the same XML as the "scanner" backend:
+    *   dfp::XmlStreamReader reader;
+    *   while (size_t size = fread(chunk, 1, sizeof(chunk), file))
+    *       if (!reader.Feed(chunk, size, handler)) break;
+    *   reader.Finish(); */
+    class XmlStreamReader
+    {
+        friend class StreamNodeBackend;
+    public:
+
+        /** A tag longer than this is an error, so a broken text can not
+        * use all the memory. */
+        static const size_t MAX_TAG_SIZE = 1024 * 1024;
+
+        /** The constructor, ready for a new text */
+        XmlStreamReader();
+
+        /** Forget the current text, ready for a new one */
+        void Reset();
+
+        /** Parse the next part of the text. The chunk is not kept.
+        * @param data is the chunk, it does not need a '\0' at the end.
+        * @param size is the size of the chunk in bytes.
+        * @param handler receives the elements that are complete.
+        * @return false if the text is not valid or the handler stopped,
+        *         the next calls do nothing until Reset. */
+        bool Feed(const char *data, size_t size, XmlStreamHandler &handler);
+
+        /** Check the end of the text, after the last Feed.
+        * @return false if an element or a markup is not terminated. */
+        bool Finish();
+
+        /** True if the text is not valid */
+        bool Error() const;
+
+        /** Get the text for latest error!
+        * @return a string with a text that describe the error.*/
+        std::string GetErrorText() const;
+
+    private:
+
+        enum State
+        {
+            STATE_TEXT = 0,     ///< Between the tags, the text content is not used
+            STATE_MARKUP,       ///< After '<', the kind of markup is not known yet
+            STATE_TAG,          ///< In a start or an end tag, it is kept in m_tag
+            STATE_SKIP,         ///< In a comment, a CDATA or a declaration, until m_terminator
+        };
+
+        /** Stop with an error at the line of the current markup */
+        bool Fail(const char *message);
+
+        /** Read a tag from m_tag and call the handler */
+        bool ProcessTag(XmlStreamHandler &handler);
+
+        State m_state;
+
+        /** The markup being read, without the '<' */
+        std::string m_tag;
+
+        /** The attributes of the current element, pairs (name, value)
+        * that point in m_tag */
+        std::vector<const char *> m_attrs;
+
+        /** The quote of the attribute value being read in m_tag, or 0 */
+        char m_quote;
+
+        /** The end of the markup skipped by STATE_SKIP, and the number of
+        * its chars that were just read */
+        const char *m_terminator;
+        size_t m_matched;
+
+        /** The names of the open elements, one after the other, and the
+        * start of each name */
+        std::string m_openNames;
+        std::vector<size_t> m_openStart;
+
+        /** The line of the text, and the line where the current markup starts */
+        uint32_t m_line;
+        uint32_t m_markupLine;
+
+        bool m_hasRoot;
+        bool m_stopped;
+        bool m_error;
+        std::string m_errorText;
+    };
+
+    inline const char *XmlNode::Value() const
+    {
+        return m_node ? m_backend->GetNodeName(m_node) : "";
+    }
+
+    inline const char *XmlNode::Attribute(const char *name) const
+    {
+        return m_node ? m_backend->GetAttribute(m_node, name) : nullptr;
+    }
+
+    inline XmlNode XmlNode::FirstChild() const
+    {
+        return m_node ? XmlNode(m_backend, m_backend->GetFirstChild(m_node)) : XmlNode();
+    }
+
+    inline XmlNode XmlNode::NextSibling() const
+    {
+        return m_node ? XmlNode(m_backend, m_backend->GetNextSibling(m_node)) : XmlNode();
+    }
+
+}; //namespace dfp
+
+#endif //DFP_XMLREADER_H
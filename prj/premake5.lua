@@ -73,4 +73,36 @@ project "DarkFunctionParser"
     end
 
 	
-	
\ No newline at end of file
+	
+
+-------------------------------------------------------------------------------
+-- Tools (desktop only)
+-------------------------------------------------------------------------------
+function addTool(name)
+    project(name)
+        kind "ConsoleApp"
+        files
+        {
+            "../tools/" .. name .. "/**",
+        }
+        includedirs
+        {
+            "../include/",
+            "../../tinyxml2/include",
+        }
+        libdirs
+        {
+            "../lib/" .. GetPathFromPlatform(),
+            "../../tinyxml2/lib/" .. GetPathFromPlatform(),
+        }
+        links { "DarkFunctionParser", "tinyxml2" }
+        targetdir("../tools/bin/" .. GetPathFromPlatform())
+end
+
+if not IsIos() and not IsXCode() and not IsWin8StoreApp() then
+    addTool "dfp-embed"
+    addTool "dfp-bundle"
+    addTool "dfp-validate"
+    addTool "dfp-xmlbench"
+    addTool "dfp-replay"
+end
@@ -1,14 +1,17 @@
 #include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Trace.h"
+#include "DarkFunctionParser/ParseCache.h"
+#include "DarkFunctionParser/Metrics.h"
+#include "DarkFunctionParser/Recorder.h"
 #include "DarkFunctionParser/Sprite.h"
-
-#if defined(I3D_PLATFORM_S3E)
-#include "tinyxml.h"
-#else
-#include <tinyxml2/tinyxml2.h>
-#endif
+#include "DarkFunctionParser/XmlReader.h"
 
 //#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <sstream>
+#include <tuple>
 
 namespace dfp
 {
@@ -27,6 +30,10 @@ namespace dfp
 		m_animationPath = obj.m_animationPath;
 		m_spriteFileName = obj.m_spriteFileName;
 		m_ver = obj.m_ver;
+		m_memoryUsage = obj.m_memoryUsage;
+		m_animById = obj.m_animById;
+		m_animIndex = obj.m_animIndex;
+		m_idCollisions = obj.m_idCollisions;
 
 		for (const auto& anim : obj.m_anim)
 			m_anim[anim.first] = anim.second;
@@ -38,6 +45,10 @@ namespace dfp
 		m_animationPath = obj->m_animationPath;
 		m_spriteFileName = obj->m_spriteFileName;
 		m_ver = obj->m_ver;
+		m_memoryUsage = obj->m_memoryUsage;
+		m_animById = obj->m_animById;
+		m_animIndex = obj->m_animIndex;
+		m_idCollisions = obj->m_idCollisions;
 
 		for (const auto& anim : obj->m_anim)
 			m_anim[anim.first] = anim.second;
@@ -54,6 +65,10 @@ namespace dfp
 		m_animationPath = obj.m_animationPath;
 		m_spriteFileName = obj.m_spriteFileName;
 		m_ver = obj.m_ver;
+		m_memoryUsage = obj.m_memoryUsage;
+		m_animById = obj.m_animById;
+		m_animIndex = obj.m_animIndex;
+		m_idCollisions = obj.m_idCollisions;
 
 		m_anim.clear();
 
@@ -65,14 +80,16 @@ namespace dfp
 
 
 
-    std::string Animations::GetSpriteFileName(bool onlyFileName)
+    std::string Animations::GetSpriteFileName(bool onlyFileName) const
     { 
         if (onlyFileName)
             return m_spriteFileName;
 
-        std::string spritePathFileName = "";
-        if (!m_animationPath.empty())
-            spritePathFileName = m_animationPath;
+        /// The *.anim file was loaded from the current directory.
+        if (m_animationPath.empty())
+            return m_spriteFileName;
+
+        std::string spritePathFileName = m_animationPath;
         if (*m_animationPath.rbegin() != '/')
             spritePathFileName += "/";
 
@@ -81,29 +98,59 @@ namespace dfp
         return spritePathFileName;
     }
 
-    std::string Animations::GetErrorText(){ return m_errorText; }
+    std::string Animations::GetErrorText() const { return m_errorText; }
 
-    std::shared_ptr<Anim> Animations::GetAnim(const std::string& animName)
+    std::shared_ptr<Anim> Animations::GetAnim(const std::string& animName) const
     {
         auto it = m_anim.find(animName);
 
         if (it == m_anim.end())
             return nullptr;
 
-        return std::make_shared<Anim>(m_anim[animName]);
+        std::shared_ptr<Anim> anim = std::make_shared<Anim>(it->second);
+        DFP_RECORD(OnSpawn(*anim));
+        return anim;
     }
 
-    ParseResult Animations::ParseFile(const std::string &fileName)
+    std::shared_ptr<Anim> Animations::GetAnim(AnimId id) const
     {
-        ParseResult errorsCode = ParseResult::OK;
+        uint32_t index = m_animIndex.Find(id.hash);
+
+        if (index == HashIndex::INVALID_INDEX)
+            return nullptr;
+
+        std::shared_ptr<Anim> anim = std::make_shared<Anim>(m_animById[index]);
+        DFP_RECORD(OnSpawn(*anim));
+        return anim;
+    }
 
+    const std::vector<std::string>& Animations::GetIdCollisions() const
+    {
+        return m_idCollisions;
+    }
+
+    void Animations::SetFilePath(const std::string &fileName)
+    {
         int lastSlash = fileName.find_last_of("/");
 
         // Get the directory of the file using substring.
         if (lastSlash > 0)
-        {
             m_animationPath = fileName.substr(0, lastSlash + 1);
-        }
+        else
+            m_animationPath = "";
+    }
+
+    ParseResult Animations::ParseFile(const std::string &fileName)
+    {
+        DFP_TRACE_SCOPE_FILE("Animations::ParseFile", fileName);
+
+        ParseResult cachedResult;
+        if (ParseCache::ParseFile(fileName, *this, cachedResult))
+            return cachedResult;
+
+        ParseResult errorsCode = ParseResult::OK;
+
+        SetFilePath(fileName);
 
         char* fileText;
         int fileSize;
@@ -141,93 +188,279 @@ namespace dfp
         // Allocate memory for the file and read it into the memory.
         fileText = new char[fileSize + 1];
         fileText[fileSize] = 0;
+        {
+            DFP_TRACE_SCOPE_FILE("ReadFile", fileName);
 #ifdef USE_SDL2_LOAD
-        file->read(file, fileText, 1, fileSize);
+            file->read(file, fileText, 1, fileSize);
 #else
-        fread(fileText, 1, fileSize, file);
+            fread(fileText, 1, fileSize, file);
 #endif
 
 #ifdef USE_SDL2_LOAD
-        file->close(file);
+            file->close(file);
 #else
-        fclose(file);
+            fclose(file);
 #endif
+        }
 
-        // Copy the contents into a C++ string and delete it from memory.
-        std::string text(fileText, fileText + fileSize);
+        ParseResult result = ParseText(fileText, fileSize);
         delete[] fileText;
 
-        return ParseText(text);
+        return result;
+    }
+
+    ParseResult Animations::ParseBuffer(const char *data, size_t size, const std::string &fileName)
+    {
+        SetFilePath(fileName);
+
+        return ParseText(data, size);
     }
 
     ParseResult Animations::ParseText(const std::string &text)
     {
-        // Create a tiny xml document and use it to parse the text.
-        tinyxml2::XMLDocument doc;
-        doc.Parse(text.c_str());
+        return ParseText(text.c_str(), text.size());
+    }
 
+    ParseResult Animations::ParseText(const char *text, size_t size)
+    {
+        DFP_TRACE_SCOPE("Animations::ParseText");
+
+        // Create an xml document of the selected backend and use it to parse the text.
+        std::unique_ptr<XmlDocument> doc(GetXmlBackend()->CreateDocument());
+        {
+            DFP_TRACE_SCOPE("XmlDocument::Parse");
+            doc->Parse(text, size);
+        }
+
+        XmlNode node;
+        ParseResult result = ParseRoot(*doc, node);
+        if (result != ParseResult::OK)
+            return result;
+
+        while (node)
+        {
+            result = ParseChild(node);
+            if (result != ParseResult::OK)
+                return result;
+
+            node = node.NextSibling();
+        }
+
+        result = BuildIndex();
+        if (result != ParseResult::OK)
+            return result;
+
+        ComputeMemoryUsage();
+
+        return ParseResult::OK;
+    }
+
+    ParseResult Animations::ParseRoot(const XmlDocument &doc, XmlNode &firstChild)
+    {
         // Check for parsing errors.
         if (doc.Error())
         {
-			m_errorText = doc.GetErrorStr1();
-			m_errorText += doc.GetErrorStr2();
+			m_errorText = doc.GetErrorText();
             return ParseResult::ERROR_PARSING_FAILED;
         }
 
-        tinyxml2::XMLElement *imgNode = doc.FirstChildElement("animations");
-        if (!imgNode)
+        XmlNode imgElem = doc.GetRoot();
+        while (imgElem && strcmp(imgElem.Value(), "animations") != 0)
+            imgElem = imgElem.NextSibling();
+        if (!imgElem)
         {
             m_errorText = "Cannot find node <animations> !";
             return ParseResult::ERROR_MISSING_NODE;
         }
 
-        tinyxml2::XMLElement* imgElem = imgNode->ToElement();
+        ParseResult result = ParseRootAttributes(imgElem);
+        if (result != ParseResult::OK)
+            return result;
+
+        firstChild = imgElem.FirstChild();
 
+        if (!firstChild)
+        {
+            m_errorText = "The <spriteSheet> node does not have child nodes!";
+            return ParseResult::ERROR_SPRITE_PATHNAME_WRONG;
+        }
+
+        return ParseResult::OK;
+    }
+
+    ParseResult Animations::ParseRootAttributes(const XmlNode &imgElem)
+    {
         // Read the map attributes.
-        m_spriteFileName = imgElem->Attribute("spriteSheet");
+        const char *spriteSheet = imgElem.Attribute("spriteSheet");
+        m_spriteFileName = spriteSheet ? spriteSheet : "";
         if (m_spriteFileName.empty())
         {
             m_errorText = "Cannot find attribute 'spriteSheet' or the value is empty!";
             return ParseResult::ERROR_SPRITE_PATHNAME_WRONG;
         }
 
-        m_ver = imgElem->Attribute("ver");
+        const char *ver = imgElem.Attribute("ver");
+        m_ver = ver ? ver : "";
         if (m_ver.empty())
         {
             m_errorText = "Cannot find attribute 'ver' or the value is empty!";
             return ParseResult::ERROR_ANIMATIONS_VER_MISSING;
         }
 
-        const tinyxml2::XMLNode *node = imgElem->FirstChild();
+        return ParseResult::OK;
+    }
 
-        if (!node)
+    ParseResult Animations::ParseChild(const XmlNode &node)
+    {
+        if (strcmp(node.Value(), "anim") == 0)
         {
-            m_errorText = "The <spriteSheet> node does not have child nodes!";
-            return ParseResult::ERROR_SPRITE_PATHNAME_WRONG;
+            std::shared_ptr<Anim> anim = std::make_shared<Anim>();
+
+            ParseResult result = anim->ParseXML(node);
+            if (result == ParseResult::OK)
+            {
+                m_anim[anim->GetName()] = anim;
+            }
+            else
+            {
+                m_errorText = "Parsing <anim> Failed! >> " + anim->GetErrorText();
+                return result;
+            }
         }
 
-        while (node)
+        return ParseResult::OK;
+    }
+
+    ParseResult Animations::BuildIndex()
+    {
+        m_animById.clear();
+        m_animIndex.Clear();
+        m_idCollisions.clear();
+
+        /// Same as Sprite::BuildIndex, the ids of a collision are removed.
+        std::vector<uint32_t> collided;
+        m_animById.reserve(m_anim.size());
+        for (const auto& anim : m_anim)
         {
-            if (strcmp(node->Value(), "anim") == 0)
+            uint32_t hash = AnimId(anim.first).hash;
+            uint32_t other = m_animIndex.Find(hash);
+            if (other != HashIndex::INVALID_INDEX)
             {
-                std::shared_ptr<Anim> anim = std::make_shared<Anim>();
+                if (std::find(collided.begin(), collided.end(), hash) == collided.end())
+                {
+                    collided.push_back(hash);
+                    m_idCollisions.push_back(m_animById[other]->GetName());
+                }
+                m_idCollisions.push_back(anim.first);
+            }
+            else
+                m_animIndex.Insert(hash, (uint32_t)m_animById.size());
 
-                ParseResult result = anim->ParseXML(node);
-                if (result == ParseResult::OK)
+            m_animById.push_back(anim.second);
+        }
+
+        for (size_t i = 0; i < collided.size(); i++)
+            m_animIndex.Erase(collided[i]);
+
+        return ParseResult::OK;
+    }
+
+    void Animations::ComputeMemoryUsage()
+    {
+        MemoryUsage usage;
+        std::set<const void*> visited;
+
+        usage.AddObject(MemoryUsage::NODE_DOCUMENT, sizeof(Animations));
+        usage.AddString(MemoryUsage::NODE_DOCUMENT, m_errorText);
+        usage.AddString(MemoryUsage::NODE_DOCUMENT, m_animationPath);
+        usage.AddString(MemoryUsage::NODE_DOCUMENT, m_spriteFileName);
+        usage.AddString(MemoryUsage::NODE_DOCUMENT, m_ver);
+
+        usage.AddMapNodes(MemoryUsage::NODE_DOCUMENT, m_anim.size(), sizeof(std::map< std::string, std::shared_ptr<Anim> >::value_type));
+        for (const auto& anim : m_anim)
+        {
+            usage.AddString(MemoryUsage::NODE_DOCUMENT, anim.first);
+            anim.second->AddMemoryUsage(usage, visited);
+        }
+
+        usage.AddVectorBuffer(MemoryUsage::NODE_DOCUMENT, m_animById.capacity(), sizeof(std::shared_ptr<Anim>));
+        usage.AddVectorBuffer(MemoryUsage::NODE_DOCUMENT, m_animIndex.GetMemoryBytes(), 1);
+
+        m_memoryUsage = usage;
+    }
+
+    MemoryUsage Animations::GetMemoryUsage() const
+    {
+        return m_memoryUsage;
+    }
+
+    size_t Animations::DeduplicateCells(bool ignoreIndex)
+    {
+        size_t before = m_memoryUsage.GetTotal();
+
+        /// (name, x, y, z) => the shared CellSpr
+        typedef std::tuple<std::string, int, int, int> CellSprKey;
+        std::map< CellSprKey, std::shared_ptr<CellSpr> > cellSprs;
+
+        /// (index, delay, the shared CellSpr list) => the shared Cell
+        typedef std::tuple<unsigned int, unsigned int, std::vector<const CellSpr*> > CellKey;
+        std::map< CellKey, std::shared_ptr<Cell> > cells;
+
+        /// The Cell and CellSpr objects are never changed, they can be used
+        /// by the Anim instances from GetAnim. A cell that must use the shared
+        /// CellSpr is copied, and each anim gets a new list of cells.
+        for (const auto& anim : m_anim)
+        {
+            std::vector< std::shared_ptr<Cell> > newCells;
+            newCells.reserve(anim.second->m_cell.size());
+
+            for (const auto& cell : anim.second->m_cell)
+            {
+                std::vector< std::shared_ptr<CellSpr> > newCellsSpr;
+                newCellsSpr.reserve(cell->m_cellsSpr.size());
+
+                std::vector<const CellSpr*> cellSprList;
+                cellSprList.reserve(cell->m_cellsSpr.size());
+
+                bool changed = false;
+                for (const auto& cellSpr : cell->m_cellsSpr)
                 {
-                    m_anim[anim->GetName()] = anim;
+                    CellSprKey key(cellSpr->GetName(), cellSpr->GetX(), cellSpr->GetY(), cellSpr->GetZ());
+
+                    auto it = cellSprs.find(key);
+                    if (it == cellSprs.end())
+                        it = cellSprs.insert(std::make_pair(key, cellSpr)).first;
+
+                    changed = changed || (it->second != cellSpr);
+                    newCellsSpr.push_back(it->second);
+                    cellSprList.push_back(it->second.get());
                 }
-                else
+
+                CellKey key(ignoreIndex ? 0 : cell->GetIndex(), cell->GetDelay(), cellSprList);
+
+                auto it = cells.find(key);
+                if (it == cells.end())
                 {
-                    m_errorText = "Parsing <anim> Failed! >> " + anim->GetErrorText();
-                    return result;
+                    std::shared_ptr<Cell> shared = cell;
+                    if (changed)
+                    {
+                        shared = std::make_shared<Cell>(*cell);
+                        shared->m_cellsSpr.swap(newCellsSpr);
+                    }
+                    it = cells.insert(std::make_pair(key, shared)).first;
                 }
+
+                newCells.push_back(it->second);
             }
 
-            node = node->NextSiblingElement();
+            /// The delays are the same, m_cellDelay is still valid.
+            anim.second->m_cell.swap(newCells);
         }
 
-        return ParseResult::OK;
+        ComputeMemoryUsage();
+
+        size_t after = m_memoryUsage.GetTotal();
+        return (before > after) ? before - after : 0;
     }
 
 	std::map< std::string, std::shared_ptr<Anim> >& Animations::GetAnims()
@@ -235,6 +468,11 @@ namespace dfp
 		return m_anim;
 	}
 
+	const std::map< std::string, std::shared_ptr<Anim> >& Animations::GetAnims() const
+	{
+		return m_anim;
+	}
+
 
 
 
@@ -244,6 +482,9 @@ namespace dfp
 					, m_loops(0)
 					, m_currentCellIndex(0)
 					, m_timestampLastChange(0)
+					, m_playback(PLAYBACK_STATIC)
+					, m_recordSession(0)
+					, m_recordId(0)
     {}
 
     Anim::Anim(const Anim &obj)
@@ -257,6 +498,10 @@ namespace dfp
 
 		m_timestampLastChange = obj.m_timestampLastChange;
 		m_currentCellIndex = obj.m_currentCellIndex;
+		m_playback = obj.m_playback;
+		m_cellDelay = obj.m_cellDelay;
+		m_recordSession = 0;
+		m_recordId = 0;
     }
 
     Anim::Anim(const std::shared_ptr<Anim> obj) 
@@ -270,11 +515,15 @@ namespace dfp
 
 		m_timestampLastChange = obj->m_timestampLastChange;
 		m_currentCellIndex = obj->m_currentCellIndex;
+		m_playback = obj->m_playback;
+		m_cellDelay = obj->m_cellDelay;
+		m_recordSession = 0;
+		m_recordId = 0;
     }
 
 	Anim::~Anim()
 	{
-
+		DFP_RECORD(OnRelease(*this));
 	}
 
 	Anim& Anim::operator=(const Anim& other)
@@ -289,32 +538,45 @@ namespace dfp
 
 		m_timestampLastChange = other.m_timestampLastChange;
 		m_currentCellIndex = other.m_currentCellIndex;
+		m_playback = other.m_playback;
+		m_cellDelay = other.m_cellDelay;
+
+		/// The recording can not follow the new state.
+		DFP_RECORD(OnRelease(*this));
+		m_recordSession = 0;
+		m_recordId = 0;
 
 		return *this;
 	}
 
-    std::string Anim::GetName()
+    std::string Anim::GetName() const
 	{ 
 		return m_name; 
 	}
 
-    std::string Anim::GetErrorText()
+    int Anim::GetLoops() const
+	{
+		return m_loops;
+	}
+
+    std::string Anim::GetErrorText() const
 	{ 
 		return m_errorText; 
 	}
 
-    ParseResult Anim::ParseXML(const tinyxml2::XMLNode *dataNode)
+    ParseResult Anim::ParseXML(const XmlNode &dataNode)
     {
-        const tinyxml2::XMLElement* nodeElm = dataNode->ToElement();
+        DFP_TRACE_SCOPE("Anim::ParseXML");
 
-        m_name = nodeElm->Attribute("name");
+        const char *name = dataNode.Attribute("name");
+        m_name = name ? name : "";
         if (m_name.empty())
         {
             m_errorText = "Cannot find attribute 'name' or the value is empty!";
             return ParseResult::ERROR_NAME_WRONG;
         }
 
-		const char* tempValue = nodeElm->Attribute("loops");
+		const char* tempValue = dataNode.Attribute("loops");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'loops' or the value is not numeric!";
@@ -322,10 +584,10 @@ namespace dfp
         }
 		m_loops = std::stoi(tempValue);
 
-		const tinyxml2::XMLNode *node = dataNode->FirstChild();
+		XmlNode node = dataNode.FirstChild();
         while (node)
         {
-            if (strcmp(node->Value(), "cell") == 0)
+            if (strcmp(node.Value(), "cell") == 0)
             {
                 std::shared_ptr<Cell> cell = std::make_shared<Cell>();
 
@@ -339,13 +601,57 @@ namespace dfp
                 }
             }
            
-            node = node->NextSibling();
+            node = node.NextSibling();
         }
 
+        ClassifyPlayback();
+
         return ParseResult::OK;
     }
 
+    Anim::Playback Anim::GetPlayback() const
+    {
+        return m_playback;
+    }
+
+    void Anim::ClassifyPlayback()
+    {
+        m_cellDelay.clear();
+        m_cellDelay.reserve(m_cell.size());
+        /// Keep the delay unsigned: a negative delay in the file wraps to a
+        /// big one, the same as for TickTimeline and GpuExport.
+        for (const auto& cell : m_cell)
+            m_cellDelay.push_back((uint32_t)cell->GetDelay());
+
+        if (m_cellDelay.size() <= 1)
+            m_playback = PLAYBACK_STATIC;
+        else if (std::count(m_cellDelay.begin(), m_cellDelay.end(), m_cellDelay[0]) == (std::ptrdiff_t)m_cellDelay.size())
+            m_playback = PLAYBACK_UNIFORM;
+        else
+            m_playback = PLAYBACK_VARIABLE;
+
+        if (m_currentCellIndex >= m_cell.size())
+            m_currentCellIndex = 0;
+    }
+
 	void Anim::Update(float dtSeconds, float animSpeedFactor)
+    {
+        DFP_METRICS_ADD(Metrics::COUNTER_ANIM_UPDATES, 1);
+        DFP_RECORD(OnUpdate(*this, dtSeconds, animSpeedFactor));
+
+        /// The cells were added or removed through GetCells.
+        if (m_cellDelay.size() != m_cell.size())
+            ClassifyPlayback();
+
+        /// The cell of a static anim never changes.
+        if (m_playback == PLAYBACK_UNIFORM)
+            UpdateCells<PLAYBACK_UNIFORM>(dtSeconds, animSpeedFactor);
+        else if (m_playback == PLAYBACK_VARIABLE)
+            UpdateCells<PLAYBACK_VARIABLE>(dtSeconds, animSpeedFactor);
+    }
+
+    template <Anim::Playback PLAYBACK>
+    void Anim::UpdateCells(float dtSeconds, float animSpeedFactor)
     {
 		m_timestampLastChange += dtSeconds;
 
@@ -355,41 +661,100 @@ namespace dfp
 		if (animSpeedFactor <= 0)
 			animSpeedFactor = 1.0f;
 
-        size_t maxCells = m_cell.size();
+        const uint32_t maxCells = (uint32_t)m_cellDelay.size();
+        uint64_t cellsAdvanced = 0;
 
-		/// GetDelay will return the delay in milliseconds. 
+		/// m_cellDelay is in milliseconds. 
 		/// delay is in seconds.
-		float delay = (float)m_cell[m_currentCellIndex]->GetDelay() / animSpeedFactor / 1000;
+		float delay = (float)m_cellDelay[m_currentCellIndex] / animSpeedFactor / 1000;
 		if (delay <= 0)
 			delay = 0.001f;
 
+        if (PLAYBACK == PLAYBACK_UNIFORM && m_timestampLastChange > delay)
+        {
+            /// The loop below would remove the delay "steps" times, until
+            /// the time is in (0, delay].
+            float steps = std::ceil(m_timestampLastChange / delay) - 1;
+            if (steps < 4294967296.0f)
+            {
+                m_timestampLastChange -= steps * delay;
+                cellsAdvanced = (uint64_t)steps;
+            }
+            else
+            {
+                /// A huge (or infinite) dt for the delay: the cast of steps
+                /// would overflow, only its position in the loop is used.
+                bool finite = std::isfinite(steps);
+                m_timestampLastChange = finite ? (float)std::fmod((double)m_timestampLastChange, (double)delay) : 0.0f;
+                cellsAdvanced = finite ? (uint64_t)std::fmod((double)steps, (double)maxCells) : 0;
+            }
+            m_currentCellIndex = (uint32_t)((m_currentCellIndex + cellsAdvanced % maxCells) % maxCells);
+        }
+
+        uint32_t iterations = 0;
+
+        /// For PLAYBACK_UNIFORM, this only fixes the rounding of the division.
 		while (m_timestampLastChange > delay)
         {
 			m_timestampLastChange -= delay;
+            iterations++;
 
             m_currentCellIndex++;
             if (m_currentCellIndex == maxCells)
                 m_currentCellIndex = 0;
 
-			delay = (float)m_cell[m_currentCellIndex]->GetDelay() / animSpeedFactor / 1000;
-			if (delay <= 0)
-				delay = 0.001f;
+            if (PLAYBACK == PLAYBACK_VARIABLE)
+            {
+                delay = (float)m_cellDelay[m_currentCellIndex] / animSpeedFactor / 1000;
+                if (delay <= 0)
+                    delay = 0.001f;
+            }
         }
+
+        DFP_METRICS_ADD(Metrics::COUNTER_CELLS_ADVANCED, cellsAdvanced + iterations);
+        DFP_METRICS_RECORD(Metrics::HISTOGRAM_UPDATE_ITERATIONS, iterations);
     }
 
-    std::shared_ptr<Cell> Anim::GetCurrentCell()
+    std::shared_ptr<Cell> Anim::GetCurrentCell() const
     {
-        if (m_cell.empty())
+        /// The cells can be removed through GetCells, until the next Update.
+        if (m_currentCellIndex >= m_cell.size())
             return nullptr;
 
+        DFP_RECORD(OnCell(*this, m_currentCellIndex));
         return m_cell[m_currentCellIndex];
     }
 
+    uint32_t Anim::GetCurrentCellIndex() const
+    {
+        return m_currentCellIndex;
+    }
+
 	std::vector< std::shared_ptr<Cell> >& Anim::GetCells()
 	{
 		return m_cell;
 	}
 
+	const std::vector< std::shared_ptr<Cell> >& Anim::GetCells() const
+	{
+		return m_cell;
+	}
+
+    void Anim::AddMemoryUsage(MemoryUsage& usage, std::set<const void*>& visited) const
+    {
+        usage.AddSharedObject(MemoryUsage::NODE_ANIM, sizeof(Anim));
+        usage.AddString(MemoryUsage::NODE_ANIM, m_errorText);
+        usage.AddString(MemoryUsage::NODE_ANIM, m_name);
+        usage.AddVectorBuffer(MemoryUsage::NODE_ANIM, m_cell.capacity(), sizeof(std::shared_ptr<Cell>));
+        usage.AddVectorBuffer(MemoryUsage::NODE_ANIM, m_cellDelay.capacity(), sizeof(uint32_t));
+
+        for (const auto& cell : m_cell)
+        {
+            if (visited.insert(cell.get()).second)
+                cell->AddMemoryUsage(usage, visited);
+        }
+    }
+
 	
 
 
@@ -406,17 +771,17 @@ namespace dfp
 
 	}
 
-    unsigned int Cell::GetIndex(){ return m_index; }
+    unsigned int Cell::GetIndex() const { return m_index; }
 
-    unsigned int Cell::GetDelay(){ return m_delay; }
+    unsigned int Cell::GetDelay() const { return m_delay; }
 
-    std::string Cell::GetErrorText(){ return m_errorText; }
+    std::string Cell::GetErrorText() const { return m_errorText; }
 
-    ParseResult Cell::ParseXML(const tinyxml2::XMLNode *dataNode)
+    ParseResult Cell::ParseXML(const XmlNode &dataNode)
     {
-        const tinyxml2::XMLElement* nodeElm = dataNode->ToElement();
+        DFP_TRACE_SCOPE("Cell::ParseXML");
 
-		const char* tempValue = nodeElm->Attribute("index");
+		const char* tempValue = dataNode.Attribute("index");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'index' or the value is not numeric!";
@@ -425,7 +790,7 @@ namespace dfp
 		m_index = std::stoi(tempValue);
 
 
-		tempValue = nodeElm->Attribute("delay");
+		tempValue = dataNode.Attribute("delay");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'delay' or the value is not numeric!";
@@ -433,10 +798,10 @@ namespace dfp
         }
 		m_delay = std::stoi(tempValue);
 
-        const tinyxml2::XMLNode *node = dataNode->FirstChild();
+        XmlNode node = dataNode.FirstChild();
         while (node)
         {
-            if (strcmp(node->Value(), "spr") == 0)
+            if (strcmp(node.Value(), "spr") == 0)
             {
                 std::shared_ptr<CellSpr> cellspr = std::make_shared<CellSpr>();
 
@@ -450,18 +815,31 @@ namespace dfp
                 }
             }
 
-            node = node->NextSibling();
+            node = node.NextSibling();
         }
 
         return ParseResult::OK;
     }
 
 
-    const std::vector< std::shared_ptr<CellSpr> >& Cell::GetCellsSpr()
+    const std::vector< std::shared_ptr<CellSpr> >& Cell::GetCellsSpr() const
     {
         return m_cellsSpr;
     }
 
+    void Cell::AddMemoryUsage(MemoryUsage& usage, std::set<const void*>& visited) const
+    {
+        usage.AddSharedObject(MemoryUsage::NODE_CELL, sizeof(Cell));
+        usage.AddString(MemoryUsage::NODE_CELL, m_errorText);
+        usage.AddVectorBuffer(MemoryUsage::NODE_CELL, m_cellsSpr.capacity(), sizeof(std::shared_ptr<CellSpr>));
+
+        for (const auto& cellSpr : m_cellsSpr)
+        {
+            if (visited.insert(cellSpr.get()).second)
+                cellSpr->AddMemoryUsage(usage);
+        }
+    }
+
 
 
 
@@ -474,21 +852,29 @@ namespace dfp
 	}
 
 
-    std::string CellSpr::GetName(){ return m_name; }
+    std::string CellSpr::GetName() const { return m_name; }
+
+    int CellSpr::GetX() const { return m_x; }
 
-    int CellSpr::GetX(){ return m_x; }
+    int CellSpr::GetY() const { return m_y; }
 
-    int CellSpr::GetY(){ return m_y; }
+    int CellSpr::GetZ() const { return m_z; }
 
-    int CellSpr::GetZ(){ return m_z; }
+    std::string CellSpr::GetErrorText() const { return m_errorText; }
 
-    std::string CellSpr::GetErrorText(){ return m_errorText; }
+    void CellSpr::AddMemoryUsage(MemoryUsage& usage) const
+    {
+        usage.AddSharedObject(MemoryUsage::NODE_CELLSPR, sizeof(CellSpr));
+        usage.AddString(MemoryUsage::NODE_CELLSPR, m_errorText);
+        usage.AddString(MemoryUsage::NODE_CELLSPR, m_name);
+    }
 
-    ParseResult CellSpr::ParseXML(const tinyxml2::XMLNode *dataNode)
+    ParseResult CellSpr::ParseXML(const XmlNode &dataNode)
     {
-        const tinyxml2::XMLElement* nodeElm = dataNode->ToElement();
+        DFP_TRACE_SCOPE("CellSpr::ParseXML");
 
-        m_name = nodeElm->Attribute("name");
+        const char *name = dataNode.Attribute("name");
+        m_name = name ? name : "";
         if (m_name.empty())
         {
             m_errorText = "Cannot find attribute 'name' or the value is empty!";
@@ -496,7 +882,7 @@ namespace dfp
         }
 
 
-		const char* tempValue = nodeElm->Attribute("x");
+		const char* tempValue = dataNode.Attribute("x");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'x' or the value is not numeric!";
@@ -504,7 +890,7 @@ namespace dfp
         }
 		m_x = std::stoi(tempValue);
 
-		tempValue = nodeElm->Attribute("y");
+		tempValue = dataNode.Attribute("y");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'y' or the value is not numeric!";
@@ -512,7 +898,7 @@ namespace dfp
         }
 		m_y = std::stoi(tempValue);
 
-		tempValue = nodeElm->Attribute("z");
+		tempValue = dataNode.Attribute("z");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'z' or the value is not numeric!";
@@ -0,0 +1,253 @@
+#include "DarkFunctionParser/AssetManager.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Bundle.h"
+
+namespace dfp
+{
+    /// The prefixes of the keys, a file can be loaded with both types.
+    static const char *SPRITE_KEY_PREFIX = "sprites:";
+    static const char *ANIMATIONS_KEY_PREFIX = "anim:";
+
+    AssetManager::AssetManager(size_t budgetBytes)
+        : m_bundle(nullptr)
+        , m_budgetBytes(budgetBytes)
+        , m_usedBytes(0)
+        , m_hits(0)
+        , m_misses(0)
+        , m_evictions(0)
+        , m_failures(0)
+        , m_errorText("")
+    {}
+
+    AssetManager::~AssetManager()
+    {}
+
+    void AssetManager::SetBudget(size_t budgetBytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_budgetBytes = budgetBytes;
+        Evict(m_budgetBytes);
+    }
+
+    size_t AssetManager::GetBudget() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return m_budgetBytes;
+    }
+
+    void AssetManager::SetBundle(const Bundle *bundle)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_bundle = bundle;
+    }
+
+    ParseResult AssetManager::GetSprite(const std::string &fileName, std::shared_ptr<const Sprite> &sprite)
+    {
+        std::string key = SPRITE_KEY_PREFIX + fileName;
+        const Bundle *bundle;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            Entry *entry = Find(key);
+            if (entry)
+            {
+                m_hits++;
+                sprite = entry->sprite;
+                return ParseResult::OK;
+            }
+
+            m_misses++;
+            bundle = m_bundle;
+        }
+
+        /// Parse without the lock, the other threads can use the cache.
+        std::shared_ptr<Sprite> document = std::make_shared<Sprite>();
+        ParseResult result;
+        if (bundle && bundle->Contains(fileName))
+            result = bundle->ParseSprite(fileName, *document);
+        else
+            result = document->ParseFile(fileName);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (result != ParseResult::OK)
+        {
+            m_failures++;
+            m_errorText = "Cannot load " + fileName + " >> " + document->GetErrorText();
+            sprite = nullptr;
+            return result;
+        }
+
+        Entry entry;
+        entry.key = key;
+        entry.sprite = document;
+        entry.bytes = document->GetMemoryUsage().GetTotal();
+
+        /// Take the reference before Evict, so the new document is pinned.
+        sprite = Insert(entry).sprite;
+        Evict(m_budgetBytes);
+
+        return ParseResult::OK;
+    }
+
+    ParseResult AssetManager::GetAnimations(const std::string &fileName, std::shared_ptr<const Animations> &animations)
+    {
+        std::string key = ANIMATIONS_KEY_PREFIX + fileName;
+        const Bundle *bundle;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            Entry *entry = Find(key);
+            if (entry)
+            {
+                m_hits++;
+                animations = entry->animations;
+                return ParseResult::OK;
+            }
+
+            m_misses++;
+            bundle = m_bundle;
+        }
+
+        /// Parse without the lock, the other threads can use the cache.
+        std::shared_ptr<Animations> document = std::make_shared<Animations>();
+        ParseResult result;
+        if (bundle && bundle->Contains(fileName))
+            result = bundle->ParseAnimations(fileName, *document);
+        else
+            result = document->ParseFile(fileName);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (result != ParseResult::OK)
+        {
+            m_failures++;
+            m_errorText = "Cannot load " + fileName + " >> " + document->GetErrorText();
+            animations = nullptr;
+            return result;
+        }
+
+        Entry entry;
+        entry.key = key;
+        entry.animations = document;
+        entry.bytes = document->GetMemoryUsage().GetTotal();
+
+        /// Take the reference before Evict, so the new document is pinned.
+        animations = Insert(entry).animations;
+        Evict(m_budgetBytes);
+
+        return ParseResult::OK;
+    }
+
+    void AssetManager::Trim()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Evict(m_budgetBytes);
+    }
+
+    void AssetManager::Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Evict(0);
+    }
+
+    AssetManager::Stats AssetManager::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Stats stats;
+        stats.hits = m_hits;
+        stats.misses = m_misses;
+        stats.evictions = m_evictions;
+        stats.failures = m_failures;
+        stats.documentCount = m_entries.size();
+        stats.pinnedCount = 0;
+        stats.usedBytes = m_usedBytes;
+        stats.budgetBytes = m_budgetBytes;
+
+        for (EntryList::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+        {
+            if (IsPinned(*it))
+                stats.pinnedCount++;
+        }
+
+        return stats;
+    }
+
+    void AssetManager::ResetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_hits = 0;
+        m_misses = 0;
+        m_evictions = 0;
+        m_failures = 0;
+    }
+
+    std::string AssetManager::GetErrorText() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        return m_errorText;
+    }
+
+    AssetManager::Entry* AssetManager::Find(const std::string &key)
+    {
+        std::map<std::string, EntryList::iterator>::iterator it = m_index.find(key);
+        if (it == m_index.end())
+            return nullptr;
+
+        /// Most recently used => the front of the list.
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+        return &*it->second;
+    }
+
+    AssetManager::Entry& AssetManager::Insert(Entry &entry)
+    {
+        /// Another thread parsed the same file first, keep its copy.
+        Entry *existing = Find(entry.key);
+        if (existing)
+            return *existing;
+
+        m_entries.push_front(entry);
+        m_index[entry.key] = m_entries.begin();
+        m_usedBytes += entry.bytes;
+
+        return m_entries.front();
+    }
+
+    void AssetManager::Evict(size_t budgetBytes)
+    {
+        EntryList::iterator it = m_entries.end();
+        while (m_usedBytes > budgetBytes && it != m_entries.begin())
+        {
+            --it;
+            if (IsPinned(*it))
+                continue;
+
+            m_usedBytes -= it->bytes;
+            m_index.erase(it->key);
+            it = m_entries.erase(it);
+            m_evictions++;
+        }
+    }
+
+    bool AssetManager::IsPinned(const Entry &entry)
+    {
+        /// The manager has one reference, the others belong to the callers.
+        if (entry.sprite)
+            return entry.sprite.use_count() > 1;
+
+        return entry.animations.use_count() > 1;
+    }
+
+} //namespace dfp
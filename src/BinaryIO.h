@@ -0,0 +1,153 @@
+#ifndef DFP_BINARYIO_H
+#define DFP_BINARYIO_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace dfp
+{
+    /// The compact binary files of the library (Recorder, ParseCache).
+    /// The numbers are written as LEB128, 7 bits per byte, so the small
+    /// numbers take one byte.
+    inline void WriteVarint(std::vector<uint8_t> &data, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            data.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        data.push_back((uint8_t)value);
+    }
+
+    /// The signed numbers are zigzag encoded, so the small negative
+    /// numbers are small too.
+    inline void WriteSigned(std::vector<uint8_t> &data, int64_t value)
+    {
+        WriteVarint(data, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+    }
+
+    /// The floats are written as their 4 bytes, little endian.
+    inline void WriteFloat(std::vector<uint8_t> &data, float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 4; i++)
+            data.push_back((uint8_t)(bits >> (i * 8)));
+    }
+
+    inline void WriteString(std::vector<uint8_t> &data, const std::string &text)
+    {
+        WriteVarint(data, text.size());
+        data.insert(data.end(), text.begin(), text.end());
+    }
+
+    /// Read the data written by the functions above. A read after the end
+    /// or a bad number sets the error and returns 0, so the caller can
+    /// check Error() once after many reads.
+    class BinaryReader
+    {
+    public:
+
+        BinaryReader(const uint8_t *data, size_t size)
+            : m_data(data)
+            , m_size(size)
+            , m_position(0)
+            , m_error(false)
+        {}
+
+        bool IsEnd() const
+        {
+            return m_position >= m_size;
+        }
+
+        bool Error() const
+        {
+            return m_error;
+        }
+
+        size_t GetPosition() const
+        {
+            return m_position;
+        }
+
+        uint8_t ReadByte()
+        {
+            if (m_position >= m_size)
+            {
+                m_error = true;
+                return 0;
+            }
+            return m_data[m_position++];
+        }
+
+        uint64_t ReadVarint()
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                uint8_t byte = ReadByte();
+                value |= (uint64_t)(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                    return value;
+            }
+            m_error = true;
+            return 0;
+        }
+
+        int64_t ReadSigned()
+        {
+            uint64_t value = ReadVarint();
+            return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        }
+
+        float ReadFloat()
+        {
+            uint32_t bits = 0;
+            for (int i = 0; i < 4; i++)
+                bits |= (uint32_t)ReadByte() << (i * 8);
+
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        std::string ReadString()
+        {
+            uint64_t size = ReadVarint();
+            if (m_error || size > m_size - m_position)
+            {
+                m_error = true;
+                return std::string();
+            }
+
+            std::string text((const char *)m_data + m_position, (size_t)size);
+            m_position += (size_t)size;
+            return text;
+        }
+
+        /// Read a count of items, each one at least one byte long, so a
+        /// broken count can not allocate more than the data.
+        uint64_t ReadCount()
+        {
+            uint64_t count = ReadVarint();
+            if (count > m_size - m_position)
+            {
+                m_error = true;
+                return 0;
+            }
+            return count;
+        }
+
+    private:
+
+        const uint8_t *m_data;
+        size_t m_size;
+        size_t m_position;
+        bool m_error;
+    };
+
+} //namespace dfp
+
+#endif //DFP_BINARYIO_H
@@ -0,0 +1,467 @@
+#include "DarkFunctionParser/BulkLoader.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Trace.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(DFP_USE_IO_URING) && defined(__linux__)
+#include <liburing.h>
+#endif
+
+namespace dfp
+{
+    BulkLoader::BulkLoader()
+        : m_queueDepth(64)
+        , m_threadCount(4)
+        , m_usingIoUring(false)
+    {}
+
+    void BulkLoader::SetQueueDepth(uint32_t queueDepth)
+    {
+        m_queueDepth = queueDepth ? queueDepth : 1;
+    }
+
+    void BulkLoader::SetThreadCount(uint32_t threadCount)
+    {
+        m_threadCount = threadCount ? threadCount : 1;
+    }
+
+    void BulkLoader::Add(const std::string &fileName, Sprite &sprite)
+    {
+        Item item;
+        item.fileName = fileName;
+        item.sprite = &sprite;
+        item.animations = nullptr;
+        item.result = ParseResult::OK;
+        m_items.push_back(item);
+    }
+
+    void BulkLoader::Add(const std::string &fileName, Animations &animations)
+    {
+        Item item;
+        item.fileName = fileName;
+        item.sprite = nullptr;
+        item.animations = &animations;
+        item.result = ParseResult::OK;
+        m_items.push_back(item);
+    }
+
+    void BulkLoader::Clear()
+    {
+        m_items.clear();
+    }
+
+    size_t BulkLoader::GetCount() const
+    {
+        return m_items.size();
+    }
+
+    ParseResult BulkLoader::GetResult(size_t index) const
+    {
+        return index < m_items.size() ? m_items[index].result : ParseResult::ERROR_NOT_FOUND;
+    }
+
+    std::string BulkLoader::GetErrorText(size_t index) const
+    {
+        return index < m_items.size() ? m_items[index].errorText : std::string();
+    }
+
+    bool BulkLoader::IsUsingIoUring() const
+    {
+        return m_usingIoUring;
+    }
+
+    ParseResult BulkLoader::Load()
+    {
+        DFP_TRACE_SCOPE("BulkLoader::Load");
+
+        for (size_t i = 0; i < m_items.size(); i++)
+        {
+            m_items[i].result = ParseResult::OK;
+            m_items[i].errorText.clear();
+        }
+
+        m_usingIoUring = LoadIoUring();
+        if (!m_usingIoUring)
+            LoadThreads();
+
+        for (size_t i = 0; i < m_items.size(); i++)
+        {
+            if (m_items[i].result != ParseResult::OK)
+                return m_items[i].result;
+        }
+        return ParseResult::OK;
+    }
+
+    void BulkLoader::Complete(Item &item, const char *data, size_t size)
+    {
+        DFP_TRACE_SCOPE_FILE("BulkLoader::Complete", item.fileName);
+
+        if (item.sprite)
+        {
+            item.result = item.sprite->ParseBuffer(data, size, item.fileName);
+            if (item.result != ParseResult::OK)
+                item.errorText = item.sprite->GetErrorText();
+        }
+        else
+        {
+            item.result = item.animations->ParseBuffer(data, size, item.fileName);
+            if (item.result != ParseResult::OK)
+                item.errorText = item.animations->GetErrorText();
+        }
+    }
+
+    void BulkLoader::Fail(Item &item, ParseResult result, const std::string &errorText)
+    {
+        item.result = result;
+        item.errorText = errorText;
+    }
+
+#if !defined(_WIN32)
+    /// Open a file and get its size.
+    static ParseResult OpenFile(const std::string &fileName, int &fd, size_t &size)
+    {
+        fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return ParseResult::ERROR_COULDNT_OPEN;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            close(fd);
+            fd = -1;
+            return ParseResult::ERROR_INVALID_FILE_SIZE;
+        }
+
+        size = (size_t)info.st_size;
+        return ParseResult::OK;
+    }
+#endif
+
+    /// Read a whole file, used by the reader threads. There is a '\0'
+    /// after the data, as ParseFile does.
+    static ParseResult ReadFile(const std::string &fileName, std::vector<char> &data)
+    {
+        DFP_TRACE_SCOPE_FILE("ReadFile", fileName);
+
+#if !defined(_WIN32)
+        int fd;
+        size_t size;
+        ParseResult result = OpenFile(fileName, fd, size);
+        if (result != ParseResult::OK)
+            return result;
+
+        data.resize(size + 1);
+        data[size] = '\0';
+        size_t done = 0;
+        while (done < size)
+        {
+            ssize_t count = pread(fd, data.data() + done, size - done, (off_t)done);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                break;
+            done += (size_t)count;
+        }
+        close(fd);
+
+        return done == size ? ParseResult::OK : ParseResult::ERROR_INVALID_FILE_SIZE;
+#else
+        FILE *file = fopen(fileName.c_str(), "rb");
+        if (!file)
+            return ParseResult::ERROR_COULDNT_OPEN;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        bool ok = size > 0;
+        if (ok)
+        {
+            data.resize((size_t)size + 1);
+            data[size] = '\0';
+            ok = fread(data.data(), 1, (size_t)size, file) == (size_t)size;
+        }
+        fclose(file);
+
+        return ok ? ParseResult::OK : ParseResult::ERROR_INVALID_FILE_SIZE;
+#endif
+    }
+
+    static const char *GetReadErrorText(ParseResult result)
+    {
+        return result == ParseResult::ERROR_COULDNT_OPEN ? "Cannot open the file!" : "Cannot read the file!";
+    }
+
+#if defined(DFP_USE_IO_URING) && defined(__linux__)
+    /// Get a free sqe. If the submission queue is full, the queued reads
+    /// are submitted first. nullptr if it is still full.
+    static struct io_uring_sqe *GetSqe(struct io_uring &ring)
+    {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        if (!sqe && io_uring_submit(&ring) >= 0)
+            sqe = io_uring_get_sqe(&ring);
+        return sqe;
+    }
+
+    bool BulkLoader::LoadIoUring()
+    {
+        struct io_uring ring;
+        if (io_uring_queue_init(m_queueDepth, &ring, 0) < 0)
+            return false;
+
+        /// IORING_OP_READ needs Linux 5.6, before it the ring works but
+        /// every read fails with -EINVAL. The probe is 5.6 too, so a kernel
+        /// without it uses the threads.
+        struct io_uring_probe *probe = io_uring_get_probe_ring(&ring);
+        bool canRead = probe && io_uring_opcode_supported(probe, IORING_OP_READ);
+        if (probe)
+            io_uring_free_probe(probe);
+        if (!canRead)
+        {
+            io_uring_queue_exit(&ring);
+            return false;
+        }
+
+        /// One slot for each read in flight, the buffers are reused.
+        /// The fd of a free slot is -1.
+        struct Slot
+        {
+            size_t item;
+            int fd;
+            std::vector<char> data;
+            size_t size;
+            size_t done;
+        };
+        std::vector<Slot> slots(m_queueDepth);
+        std::vector<uint32_t> freeSlots;
+        for (uint32_t i = m_queueDepth; i > 0; i--)
+        {
+            slots[i - 1].fd = -1;
+            freeSlots.push_back(i - 1);
+        }
+
+        size_t next = 0;
+        uint32_t inFlight = 0;
+        for (;;)
+        {
+            /// Start the reads of the next files.
+            while (!freeSlots.empty() && next < m_items.size())
+            {
+                Item &item = m_items[next];
+                Slot &slot = slots[freeSlots.back()];
+
+                size_t size;
+                ParseResult result = OpenFile(item.fileName, slot.fd, size);
+                if (result != ParseResult::OK)
+                {
+                    Fail(item, result, GetReadErrorText(result));
+                    next++;
+                    continue;
+                }
+
+                struct io_uring_sqe *sqe = GetSqe(ring);
+                if (!sqe)
+                {
+                    /// The queue is full: the file is opened again after the
+                    /// next completion. With no read in flight, it never ends.
+                    close(slot.fd);
+                    slot.fd = -1;
+                    if (inFlight == 0)
+                    {
+                        for (; next < m_items.size(); next++)
+                            Fail(m_items[next], ParseResult::ERROR_INVALID_FILE_SIZE, "Cannot read the file!");
+                    }
+                    break;
+                }
+
+                /// A '\0' at the end, as ParseFile does.
+                slot.item = next++;
+                slot.data.resize(size + 1);
+                slot.data[size] = '\0';
+                slot.size = size;
+                slot.done = 0;
+
+                io_uring_prep_read(sqe, slot.fd, slot.data.data(), (unsigned)size, 0);
+                io_uring_sqe_set_data(sqe, (void *)(uintptr_t)freeSlots.back());
+                freeSlots.pop_back();
+                inFlight++;
+            }
+
+            if (inFlight == 0)
+                break;
+
+            io_uring_submit(&ring);
+
+            struct io_uring_cqe *cqe;
+            int error = io_uring_wait_cqe(&ring, &cqe);
+            if (error == -EINTR)
+                continue;
+            if (error < 0)
+            {
+                /// The ring is broken, the reads in flight are lost.
+                for (uint32_t i = 0; i < m_queueDepth; i++)
+                {
+                    if (slots[i].fd < 0)
+                        continue;
+                    close(slots[i].fd);
+                    Fail(m_items[slots[i].item], ParseResult::ERROR_INVALID_FILE_SIZE, "Cannot read the file!");
+                }
+                for (; next < m_items.size(); next++)
+                    Fail(m_items[next], ParseResult::ERROR_INVALID_FILE_SIZE, "Cannot read the file!");
+                break;
+            }
+
+            uint32_t index = (uint32_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+            int count = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+
+            Slot &slot = slots[index];
+            Item &item = m_items[slot.item];
+            if (count == -EINTR || count == -EAGAIN)
+                count = 0;
+            else if (count <= 0)
+            {
+                /// An error, or the file is shorter than its size.
+                close(slot.fd);
+                slot.fd = -1;
+                Fail(item, ParseResult::ERROR_INVALID_FILE_SIZE, "Cannot read the file!");
+                freeSlots.push_back(index);
+                inFlight--;
+                continue;
+            }
+
+            slot.done += (size_t)count;
+            if (slot.done < slot.size)
+            {
+                /// A short read, ask for the rest.
+                struct io_uring_sqe *sqe = GetSqe(ring);
+                if (sqe)
+                {
+                    io_uring_prep_read(sqe, slot.fd, slot.data.data() + slot.done, (unsigned)(slot.size - slot.done), slot.done);
+                    io_uring_sqe_set_data(sqe, (void *)(uintptr_t)index);
+                    continue;
+                }
+
+                close(slot.fd);
+                slot.fd = -1;
+                Fail(item, ParseResult::ERROR_INVALID_FILE_SIZE, "Cannot read the file!");
+                freeSlots.push_back(index);
+                inFlight--;
+                continue;
+            }
+
+            /// The other reads go on while this file is parsed.
+            close(slot.fd);
+            slot.fd = -1;
+            Complete(item, slot.data.data(), slot.size);
+            freeSlots.push_back(index);
+            inFlight--;
+        }
+
+        io_uring_queue_exit(&ring);
+        return true;
+    }
+#else
+    bool BulkLoader::LoadIoUring()
+    {
+        return false;
+    }
+#endif
+
+    void BulkLoader::LoadThreads()
+    {
+        /// A file that is read, waiting to be parsed.
+        struct Done
+        {
+            size_t item;
+            ParseResult result;
+            std::vector<char> data;
+        };
+
+        std::atomic<size_t> next(0);
+        std::mutex mutex;
+        std::condition_variable readCondition;
+        std::condition_variable parseCondition;
+        std::deque<Done> done;
+        bool stop = false;
+
+        uint32_t threadCount = m_threadCount;
+        if (threadCount > m_items.size())
+            threadCount = (uint32_t)m_items.size();
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; t++)
+        {
+            threads.push_back(std::thread([&]()
+            {
+                for (;;)
+                {
+                    /// Do not read too far ahead of the parse.
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        while (!stop && done.size() >= m_queueDepth)
+                            readCondition.wait(lock);
+                        if (stop)
+                            return;
+                    }
+
+                    size_t index = next.fetch_add(1);
+                    if (index >= m_items.size())
+                        return;
+
+                    Done file;
+                    file.item = index;
+                    file.result = ReadFile(m_items[index].fileName, file.data);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.push_back(std::move(file));
+                    parseCondition.notify_one();
+                }
+            }));
+        }
+
+        /// Parse the files in the order they are read.
+        for (size_t count = 0; count < m_items.size(); count++)
+        {
+            Done file;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (done.empty())
+                    parseCondition.wait(lock);
+                file = std::move(done.front());
+                done.pop_front();
+            }
+            readCondition.notify_one();
+
+            Item &item = m_items[file.item];
+            if (file.result != ParseResult::OK)
+                Fail(item, file.result, GetReadErrorText(file.result));
+            else
+                Complete(item, file.data.data(), file.data.size() - 1);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        readCondition.notify_all();
+
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+    }
+
+} //namespace dfp
@@ -0,0 +1,530 @@
+#include "DarkFunctionParser/Bundle.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Hash.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <windows.h>
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+#define DFP_BUNDLE_WIN32_MAP
+#endif
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define DFP_BUNDLE_POSIX_MAP
+#endif
+
+#ifdef DFP_USE_LZ4
+#include <lz4.h>
+#endif
+
+namespace dfp
+{
+    static const char BUNDLE_MAGIC[4] = { 'D', 'F', 'P', 'B' };
+    static const uint32_t BUNDLE_VERSION = 1;
+    static const size_t BUNDLE_HEADER_SIZE = 32;
+    static const size_t BUNDLE_ENTRY_SIZE = 32;
+
+    static uint32_t ReadU32(const char *p)
+    {
+        const unsigned char *u = (const unsigned char *)p;
+        return (uint32_t)u[0] | ((uint32_t)u[1] << 8) | ((uint32_t)u[2] << 16) | ((uint32_t)u[3] << 24);
+    }
+
+    static uint64_t ReadU64(const char *p)
+    {
+        return (uint64_t)ReadU32(p) | ((uint64_t)ReadU32(p + 4) << 32);
+    }
+
+    static void WriteU32(std::vector<char> &out, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            out.push_back((char)((value >> (i * 8)) & 0xFF));
+    }
+
+    static void WriteU64(std::vector<char> &out, uint64_t value)
+    {
+        WriteU32(out, (uint32_t)value);
+        WriteU32(out, (uint32_t)(value >> 32));
+    }
+
+    static void PatchU32(std::vector<char> &out, size_t offset, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            out[offset + i] = (char)((value >> (i * 8)) & 0xFF);
+    }
+
+    static void PatchU64(std::vector<char> &out, size_t offset, uint64_t value)
+    {
+        PatchU32(out, offset, (uint32_t)value);
+        PatchU32(out, offset + 4, (uint32_t)(value >> 32));
+    }
+
+
+
+
+    Bundle::Bundle()
+        : m_errorText("")
+        , m_data(nullptr)
+        , m_size(0)
+        , m_fileHandle(nullptr)
+        , m_mapHandle(nullptr)
+        , m_ownsData(false)
+        , m_slots(nullptr)
+        , m_slotCount(0)
+    {}
+
+    Bundle::~Bundle()
+    {
+        Close();
+    }
+
+    ParseResult Bundle::Open(const std::string &fileName)
+    {
+        Close();
+
+#if defined(DFP_BUNDLE_WIN32_MAP)
+        HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            SetErrorText("Cannot open the file " + fileName);
+            return ParseResult::ERROR_COULDNT_OPEN;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+        {
+            CloseHandle(file);
+            SetErrorText("Invalid size for " + fileName);
+            return ParseResult::ERROR_INVALID_FILE_SIZE;
+        }
+
+        HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const void *view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (!view)
+        {
+            if (map)
+                CloseHandle(map);
+            CloseHandle(file);
+            SetErrorText("Cannot map the file " + fileName);
+            return ParseResult::ERROR_COULDNT_OPEN;
+        }
+
+        m_fileHandle = file;
+        m_mapHandle = map;
+        m_data = (const char *)view;
+        m_size = (size_t)fileSize.QuadPart;
+#elif defined(DFP_BUNDLE_POSIX_MAP)
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            SetErrorText("Cannot open the file " + fileName);
+            return ParseResult::ERROR_COULDNT_OPEN;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            close(fd);
+            SetErrorText("Invalid size for " + fileName);
+            return ParseResult::ERROR_INVALID_FILE_SIZE;
+        }
+
+        void *view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        /// The mapping keeps its own reference to the file.
+        close(fd);
+
+        if (view == MAP_FAILED)
+        {
+            SetErrorText("Cannot map the file " + fileName);
+            return ParseResult::ERROR_COULDNT_OPEN;
+        }
+
+        m_data = (const char *)view;
+        m_size = (size_t)info.st_size;
+#else
+        /// No memory mapping on this platform: read the whole file once.
+        FILE *file = fopen(fileName.c_str(), "rb");
+        if (!file)
+        {
+            SetErrorText("Cannot open the file " + fileName);
+            return ParseResult::ERROR_COULDNT_OPEN;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (fileSize <= 0)
+        {
+            fclose(file);
+            SetErrorText("Invalid size for " + fileName);
+            return ParseResult::ERROR_INVALID_FILE_SIZE;
+        }
+
+        char *buffer = new char[fileSize];
+        size_t readSize = fread(buffer, 1, fileSize, file);
+        fclose(file);
+        if (readSize != (size_t)fileSize)
+        {
+            delete[] buffer;
+            SetErrorText("Cannot read the file " + fileName);
+            return ParseResult::ERROR_COULDNT_OPEN;
+        }
+
+        m_data = buffer;
+        m_size = (size_t)fileSize;
+        m_ownsData = true;
+#endif
+
+        /// Check the header and decode the table of contents.
+        if (m_size < BUNDLE_HEADER_SIZE || memcmp(m_data, BUNDLE_MAGIC, 4) != 0 || ReadU32(m_data + 4) != BUNDLE_VERSION)
+        {
+            Close();
+            SetErrorText(fileName + " is not a bundle, or has a different version!");
+            return ParseResult::ERROR_PARSING_FAILED;
+        }
+
+        uint32_t entryCount = ReadU32(m_data + 8);
+        uint32_t slotCount = ReadU32(m_data + 12);
+        uint64_t entriesOffset = ReadU64(m_data + 16);
+        uint64_t slotsOffset = ReadU64(m_data + 24);
+
+        if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0 || slotCount < entryCount
+            || entriesOffset > m_size || (uint64_t)entryCount * BUNDLE_ENTRY_SIZE > m_size - entriesOffset
+            || slotsOffset > m_size || (uint64_t)slotCount * 4 > m_size - slotsOffset)
+        {
+            Close();
+            SetErrorText("The table of contents is corrupted in " + fileName);
+            return ParseResult::ERROR_PARSING_FAILED;
+        }
+
+        m_entry.resize(entryCount);
+        for (uint32_t i = 0; i < entryCount; i++)
+        {
+            const char *p = m_data + entriesOffset + (uint64_t)i * BUNDLE_ENTRY_SIZE;
+            Entry &entry = m_entry[i];
+            entry.pathHash = ReadU32(p);
+            entry.pathOffset = ReadU32(p + 4);
+            entry.pathSize = ReadU32(p + 8);
+            entry.flags = ReadU32(p + 12);
+            entry.dataOffset = ReadU64(p + 16);
+            entry.storedSize = ReadU32(p + 24);
+            entry.size = ReadU32(p + 28);
+
+            /// GetData returns "size" bytes of an uncompressed entry from the file.
+            /// The offsets are checked first, an offset near 2^64 would wrap.
+            if (entry.pathOffset > m_size || entry.pathSize > m_size - entry.pathOffset
+                || entry.dataOffset > m_size || entry.storedSize > m_size - entry.dataOffset
+                || ((entry.flags & BUNDLE_FLAG_LZ4) == 0 && entry.size != entry.storedSize))
+            {
+                Close();
+                SetErrorText("The table of contents is corrupted in " + fileName);
+                return ParseResult::ERROR_PARSING_FAILED;
+            }
+        }
+
+        m_slots = m_data + slotsOffset;
+        m_slotCount = slotCount;
+
+        return ParseResult::OK;
+    }
+
+    void Bundle::Close()
+    {
+        if (m_data)
+        {
+#if defined(DFP_BUNDLE_WIN32_MAP)
+            UnmapViewOfFile(m_data);
+            CloseHandle((HANDLE)m_mapHandle);
+            CloseHandle((HANDLE)m_fileHandle);
+#elif defined(DFP_BUNDLE_POSIX_MAP)
+            munmap((void *)m_data, m_size);
+#else
+            if (m_ownsData)
+                delete[] m_data;
+#endif
+        }
+
+        m_data = nullptr;
+        m_size = 0;
+        m_fileHandle = nullptr;
+        m_mapHandle = nullptr;
+        m_ownsData = false;
+        m_entry.clear();
+        m_slots = nullptr;
+        m_slotCount = 0;
+    }
+
+    std::string Bundle::GetErrorText() const
+    {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        return m_errorText;
+    }
+
+    void Bundle::SetErrorText(const std::string &errorText) const
+    {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        m_errorText = errorText;
+    }
+
+    uint32_t Bundle::GetEntryCount() const
+    {
+        return (uint32_t)m_entry.size();
+    }
+
+    std::string Bundle::GetEntryPath(uint32_t index) const
+    {
+        if (index >= m_entry.size())
+            return "";
+
+        return std::string(m_data + m_entry[index].pathOffset, m_entry[index].pathSize);
+    }
+
+    int Bundle::FindEntry(const std::string &path) const
+    {
+        if (!m_slotCount)
+            return -1;
+
+        const uint32_t hash = HashPath(path);
+        const uint32_t mask = m_slotCount - 1;
+
+        for (uint32_t probe = 0; probe < m_slotCount; probe++)
+        {
+            uint32_t slot = ReadU32(m_slots + ((hash + probe) & mask) * 4);
+            if (slot == 0 || slot > m_entry.size())
+                return -1;
+
+            const Entry &entry = m_entry[slot - 1];
+            if (entry.pathHash == hash && entry.pathSize == path.size()
+                && memcmp(m_data + entry.pathOffset, path.data(), path.size()) == 0)
+                return (int)(slot - 1);
+        }
+
+        return -1;
+    }
+
+    bool Bundle::Contains(const std::string &path) const
+    {
+        return FindEntry(path) >= 0;
+    }
+
+    ParseResult Bundle::GetData(const std::string &path, const char *&data, size_t &size, std::vector<char> &scratch) const
+    {
+        int index = FindEntry(path);
+        if (index < 0)
+        {
+            SetErrorText("Cannot find " + path + " in the bundle!");
+            return ParseResult::ERROR_NOT_FOUND;
+        }
+
+        const Entry &entry = m_entry[index];
+        if ((entry.flags & BUNDLE_FLAG_LZ4) == 0)
+        {
+            data = m_data + entry.dataOffset;
+            size = entry.size;
+            return ParseResult::OK;
+        }
+
+#ifdef DFP_USE_LZ4
+        scratch.resize(entry.size);
+        int unpacked = LZ4_decompress_safe(m_data + entry.dataOffset, scratch.data(), (int)entry.storedSize, (int)entry.size);
+        if (unpacked != (int)entry.size)
+        {
+            SetErrorText("Cannot decompress " + path + " from the bundle!");
+            return ParseResult::ERROR_PARSING_FAILED;
+        }
+
+        data = scratch.data();
+        size = entry.size;
+        return ParseResult::OK;
+#else
+        (void)scratch;
+        SetErrorText(path + " is compressed with LZ4, build the library with DFP_USE_LZ4!");
+        return ParseResult::ERROR_UNSUPPORTED;
+#endif
+    }
+
+    ParseResult Bundle::ParseSprite(const std::string &path, Sprite &sprite) const
+    {
+        const char *data = nullptr;
+        size_t size = 0;
+        std::vector<char> scratch;
+
+        ParseResult result = GetData(path, data, size, scratch);
+        if (result != ParseResult::OK)
+            return result;
+
+        return sprite.ParseBuffer(data, size, path);
+    }
+
+    ParseResult Bundle::ParseAnimations(const std::string &path, Animations &animations) const
+    {
+        const char *data = nullptr;
+        size_t size = 0;
+        std::vector<char> scratch;
+
+        ParseResult result = GetData(path, data, size, scratch);
+        if (result != ParseResult::OK)
+            return result;
+
+        return animations.ParseBuffer(data, size, path);
+    }
+
+
+
+
+    BundleWriter::BundleWriter() : m_errorText("")
+    {}
+
+    std::string BundleWriter::GetErrorText() const { return m_errorText; }
+
+    ParseResult BundleWriter::AddFile(const std::string &path, const std::string &fileName)
+    {
+        FILE *file = fopen(fileName.c_str(), "rb");
+        if (!file)
+        {
+            m_errorText = "Cannot open the file " + fileName;
+            return ParseResult::ERROR_COULDNT_OPEN;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (fileSize < 0)
+        {
+            fclose(file);
+            m_errorText = "Invalid size for " + fileName;
+            return ParseResult::ERROR_INVALID_FILE_SIZE;
+        }
+
+        std::vector<char> data((size_t)fileSize);
+        size_t readSize = fileSize ? fread(data.data(), 1, (size_t)fileSize, file) : 0;
+        fclose(file);
+        if (readSize != (size_t)fileSize)
+        {
+            m_errorText = "Cannot read the file " + fileName;
+            return ParseResult::ERROR_COULDNT_OPEN;
+        }
+
+        m_path.push_back(path);
+        m_data.push_back(data);
+
+        return ParseResult::OK;
+    }
+
+    void BundleWriter::AddData(const std::string &path, const char *data, size_t size)
+    {
+        m_path.push_back(path);
+        m_data.push_back(std::vector<char>(data, data + size));
+    }
+
+    ParseResult BundleWriter::Write(const std::string &fileName, bool compress)
+    {
+        const uint32_t entryCount = (uint32_t)m_path.size();
+
+        /// Keep the table at most half full, so the probes are short.
+        uint32_t slotCount = 1;
+        while (slotCount < entryCount * 2)
+            slotCount <<= 1;
+
+        std::vector<char> out;
+        out.insert(out.end(), BUNDLE_MAGIC, BUNDLE_MAGIC + 4);
+        WriteU32(out, BUNDLE_VERSION);
+        WriteU32(out, entryCount);
+        WriteU32(out, slotCount);
+        WriteU64(out, BUNDLE_HEADER_SIZE);
+        WriteU64(out, BUNDLE_HEADER_SIZE + (uint64_t)entryCount * BUNDLE_ENTRY_SIZE);
+
+        /// The entries are patched when the paths and the data are written.
+        const size_t entriesOffset = out.size();
+        out.resize(out.size() + (size_t)entryCount * BUNDLE_ENTRY_SIZE + (size_t)slotCount * 4, 0);
+        const size_t slotsOffset = entriesOffset + (size_t)entryCount * BUNDLE_ENTRY_SIZE;
+
+        for (uint32_t i = 0; i < entryCount; i++)
+        {
+            const std::string &path = m_path[i];
+            const std::vector<char> &data = m_data[i];
+            const uint32_t hash = HashPath(path);
+            const size_t entry = entriesOffset + (size_t)i * BUNDLE_ENTRY_SIZE;
+
+            /// Insert in the hash table.
+            uint32_t slot = hash & (slotCount - 1);
+            for (;;)
+            {
+                uint32_t used = ReadU32(&out[slotsOffset + slot * 4]);
+                if (used == 0)
+                    break;
+
+                if (m_path[used - 1] == path)
+                {
+                    m_errorText = "The path " + path + " was added twice!";
+                    return ParseResult::ERROR_NAME_WRONG;
+                }
+
+                slot = (slot + 1) & (slotCount - 1);
+            }
+            PatchU32(out, slotsOffset + slot * 4, i + 1);
+
+            /// The path offset and the sizes are 32 bits in an entry.
+            if ((uint64_t)out.size() > 0xFFFFFFFF || (uint64_t)path.size() > 0xFFFFFFFF || (uint64_t)data.size() > 0xFFFFFFFF)
+            {
+                m_errorText = "Cannot write the file " + fileName + ", the offset or the size of " + path + " is over 4 GB!";
+                return ParseResult::ERROR_COULDNT_WRITE;
+            }
+
+            PatchU32(out, entry, hash);
+            PatchU32(out, entry + 4, (uint32_t)out.size());
+            PatchU32(out, entry + 8, (uint32_t)path.size());
+            out.insert(out.end(), path.begin(), path.end());
+
+            uint32_t flags = 0;
+            std::vector<char> stored;
+#ifdef DFP_USE_LZ4
+            if (compress && !data.empty())
+            {
+                stored.resize(LZ4_compressBound((int)data.size()));
+                int packed = LZ4_compress_default(data.data(), stored.data(), (int)data.size(), (int)stored.size());
+                if (packed > 0 && (size_t)packed < data.size())
+                {
+                    stored.resize(packed);
+                    flags |= Bundle::BUNDLE_FLAG_LZ4;
+                }
+            }
+#else
+            (void)compress;
+#endif
+            const std::vector<char> &payload = (flags & Bundle::BUNDLE_FLAG_LZ4) ? stored : data;
+
+            PatchU32(out, entry + 12, flags);
+            PatchU64(out, entry + 16, out.size());
+            PatchU32(out, entry + 24, (uint32_t)payload.size());
+            PatchU32(out, entry + 28, (uint32_t)data.size());
+            out.insert(out.end(), payload.begin(), payload.end());
+        }
+
+        FILE *file = fopen(fileName.c_str(), "wb");
+        if (!file)
+        {
+            m_errorText = "Cannot write the file " + fileName;
+            return ParseResult::ERROR_COULDNT_WRITE;
+        }
+
+        size_t written = fwrite(out.data(), 1, out.size(), file);
+        fclose(file);
+        if (written != out.size())
+        {
+            m_errorText = "Cannot write the file " + fileName;
+            return ParseResult::ERROR_COULDNT_WRITE;
+        }
+
+        return ParseResult::OK;
+    }
+
+} //namespace dfp
@@ -0,0 +1,167 @@
+#include "DarkFunctionParser/GpuExport.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+
+#include <algorithm>
+
+namespace dfp
+{
+    static_assert(sizeof(GpuAnim) == 16, "GpuAnim must be 16 bytes");
+    static_assert(sizeof(GpuCell) == 16, "GpuCell must be 16 bytes");
+    static_assert(sizeof(GpuCellSpr) == 16, "GpuCellSpr must be 16 bytes");
+    static_assert(sizeof(GpuRect) == 32, "GpuRect must be 32 bytes");
+
+    const uint32_t GpuAnimBuffers::INVALID_INDEX;
+
+    GpuAnimBuffers::GpuAnimBuffers()
+        : m_errorText("")
+    {}
+
+    ParseResult GpuAnimBuffers::Build(const Animations &animations, const Sprite &sprite)
+    {
+        anims.clear();
+        cells.clear();
+        cellSprs.clear();
+        rects.clear();
+        animNames.clear();
+        rectPaths.clear();
+        m_animIndex.clear();
+        m_errorText = "";
+
+        if (sprite.GetImageW() == 0 || sprite.GetImageH() == 0)
+        {
+            m_errorText = "The image size of " + sprite.GetImageFileName(true) + " is 0!";
+            return ParseResult::ERROR_NUMERIC_ATTRIBUTE_WRONG;
+        }
+
+        float imageW = (float)sprite.GetImageW();
+        float imageH = (float)sprite.GetImageH();
+
+        /// Pair (sprite path, index in rects), a rect is used by many cells.
+        std::map<std::string, uint32_t> rectIndex;
+
+        const std::map< std::string, std::shared_ptr<Anim> > &animMap = animations.GetAnims();
+        for (std::map< std::string, std::shared_ptr<Anim> >::const_iterator it = animMap.begin(); it != animMap.end(); ++it)
+        {
+            const Anim &anim = *it->second;
+
+            GpuAnim gpuAnim;
+            gpuAnim.firstCell = (uint32_t)cells.size();
+            gpuAnim.cellCount = (uint32_t)anim.GetCells().size();
+            gpuAnim.period = 0;
+            gpuAnim.loops = anim.GetLoops();
+
+            for (size_t c = 0; c < anim.GetCells().size(); c++)
+            {
+                const Cell &cell = *anim.GetCells()[c];
+
+                /// Same as Anim::Update, a delay of 0 is 1 millisecond.
+                uint32_t delay = cell.GetDelay();
+                if (delay == 0)
+                    delay = 1;
+
+                if (gpuAnim.period > 0xFFFFFFFF - delay)
+                {
+                    m_errorText = "The anim " + anim.GetName() + " is too long!";
+                    return ParseResult::ERROR_NUMERIC_ATTRIBUTE_WRONG;
+                }
+                gpuAnim.period += delay;
+
+                GpuCell gpuCell;
+                gpuCell.endTime = gpuAnim.period;
+                gpuCell.firstSpr = (uint32_t)cellSprs.size();
+                gpuCell.sprCount = (uint32_t)cell.GetCellsSpr().size();
+                gpuCell.padding = 0;
+                cells.push_back(gpuCell);
+
+                for (size_t s = 0; s < cell.GetCellsSpr().size(); s++)
+                {
+                    const CellSpr &cellSpr = *cell.GetCellsSpr()[s];
+                    std::string path = cellSpr.GetName();
+
+                    GpuCellSpr gpuCellSpr;
+                    gpuCellSpr.x = cellSpr.GetX();
+                    gpuCellSpr.y = cellSpr.GetY();
+                    gpuCellSpr.z = cellSpr.GetZ();
+
+                    std::map<std::string, uint32_t>::const_iterator found = rectIndex.find(path);
+                    if (found != rectIndex.end())
+                    {
+                        gpuCellSpr.rect = found->second;
+                    }
+                    else
+                    {
+                        std::shared_ptr<Spr> spr = sprite.GetSpr(path);
+                        if (!spr)
+                        {
+                            m_errorText = "Cannot find the sprite " + path + " used by the anim " + anim.GetName() + "!";
+                            return ParseResult::ERROR_NOT_FOUND;
+                        }
+
+                        GpuRect rect;
+                        rect.u0 = (float)spr->GetX() / imageW;
+                        rect.v0 = (float)spr->GetY() / imageH;
+                        rect.u1 = (float)(spr->GetX() + spr->GetW()) / imageW;
+                        rect.v1 = (float)(spr->GetY() + spr->GetH()) / imageH;
+                        rect.w = spr->GetW();
+                        rect.h = spr->GetH();
+                        rect.padding[0] = 0;
+                        rect.padding[1] = 0;
+
+                        gpuCellSpr.rect = (uint32_t)rects.size();
+                        rectIndex[path] = gpuCellSpr.rect;
+                        rects.push_back(rect);
+                        rectPaths.push_back(path);
+                    }
+
+                    cellSprs.push_back(gpuCellSpr);
+                }
+            }
+
+            m_animIndex[it->first] = (uint32_t)anims.size();
+            anims.push_back(gpuAnim);
+            animNames.push_back(it->first);
+        }
+
+        return ParseResult::OK;
+    }
+
+    std::string GpuAnimBuffers::GetErrorText() const
+    {
+        return m_errorText;
+    }
+
+    uint32_t GpuAnimBuffers::FindAnim(const std::string &animName) const
+    {
+        std::map<std::string, uint32_t>::const_iterator it = m_animIndex.find(animName);
+        if (it == m_animIndex.end())
+            return INVALID_INDEX;
+
+        return it->second;
+    }
+
+    /// Used by the binary search in EvaluateCell.
+    static bool CellEndsBefore(const GpuCell &cell, uint32_t time)
+    {
+        return cell.endTime < time;
+    }
+
+    uint32_t GpuAnimBuffers::EvaluateCell(uint32_t animIndex, uint32_t timeMilliseconds) const
+    {
+        if (animIndex >= anims.size())
+            return INVALID_INDEX;
+
+        const GpuAnim &anim = anims[animIndex];
+        if (anim.cellCount == 0)
+            return INVALID_INDEX;
+
+        /// Reduce the time in (0, period], the end of a cell is part of the cell.
+        uint32_t r = (timeMilliseconds == 0) ? 0 : (timeMilliseconds - 1) % anim.period + 1;
+
+        std::vector<GpuCell>::const_iterator first = cells.begin() + anim.firstCell;
+        std::vector<GpuCell>::const_iterator last = first + anim.cellCount;
+
+        return (uint32_t)(std::lower_bound(first, last, r, CellEndsBefore) - first);
+    }
+
+} //namespace dfp
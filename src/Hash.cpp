@@ -0,0 +1,123 @@
+#include "DarkFunctionParser/Hash.h"
+
+namespace dfp
+{
+    const uint32_t HashIndex::INVALID_INDEX;
+
+    /// The size of the first table.
+    static const size_t HASH_INDEX_MIN_SLOTS = 16;
+
+    HashIndex::HashIndex()
+        : m_count(0)
+    {}
+
+    void HashIndex::Clear()
+    {
+        m_slots.clear();
+        m_count = 0;
+    }
+
+    bool HashIndex::Insert(uint32_t hash, uint32_t index)
+    {
+        /// Keep the table at most half full, so the probes are short.
+        if ((m_count + 1) * 2 > m_slots.size())
+            Grow();
+
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask)
+        {
+            Slot &slot = m_slots[i];
+            if (slot.index == INVALID_INDEX)
+            {
+                slot.hash = hash;
+                slot.index = index;
+                m_count++;
+                return true;
+            }
+
+            if (slot.hash == hash)
+                return false;
+        }
+    }
+
+    uint32_t HashIndex::Find(uint32_t hash) const
+    {
+        if (m_slots.empty())
+            return INVALID_INDEX;
+
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = hash & mask; ; i = (i + 1) & mask)
+        {
+            const Slot &slot = m_slots[i];
+            if (slot.index == INVALID_INDEX)
+                return INVALID_INDEX;
+
+            if (slot.hash == hash)
+                return slot.index;
+        }
+    }
+
+    bool HashIndex::Erase(uint32_t hash)
+    {
+        if (m_slots.empty())
+            return false;
+
+        size_t mask = m_slots.size() - 1;
+        size_t i = hash & mask;
+        for (; ; i = (i + 1) & mask)
+        {
+            if (m_slots[i].index == INVALID_INDEX)
+                return false;
+
+            if (m_slots[i].hash == hash)
+                break;
+        }
+
+        /// Move back the next slots of the probe sequence, so Find never
+        /// stops at the hole. A slot can move to the hole only if its
+        /// first probe is not between the hole and the slot.
+        for (size_t j = (i + 1) & mask; m_slots[j].index != INVALID_INDEX; j = (j + 1) & mask)
+        {
+            size_t home = m_slots[j].hash & mask;
+            if (((j - home) & mask) >= ((j - i) & mask))
+            {
+                m_slots[i] = m_slots[j];
+                i = j;
+            }
+        }
+
+        m_slots[i].hash = 0;
+        m_slots[i].index = INVALID_INDEX;
+        m_count--;
+        return true;
+    }
+
+    size_t HashIndex::GetCount() const
+    {
+        return m_count;
+    }
+
+    size_t HashIndex::GetMemoryBytes() const
+    {
+        return m_slots.capacity() * sizeof(Slot);
+    }
+
+    void HashIndex::Grow()
+    {
+        std::vector<Slot> old;
+        old.swap(m_slots);
+
+        Slot empty;
+        empty.hash = 0;
+        empty.index = INVALID_INDEX;
+        m_slots.assign(old.empty() ? HASH_INDEX_MIN_SLOTS : old.size() * 2, empty);
+        m_count = 0;
+
+        for (size_t i = 0; i < old.size(); i++)
+        {
+            if (old[i].index != INVALID_INDEX)
+                Insert(old[i].hash, old[i].index);
+        }
+    }
+
+} //namespace dfp
@@ -0,0 +1,157 @@
+#include "DarkFunctionParser/JobPool.h"
+
+namespace dfp
+{
+    JobPool::JobPool(uint32_t threadCount)
+        : m_pending(0)
+        , m_generation(0)
+        , m_stop(false)
+    {
+        if (threadCount == 0)
+        {
+            uint32_t cores = std::thread::hardware_concurrency();
+            threadCount = (cores > 1) ? cores - 1 : 0;
+        }
+
+        /// One queue for each thread and one for the caller.
+        for (uint32_t i = 0; i <= threadCount; i++)
+            m_queues.push_back(std::unique_ptr<Queue>(new Queue()));
+
+        for (uint32_t i = 0; i < threadCount; i++)
+            m_threads.push_back(std::thread(&JobPool::WorkerMain, this, i));
+    }
+
+    JobPool::~JobPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_stop = true;
+        }
+        m_wakeCondition.notify_all();
+
+        for (size_t i = 0; i < m_threads.size(); i++)
+            m_threads[i].join();
+    }
+
+    uint32_t JobPool::GetWorkerCount() const
+    {
+        return (uint32_t)m_queues.size();
+    }
+
+    void JobPool::ParallelFor(uint32_t count, JobFunction job, void *context)
+    {
+        if (count == 0)
+            return;
+
+        uint32_t workers = GetWorkerCount();
+
+        /// Nothing to share.
+        if (workers == 1 || count == 1)
+        {
+            for (uint32_t i = 0; i < count; i++)
+                job(context, i);
+            return;
+        }
+
+        m_pending.store(count);
+
+        /// Split the jobs in contiguous blocks, one for each worker.
+        Task task;
+        task.job = job;
+        task.context = context;
+        for (uint32_t w = 0; w < workers; w++)
+        {
+            uint32_t begin = (uint32_t)((uint64_t)count * w / workers);
+            uint32_t end = (uint32_t)((uint64_t)count * (w + 1) / workers);
+
+            Queue &queue = *m_queues[w];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            for (uint32_t i = begin; i < end; i++)
+            {
+                task.index = i;
+                queue.tasks.push_back(task);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_generation++;
+        }
+        m_wakeCondition.notify_all();
+
+        RunTasks(workers - 1);
+
+        std::unique_lock<std::mutex> lock(m_doneMutex);
+        while (m_pending.load() != 0)
+            m_doneCondition.wait(lock);
+    }
+
+    void JobPool::WorkerMain(uint32_t worker)
+    {
+        uint64_t generation = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_wakeMutex);
+                while (!m_stop && m_generation == generation)
+                    m_wakeCondition.wait(lock);
+
+                if (m_stop)
+                    return;
+
+                generation = m_generation;
+            }
+
+            RunTasks(worker);
+        }
+    }
+
+    void JobPool::RunTasks(uint32_t worker)
+    {
+        Task task;
+        while (PopTask(worker, task))
+        {
+            task.job(task.context, task.index);
+
+            if (m_pending.fetch_sub(1) == 1)
+            {
+                /// The last one, wake up the caller.
+                std::lock_guard<std::mutex> lock(m_doneMutex);
+                m_doneCondition.notify_all();
+            }
+        }
+    }
+
+    bool JobPool::PopTask(uint32_t worker, Task &task)
+    {
+        uint32_t workers = GetWorkerCount();
+
+        /// The own queue, from the back.
+        {
+            Queue &queue = *m_queues[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty())
+            {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+                return true;
+            }
+        }
+
+        /// Steal from the front of the others.
+        for (uint32_t i = 1; i < workers; i++)
+        {
+            Queue &queue = *m_queues[(worker + i) % workers];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty())
+            {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+} //namespace dfp
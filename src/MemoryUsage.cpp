@@ -0,0 +1,88 @@
+#include "DarkFunctionParser/MemoryUsage.h"
+
+namespace dfp
+{
+    /// The control block of std::make_shared: a vtable pointer and two counters.
+    static const size_t SHARED_CONTROL_BLOCK_SIZE = sizeof(void*) + 2 * sizeof(int);
+
+    /// A red-black tree node: 3 pointers and the color (padded to a pointer).
+    static const size_t MAP_NODE_OVERHEAD = 4 * sizeof(void*);
+
+    MemoryUsage::MemoryUsage()
+        : objects(0)
+        , strings(0)
+        , containers(0)
+        , controlBlocks(0)
+    {
+        for (int i = 0; i < NODE_TYPE_COUNT; i++)
+        {
+            nodeCount[i] = 0;
+            nodeBytes[i] = 0;
+        }
+    }
+
+    size_t MemoryUsage::GetTotal() const
+    {
+        return objects + strings + containers + controlBlocks;
+    }
+
+    MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other)
+    {
+        for (int i = 0; i < NODE_TYPE_COUNT; i++)
+        {
+            nodeCount[i] += other.nodeCount[i];
+            nodeBytes[i] += other.nodeBytes[i];
+        }
+
+        objects += other.objects;
+        strings += other.strings;
+        containers += other.containers;
+        controlBlocks += other.controlBlocks;
+
+        return *this;
+    }
+
+    void MemoryUsage::AddSharedObject(NodeType type, size_t objectSize)
+    {
+        AddObject(type, objectSize);
+
+        controlBlocks += SHARED_CONTROL_BLOCK_SIZE;
+        nodeBytes[type] += SHARED_CONTROL_BLOCK_SIZE;
+    }
+
+    void MemoryUsage::AddObject(NodeType type, size_t objectSize)
+    {
+        nodeCount[type]++;
+
+        objects += objectSize;
+        nodeBytes[type] += objectSize;
+    }
+
+    void MemoryUsage::AddString(NodeType type, const std::string& text)
+    {
+        /// A short string is stored inside the std::string object (SSO).
+        const char* data = text.data();
+        const char* object = (const char*)&text;
+        if (data >= object && data < object + sizeof(std::string))
+            return;
+
+        size_t size = text.capacity() + 1;
+        strings += size;
+        nodeBytes[type] += size;
+    }
+
+    void MemoryUsage::AddMapNodes(NodeType type, size_t count, size_t valueSize)
+    {
+        size_t size = count * (MAP_NODE_OVERHEAD + valueSize);
+        containers += size;
+        nodeBytes[type] += size;
+    }
+
+    void MemoryUsage::AddVectorBuffer(NodeType type, size_t capacity, size_t valueSize)
+    {
+        size_t size = capacity * valueSize;
+        containers += size;
+        nodeBytes[type] += size;
+    }
+
+} //namespace dfp
@@ -0,0 +1,313 @@
+#include "DarkFunctionParser/Metrics.h"
+#include "DarkFunctionParser/Trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+namespace dfp
+{
+    /// The metrics of one thread. Only its thread writes them, so a
+    /// relaxed load and store is enough (no lock, no read-modify-write),
+    /// GetSnapshot reads them from another thread.
+    struct MetricsBlock
+    {
+        std::atomic<uint64_t> counters[Metrics::COUNTER_COUNT];
+        std::atomic<int64_t> gauges[Metrics::GAUGE_COUNT];
+        std::atomic<uint64_t> buckets[Metrics::HISTOGRAM_COUNT][Metrics::BUCKET_COUNT];
+        std::atomic<uint64_t> maxima[Metrics::HISTOGRAM_COUNT];
+
+        MetricsBlock()
+        {
+            for (uint32_t i = 0; i < Metrics::COUNTER_COUNT; i++)
+                counters[i].store(0, std::memory_order_relaxed);
+            for (uint32_t i = 0; i < Metrics::GAUGE_COUNT; i++)
+                gauges[i].store(0, std::memory_order_relaxed);
+            for (uint32_t h = 0; h < Metrics::HISTOGRAM_COUNT; h++)
+            {
+                for (uint32_t b = 0; b < Metrics::BUCKET_COUNT; b++)
+                    buckets[h][b].store(0, std::memory_order_relaxed);
+                maxima[h].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    /// All the blocks. They are never removed, so the counts of a thread
+    /// that has ended are kept. The block of an ended thread is given to
+    /// the next new thread, so the list does not grow with the threads.
+    static std::mutex s_blocksMutex;
+    static std::vector<MetricsBlock *> s_blocks;
+    static std::vector<MetricsBlock *> s_freeBlocks;
+
+    /// The block of the current thread, created at the first count and
+    /// released when the thread ends.
+    struct MetricsThread
+    {
+        MetricsBlock *block;
+
+        MetricsThread()
+            : block(nullptr)
+        {}
+
+        ~MetricsThread()
+        {
+            if (!block)
+                return;
+
+            std::lock_guard<std::mutex> lock(s_blocksMutex);
+            s_freeBlocks.push_back(block);
+        }
+    };
+
+    static thread_local MetricsThread t_thread;
+
+    static MetricsBlock& GetThreadBlock()
+    {
+        if (!t_thread.block)
+        {
+            std::lock_guard<std::mutex> lock(s_blocksMutex);
+            if (!s_freeBlocks.empty())
+            {
+                t_thread.block = s_freeBlocks.back();
+                s_freeBlocks.pop_back();
+            }
+            else
+            {
+                t_thread.block = new MetricsBlock();
+                s_blocks.push_back(t_thread.block);
+            }
+        }
+
+        return *t_thread.block;
+    }
+
+    /// Add to a value written only by the current thread.
+    template <typename T>
+    static void AddRelaxed(std::atomic<T> &value, T delta)
+    {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static const char *s_counterNames[Metrics::COUNTER_COUNT] =
+    {
+        "anim_updates",
+        "cells_advanced",
+        "tick_instance_updates",
+        "tick_catchups",
+        "spr_lookups",
+        "spr_lookup_misses",
+    };
+
+    static const char *s_gaugeNames[Metrics::GAUGE_COUNT] =
+    {
+        "tick_instances",
+    };
+
+    static const char *s_histogramNames[Metrics::HISTOGRAM_COUNT] =
+    {
+        "update_iterations",
+    };
+
+    const uint32_t Metrics::BUCKET_COUNT;
+
+    Metrics::Snapshot::Snapshot()
+    {
+        timeMicroseconds = 0;
+        memset(counters, 0, sizeof(counters));
+        memset(gauges, 0, sizeof(gauges));
+        memset(buckets, 0, sizeof(buckets));
+        memset(maxima, 0, sizeof(maxima));
+    }
+
+    void Metrics::Snapshot::Subtract(const Snapshot &older)
+    {
+        timeMicroseconds -= older.timeMicroseconds;
+
+        for (uint32_t i = 0; i < COUNTER_COUNT; i++)
+            counters[i] -= older.counters[i];
+
+        for (uint32_t h = 0; h < HISTOGRAM_COUNT; h++)
+        {
+            for (uint32_t b = 0; b < BUCKET_COUNT; b++)
+                buckets[h][b] -= older.buckets[h][b];
+        }
+    }
+
+    uint64_t Metrics::Snapshot::GetBucketMax(Histogram histogram) const
+    {
+        /// The last bucket has no upper bound, use the max since the start.
+        if (buckets[histogram][BUCKET_COUNT - 1])
+            return maxima[histogram];
+
+        for (uint32_t b = BUCKET_COUNT - 1; b > 0; b--)
+        {
+            if (buckets[histogram][b - 1])
+                return ((uint64_t)1 << (b - 1)) - 1;
+        }
+
+        return 0;
+    }
+
+    bool Metrics::IsEnabled()
+    {
+#ifdef DFP_ENABLE_METRICS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Metrics::Add(Counter counter, uint64_t value)
+    {
+        AddRelaxed(GetThreadBlock().counters[counter], value);
+    }
+
+    void Metrics::AddGauge(Gauge gauge, int64_t delta)
+    {
+        AddRelaxed(GetThreadBlock().gauges[gauge], delta);
+    }
+
+    void Metrics::Record(Histogram histogram, uint64_t value)
+    {
+        /// The bucket is the number of bits of the value.
+        uint32_t bucket = 0;
+        for (uint64_t v = value; v && bucket < BUCKET_COUNT - 1; v >>= 1)
+            bucket++;
+
+        MetricsBlock &block = GetThreadBlock();
+        AddRelaxed(block.buckets[histogram][bucket], (uint64_t)1);
+
+        if (value > block.maxima[histogram].load(std::memory_order_relaxed))
+            block.maxima[histogram].store(value, std::memory_order_relaxed);
+    }
+
+    void Metrics::GetSnapshot(Snapshot &snapshot)
+    {
+        snapshot = Snapshot();
+        snapshot.timeMicroseconds = Trace::Now();
+
+        std::lock_guard<std::mutex> lock(s_blocksMutex);
+        for (size_t i = 0; i < s_blocks.size(); i++)
+        {
+            const MetricsBlock &block = *s_blocks[i];
+
+            for (uint32_t c = 0; c < COUNTER_COUNT; c++)
+                snapshot.counters[c] += block.counters[c].load(std::memory_order_relaxed);
+
+            for (uint32_t g = 0; g < GAUGE_COUNT; g++)
+                snapshot.gauges[g] += block.gauges[g].load(std::memory_order_relaxed);
+
+            for (uint32_t h = 0; h < HISTOGRAM_COUNT; h++)
+            {
+                for (uint32_t b = 0; b < BUCKET_COUNT; b++)
+                    snapshot.buckets[h][b] += block.buckets[h][b].load(std::memory_order_relaxed);
+
+                uint64_t max = block.maxima[h].load(std::memory_order_relaxed);
+                if (max > snapshot.maxima[h])
+                    snapshot.maxima[h] = max;
+            }
+        }
+    }
+
+    const char *Metrics::GetName(Counter counter)
+    {
+        return counter < COUNTER_COUNT ? s_counterNames[counter] : "";
+    }
+
+    const char *Metrics::GetName(Gauge gauge)
+    {
+        return gauge < GAUGE_COUNT ? s_gaugeNames[gauge] : "";
+    }
+
+    const char *Metrics::GetName(Histogram histogram)
+    {
+        return histogram < HISTOGRAM_COUNT ? s_histogramNames[histogram] : "";
+    }
+
+    std::string Metrics::GetText(const Snapshot &snapshot)
+    {
+        std::string text;
+        char line[256];
+
+        for (uint32_t c = 0; c < COUNTER_COUNT; c++)
+        {
+            snprintf(line, sizeof(line), "# TYPE dfp_%s counter\ndfp_%s %llu\n",
+                s_counterNames[c], s_counterNames[c], (unsigned long long)snapshot.counters[c]);
+            text += line;
+        }
+
+        for (uint32_t g = 0; g < GAUGE_COUNT; g++)
+        {
+            snprintf(line, sizeof(line), "# TYPE dfp_%s gauge\ndfp_%s %lld\n",
+                s_gaugeNames[g], s_gaugeNames[g], (long long)snapshot.gauges[g]);
+            text += line;
+        }
+
+        for (uint32_t h = 0; h < HISTOGRAM_COUNT; h++)
+        {
+            const char *name = s_histogramNames[h];
+            snprintf(line, sizeof(line), "# TYPE dfp_%s histogram\n", name);
+            text += line;
+
+            /// There is no sum of the values, only the max is known.
+            uint64_t count = 0;
+            for (uint32_t b = 0; b < BUCKET_COUNT; b++)
+            {
+                count += snapshot.buckets[h][b];
+                if (b == BUCKET_COUNT - 1)
+                    snprintf(line, sizeof(line), "dfp_%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)count);
+                else
+                    snprintf(line, sizeof(line), "dfp_%s_bucket{le=\"%llu\"} %llu\n", name,
+                        (unsigned long long)(((uint64_t)1 << b) - 1),
+                        (unsigned long long)count);
+                text += line;
+            }
+
+            snprintf(line, sizeof(line), "dfp_%s_count %llu\n# TYPE dfp_%s_max gauge\ndfp_%s_max %llu\n",
+                name, (unsigned long long)count, name, name, (unsigned long long)snapshot.maxima[h]);
+            text += line;
+        }
+
+        return text;
+    }
+
+
+
+
+    MetricsGauge::MetricsGauge(Metrics::Gauge gauge)
+        : m_gauge(gauge)
+        , m_value(0)
+    {}
+
+    MetricsGauge::MetricsGauge(const MetricsGauge &other)
+        : m_gauge(other.m_gauge)
+        , m_value(0)
+    {
+        Add(other.m_value);
+    }
+
+    MetricsGauge& MetricsGauge::operator=(const MetricsGauge &other)
+    {
+        Add(-m_value);
+        m_gauge = other.m_gauge;
+        Add(other.m_value);
+        return *this;
+    }
+
+    MetricsGauge::~MetricsGauge()
+    {
+        Add(-m_value);
+    }
+
+    void MetricsGauge::Add(int64_t delta)
+    {
+        m_value += delta;
+#ifdef DFP_ENABLE_METRICS
+        if (delta)
+            Metrics::AddGauge(m_gauge, delta);
+#endif
+    }
+
+} //namespace dfp
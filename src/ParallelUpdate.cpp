@@ -0,0 +1,80 @@
+#include "DarkFunctionParser/ParallelUpdate.h"
+#include "DarkFunctionParser/Animations.h"
+
+namespace dfp
+{
+    /// The parameters shared by all the jobs of UpdateAnims.
+    struct UpdateAnimsContext
+    {
+        const std::shared_ptr<Anim> *anims;
+        size_t count;
+        float dtSeconds;
+        float animSpeedFactor;
+        uint8_t *changed;
+        uint32_t rangeSize;
+    };
+
+    /// Update one range. Each job writes only the changed flags of its range.
+    static void UpdateAnimsRange(void *context, uint32_t index)
+    {
+        const UpdateAnimsContext &ctx = *(const UpdateAnimsContext *)context;
+
+        size_t begin = (size_t)index * ctx.rangeSize;
+        size_t end = begin + ctx.rangeSize;
+        if (end > ctx.count)
+            end = ctx.count;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            Anim *anim = ctx.anims[i].get();
+            if (!anim || anim->GetCells().empty())
+            {
+                if (ctx.changed)
+                    ctx.changed[i] = 0;
+                continue;
+            }
+
+            /// The changed flag compares the cell index before and after
+            /// Update. GetCurrentCellIndex is not recorded (see Recorder),
+            /// so these reads add no EVENT_CELL, only the Update is recorded.
+            uint32_t cellIndex = anim->GetCurrentCellIndex();
+            anim->Update(ctx.dtSeconds, ctx.animSpeedFactor);
+
+            if (ctx.changed)
+                ctx.changed[i] = (anim->GetCurrentCellIndex() != cellIndex) ? 1 : 0;
+        }
+    }
+
+    void UpdateAnims(const std::vector< std::shared_ptr<Anim> > &anims, float dtSeconds, float animSpeedFactor,
+        IJobSystem *jobSystem, std::vector<uint8_t> *changed, uint32_t rangeSize)
+    {
+        if (changed)
+            changed->assign(anims.size(), 0);
+
+        if (anims.empty())
+            return;
+
+        if (rangeSize == 0)
+            rangeSize = UPDATE_RANGE_SIZE;
+
+        UpdateAnimsContext context;
+        context.anims = anims.data();
+        context.count = anims.size();
+        context.dtSeconds = dtSeconds;
+        context.animSpeedFactor = animSpeedFactor;
+        context.changed = changed ? changed->data() : nullptr;
+        context.rangeSize = rangeSize;
+
+        uint32_t rangeCount = (uint32_t)((anims.size() + rangeSize - 1) / rangeSize);
+
+        if (!jobSystem)
+        {
+            for (uint32_t i = 0; i < rangeCount; i++)
+                UpdateAnimsRange(&context, i);
+            return;
+        }
+
+        jobSystem->ParallelFor(rangeCount, &UpdateAnimsRange, &context);
+    }
+
+} //namespace dfp
@@ -0,0 +1,501 @@
+#include "DarkFunctionParser/ParseCache.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Trace.h"
+#include "BinaryIO.h"
+
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <atomic>
+
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace dfp
+{
+    /// The start of an entry, then the version and the kind.
+    static const char CACHE_MAGIC[4] = { 'D', 'F', 'P', 'C' };
+    static const uint8_t CACHE_VERSION = 1;
+    static const uint8_t CACHE_KIND_SPRITE = 1;
+    static const uint8_t CACHE_KIND_ANIMATIONS = 2;
+
+    /// A file modified less than this before it is parsed is not cached:
+    /// with a coarse modification time, a change in the same second would
+    /// not be seen.
+    static const int64_t CACHE_MIN_AGE_SECONDS = 2;
+
+    /// A broken entry can not nest the dirs more than this.
+    static const uint32_t CACHE_MAX_DEPTH = 256;
+
+    static std::mutex s_mutex;
+    static std::string s_directory;
+    static ParseCache::Validation s_validation = ParseCache::VALIDATE_MTIME;
+
+    static std::atomic<uint64_t> s_hits(0);
+    static std::atomic<uint64_t> s_misses(0);
+    static std::atomic<uint64_t> s_writes(0);
+    static std::atomic<uint64_t> s_errors(0);
+
+    /// The temporary files of the writes must have different names.
+    static std::atomic<uint32_t> s_tempCounter(0);
+
+    /// The FNV-1a 64 bit hash.
+    static uint64_t Hash64(const void *data, size_t size)
+    {
+        const uint8_t *bytes = (const uint8_t *)data;
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    /// The size and the modification time (nanoseconds when the system
+    /// has them) of a file.
+    static bool GetFileInfo(const std::string &fileName, uint64_t &size, int64_t &mtime)
+    {
+#if defined(_WIN32)
+        struct _stat64 info;
+        if (_stat64(fileName.c_str(), &info) != 0)
+            return false;
+        mtime = (int64_t)info.st_mtime * 1000000000;
+#else
+        struct stat info;
+        if (stat(fileName.c_str(), &info) != 0)
+            return false;
+#if defined(__APPLE__)
+        mtime = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+        mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#else
+        mtime = (int64_t)info.st_mtime * 1000000000;
+#endif
+#endif
+        size = (uint64_t)info.st_size;
+        return true;
+    }
+
+    /// Read a whole file, with a '\0' after the data as ParseFile does.
+    static bool ReadWholeFile(const std::string &fileName, std::vector<uint8_t> &data)
+    {
+        DFP_TRACE_SCOPE_FILE("ReadFile", fileName);
+
+        FILE *file = fopen(fileName.c_str(), "rb");
+        if (!file)
+            return false;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        bool ok = size > 0;
+        if (ok)
+        {
+            data.resize((size_t)size + 1);
+            data[size] = 0;
+            ok = fread(data.data(), 1, (size_t)size, file) == (size_t)size;
+        }
+
+        fclose(file);
+        return ok;
+    }
+
+    /// Write an entry in a temporary file, then rename it, so the entry
+    /// is replaced at once.
+    static bool WriteEntry(const std::string &entryName, const std::vector<uint8_t> &data)
+    {
+        char suffix[64];
+#if defined(_WIN32)
+        snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", _getpid(), s_tempCounter.fetch_add(1));
+#else
+        snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", (int)getpid(), s_tempCounter.fetch_add(1));
+#endif
+        std::string tempName = entryName + suffix;
+
+        FILE *file = fopen(tempName.c_str(), "wb");
+        if (!file)
+            return false;
+
+        bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+        ok = fclose(file) == 0 && ok;
+
+#if defined(_WIN32)
+        ok = ok && MoveFileExA(tempName.c_str(), entryName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        ok = ok && rename(tempName.c_str(), entryName.c_str()) == 0;
+#endif
+        if (!ok)
+            remove(tempName.c_str());
+
+        return ok;
+    }
+
+    void ParseCache::WriteDir(std::vector<uint8_t> &data, const Dir &dir)
+    {
+        WriteString(data, dir.m_name);
+
+        WriteVarint(data, dir.m_dir.size());
+        for (const auto &child : dir.m_dir)
+            WriteDir(data, *child.second);
+
+        WriteVarint(data, dir.m_spr.size());
+        for (const auto &spr : dir.m_spr)
+        {
+            WriteString(data, spr.second->GetName());
+            WriteSigned(data, (int)spr.second->GetX());
+            WriteSigned(data, (int)spr.second->GetY());
+            WriteSigned(data, (int)spr.second->GetW());
+            WriteSigned(data, (int)spr.second->GetH());
+        }
+    }
+
+    std::shared_ptr<Dir> ParseCache::ReadDir(BinaryReader &reader, uint32_t depth)
+    {
+        if (depth > CACHE_MAX_DEPTH)
+            return nullptr;
+
+        std::shared_ptr<Dir> dir = std::make_shared<Dir>();
+        dir->m_name = reader.ReadString();
+
+        uint64_t dirCount = reader.ReadCount();
+        for (uint64_t i = 0; i < dirCount && !reader.Error(); i++)
+        {
+            std::shared_ptr<Dir> child = ReadDir(reader, depth + 1);
+            if (!child)
+                return nullptr;
+            dir->m_dir[child->m_name] = child;
+        }
+
+        uint64_t sprCount = reader.ReadCount();
+        for (uint64_t i = 0; i < sprCount && !reader.Error(); i++)
+        {
+            std::string name = reader.ReadString();
+            int x = (int)reader.ReadSigned();
+            int y = (int)reader.ReadSigned();
+            int w = (int)reader.ReadSigned();
+            int h = (int)reader.ReadSigned();
+            dir->m_spr[name] = std::make_shared<Spr>(name, x, y, w, h);
+        }
+
+        return reader.Error() ? nullptr : dir;
+    }
+
+    void ParseCache::SetDirectory(const std::string &directory, Validation validation)
+    {
+        std::string path = directory;
+        while (path.size() > 1 && (*path.rbegin() == '/' || *path.rbegin() == '\\'))
+            path.erase(path.size() - 1);
+
+        if (!path.empty())
+        {
+#if defined(_WIN32)
+            _mkdir(path.c_str());
+#else
+            mkdir(path.c_str(), 0755);
+#endif
+        }
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_directory = path;
+        s_validation = validation;
+    }
+
+    std::string ParseCache::GetDirectory()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        return s_directory;
+    }
+
+    ParseCache::Stats ParseCache::GetStats()
+    {
+        Stats stats;
+        stats.hits = s_hits.load();
+        stats.misses = s_misses.load();
+        stats.writes = s_writes.load();
+        stats.errors = s_errors.load();
+        return stats;
+    }
+
+    void ParseCache::ResetStats()
+    {
+        s_hits.store(0);
+        s_misses.store(0);
+        s_writes.store(0);
+        s_errors.store(0);
+    }
+
+    void ParseCache::Serialize(const Sprite &sprite, std::vector<uint8_t> &data)
+    {
+        WriteString(data, sprite.m_imageFileName);
+        WriteVarint(data, sprite.m_imageW);
+        WriteVarint(data, sprite.m_imageH);
+
+        data.push_back(sprite.m_root ? 1 : 0);
+        if (sprite.m_root)
+            WriteDir(data, *sprite.m_root);
+    }
+
+    void ParseCache::Serialize(const Animations &animations, std::vector<uint8_t> &data)
+    {
+        WriteString(data, animations.m_spriteFileName);
+        WriteString(data, animations.m_ver);
+
+        WriteVarint(data, animations.m_anim.size());
+        for (const auto &it : animations.m_anim)
+        {
+            const Anim &anim = *it.second;
+            WriteString(data, anim.m_name);
+            WriteSigned(data, anim.m_loops);
+
+            WriteVarint(data, anim.m_cell.size());
+            for (const auto &cell : anim.m_cell)
+            {
+                WriteVarint(data, cell->m_index);
+                WriteVarint(data, cell->m_delay);
+
+                WriteVarint(data, cell->m_cellsSpr.size());
+                for (const auto &cellSpr : cell->m_cellsSpr)
+                {
+                    WriteString(data, cellSpr->m_name);
+                    WriteSigned(data, cellSpr->m_x);
+                    WriteSigned(data, cellSpr->m_y);
+                    WriteSigned(data, cellSpr->m_z);
+                }
+            }
+        }
+    }
+
+    bool ParseCache::Deserialize(const uint8_t *data, size_t size, const std::string &fileName, Sprite &sprite)
+    {
+        BinaryReader reader(data, size);
+
+        std::string imageFileName = reader.ReadString();
+        unsigned int imageW = (unsigned int)reader.ReadVarint();
+        unsigned int imageH = (unsigned int)reader.ReadVarint();
+
+        std::shared_ptr<Dir> root;
+        if (reader.ReadByte())
+        {
+            root = ReadDir(reader, 0);
+            if (!root)
+                return false;
+        }
+
+        if (reader.Error() || !reader.IsEnd())
+            return false;
+
+        /// The same state as ParseText, built in a copy that is used only
+        /// if the index can be built.
+        Sprite loaded(sprite);
+        loaded.SetFilePath(fileName);
+        loaded.m_imageFileName = imageFileName;
+        loaded.m_imageW = imageW;
+        loaded.m_imageH = imageH;
+        if (root)
+            loaded.m_root = root;
+
+        if (loaded.BuildIndex() != ParseResult::OK)
+            return false;
+
+        loaded.ComputeMemoryUsage();
+        sprite = loaded;
+        return true;
+    }
+
+    bool ParseCache::Deserialize(const uint8_t *data, size_t size, const std::string &fileName, Animations &animations)
+    {
+        BinaryReader reader(data, size);
+
+        std::string spriteFileName = reader.ReadString();
+        std::string ver = reader.ReadString();
+
+        std::vector< std::shared_ptr<Anim> > anims;
+        uint64_t animCount = reader.ReadCount();
+        for (uint64_t a = 0; a < animCount && !reader.Error(); a++)
+        {
+            std::shared_ptr<Anim> anim = std::make_shared<Anim>();
+            anim->m_name = reader.ReadString();
+            anim->m_loops = (int)reader.ReadSigned();
+
+            uint64_t cellCount = reader.ReadCount();
+            for (uint64_t c = 0; c < cellCount && !reader.Error(); c++)
+            {
+                std::shared_ptr<Cell> cell = std::make_shared<Cell>();
+                cell->m_index = (unsigned int)reader.ReadVarint();
+                cell->m_delay = (unsigned int)reader.ReadVarint();
+
+                uint64_t cellSprCount = reader.ReadCount();
+                for (uint64_t s = 0; s < cellSprCount && !reader.Error(); s++)
+                {
+                    std::shared_ptr<CellSpr> cellSpr = std::make_shared<CellSpr>();
+                    cellSpr->m_name = reader.ReadString();
+                    cellSpr->m_x = (int)reader.ReadSigned();
+                    cellSpr->m_y = (int)reader.ReadSigned();
+                    cellSpr->m_z = (int)reader.ReadSigned();
+                    cell->m_cellsSpr.push_back(cellSpr);
+                }
+
+                anim->m_cell.push_back(cell);
+            }
+
+            anim->ClassifyPlayback();
+            anims.push_back(anim);
+        }
+
+        if (reader.Error() || !reader.IsEnd())
+            return false;
+
+        /// The same state as ParseText, built in a copy that is used only
+        /// if the index can be built.
+        Animations loaded(animations);
+        loaded.SetFilePath(fileName);
+        loaded.m_spriteFileName = spriteFileName;
+        loaded.m_ver = ver;
+        for (size_t i = 0; i < anims.size(); i++)
+            loaded.m_anim[anims[i]->GetName()] = anims[i];
+
+        if (loaded.BuildIndex() != ParseResult::OK)
+            return false;
+
+        loaded.ComputeMemoryUsage();
+        animations = loaded;
+        return true;
+    }
+
+    template <typename Document>
+    bool ParseCache::ParseCachedFile(const std::string &fileName, Document &document, uint8_t kind, ParseResult &result)
+    {
+        std::string directory;
+        Validation validation;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            directory = s_directory;
+            validation = s_validation;
+        }
+
+        if (directory.empty())
+            return false;
+
+        /// A file that can not be found is reported by the usual ParseFile.
+        uint64_t fileSize;
+        int64_t fileTime;
+        if (!GetFileInfo(fileName, fileSize, fileTime))
+            return false;
+
+        std::vector<uint8_t> content;
+        uint64_t contentHash = 0;
+        if (validation == VALIDATE_CONTENT)
+        {
+            if (!ReadWholeFile(fileName, content))
+                return false;
+            contentHash = Hash64(content.data(), content.size() - 1);
+            fileTime = 0;
+        }
+
+        char hashText[32];
+        snprintf(hashText, sizeof(hashText), "/%016llx.dfpc", (unsigned long long)Hash64(fileName.data(), fileName.size()));
+        std::string entryName = directory + hashText;
+
+        std::vector<uint8_t> entry;
+        if (ReadWholeFile(entryName, entry) && entry.size() > sizeof(CACHE_MAGIC))
+        {
+            DFP_TRACE_SCOPE_FILE("ParseCache::Load", fileName);
+
+            BinaryReader reader(entry.data(), entry.size() - 1);
+            bool valid = memcmp(entry.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0;
+            for (size_t i = 0; i < sizeof(CACHE_MAGIC); i++)
+                reader.ReadByte();
+            valid = valid && reader.ReadByte() == CACHE_VERSION;
+            valid = valid && reader.ReadByte() == kind;
+            valid = valid && reader.ReadString() == fileName;
+            valid = valid && reader.ReadVarint() == fileSize;
+            valid = valid && reader.ReadSigned() == fileTime;
+            valid = valid && reader.ReadVarint() == contentHash;
+
+            if (valid && !reader.Error())
+            {
+                /// The document is after the header.
+                size_t offset = reader.GetPosition();
+
+                if (Deserialize(entry.data() + offset, entry.size() - 1 - offset, fileName, document))
+                {
+                    s_hits.fetch_add(1);
+                    result = ParseResult::OK;
+                    return true;
+                }
+                s_errors.fetch_add(1);
+            }
+        }
+
+        s_misses.fetch_add(1);
+
+        if (content.empty() && !ReadWholeFile(fileName, content))
+            return false;
+
+        /// The entry must have only what this file has, not what the document
+        /// already had, so the file is parsed in an empty document. Then the
+        /// document gets it like from an entry that is read.
+        Document parsed;
+        if (parsed.ParseBuffer((const char *)content.data(), content.size() - 1, fileName) != ParseResult::OK)
+        {
+            result = document.ParseBuffer((const char *)content.data(), content.size() - 1, fileName);
+            return true;
+        }
+
+        std::vector<uint8_t> data;
+        Serialize(parsed, data);
+
+        /// A document that can not get it (anims of 2 files with the same
+        /// id) gets the usual parse and its error.
+        if (Deserialize(data.data(), data.size(), fileName, document))
+            result = ParseResult::OK;
+        else
+        {
+            result = document.ParseBuffer((const char *)content.data(), content.size() - 1, fileName);
+            return true;
+        }
+
+        if (validation == VALIDATE_MTIME && (int64_t)time(nullptr) - fileTime / 1000000000 < CACHE_MIN_AGE_SECONDS)
+            return true;
+
+        DFP_TRACE_SCOPE_FILE("ParseCache::Store", fileName);
+
+        entry.clear();
+        entry.insert(entry.end(), CACHE_MAGIC, CACHE_MAGIC + sizeof(CACHE_MAGIC));
+        entry.push_back(CACHE_VERSION);
+        entry.push_back(kind);
+        WriteString(entry, fileName);
+        WriteVarint(entry, fileSize);
+        WriteSigned(entry, fileTime);
+        WriteVarint(entry, contentHash);
+        entry.insert(entry.end(), data.begin(), data.end());
+
+        if (WriteEntry(entryName, entry))
+            s_writes.fetch_add(1);
+        else
+            s_errors.fetch_add(1);
+
+        return true;
+    }
+
+    bool ParseCache::ParseFile(const std::string &fileName, Sprite &sprite, ParseResult &result)
+    {
+        /// An entry has all the dirs.
+        if (!sprite.GetLoadFilter().IsEmpty())
+            return false;
+
+        return ParseCachedFile(fileName, sprite, CACHE_KIND_SPRITE, result);
+    }
+
+    bool ParseCache::ParseFile(const std::string &fileName, Animations &animations, ParseResult &result)
+    {
+        return ParseCachedFile(fileName, animations, CACHE_KIND_ANIMATIONS, result);
+    }
+
+} //namespace dfp
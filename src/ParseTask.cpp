@@ -0,0 +1,468 @@
+#include "DarkFunctionParser/ParseTask.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Trace.h"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+namespace dfp
+{
+    /// The number of bytes read by one unit of work.
+    static const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+    ParseTask::ParseTask()
+        : m_phase(PHASE_IDLE)
+        , m_result(ParseResult::OK)
+        , m_errorText("")
+        , m_file(nullptr)
+        , m_read(0)
+        , m_doc(nullptr)
+        , m_nodeCount(0)
+        , m_nodeDone(0)
+    {}
+
+    ParseTask::~ParseTask()
+    {
+        Release();
+    }
+
+    void ParseTask::Release()
+    {
+        if (m_file)
+        {
+#ifdef USE_SDL2_LOAD
+            SDL_RWops *file = (SDL_RWops *)m_file;
+            file->close(file);
+#else
+            fclose((FILE *)m_file);
+#endif
+            m_file = nullptr;
+        }
+
+        std::vector<char>().swap(m_text);
+
+        delete m_doc;
+        m_doc = nullptr;
+    }
+
+    ParseTask::Status ParseTask::Fail(ParseResult result, const std::string &errorText)
+    {
+        Release();
+
+        m_phase = PHASE_DONE;
+        m_result = result;
+        m_errorText = errorText;
+
+        return STATUS_FAILED;
+    }
+
+    ParseResult ParseTask::Start(const std::string &fileName)
+    {
+        Release();
+
+        m_phase = PHASE_IDLE;
+        m_result = ParseResult::OK;
+        m_errorText = "";
+        m_read = 0;
+        m_nodeCount = 0;
+        m_nodeDone = 0;
+
+        SetFilePath(fileName);
+
+        long fileSize;
+
+        // Open the file for reading.
+#ifdef USE_SDL2_LOAD
+        SDL_RWops * file = SDL_RWFromFile(fileName.c_str(), "rb");
+#else
+        FILE *file = fopen(fileName.c_str(), "rb");
+#endif
+
+        // Check if the file could not be opened.
+        if (!file)
+        {
+            Fail(ParseResult::ERROR_COULDNT_OPEN, "Cannot open the file " + fileName);
+            return m_result;
+        }
+
+        m_file = file;
+
+        // Find out the file size.
+#ifdef USE_SDL2_LOAD
+        fileSize = (long)file->size(file);
+#else
+        fseek(file, 0, SEEK_END);
+        fileSize = ftell(file);
+        fseek(file, 0, SEEK_SET);
+#endif
+
+        // Check if the file size is valid.
+        if (fileSize <= 0)
+        {
+            Fail(ParseResult::ERROR_INVALID_FILE_SIZE, "Invalid size for " + fileName);
+            return m_result;
+        }
+
+        m_text.resize((size_t)fileSize);
+        m_phase = PHASE_READ;
+
+        return ParseResult::OK;
+    }
+
+    ParseResult ParseTask::StartText(const std::string &text)
+    {
+        Release();
+
+        m_result = ParseResult::OK;
+        m_errorText = "";
+        m_nodeCount = 0;
+        m_nodeDone = 0;
+
+        m_text.assign(text.begin(), text.end());
+        m_read = m_text.size();
+        m_phase = PHASE_PARSE;
+
+        return ParseResult::OK;
+    }
+
+    ParseTask::Status ParseTask::Step(uint32_t budgetMicroseconds)
+    {
+        DFP_TRACE_SCOPE("ParseTask::Step");
+
+        if (m_phase == PHASE_IDLE)
+            return Fail(ParseResult::ERROR_COULDNT_OPEN, "Start was not called!");
+
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::microseconds(budgetMicroseconds);
+
+        bool first = true;
+        while (m_phase != PHASE_DONE)
+        {
+            if (!first && std::chrono::steady_clock::now() >= deadline)
+                break;
+            first = false;
+
+            if (m_phase == PHASE_READ)
+            {
+                size_t size = m_text.size() - m_read;
+                if (size > READ_CHUNK_SIZE)
+                    size = READ_CHUNK_SIZE;
+
+#ifdef USE_SDL2_LOAD
+                SDL_RWops *file = (SDL_RWops *)m_file;
+                size_t readSize = file->read(file, &m_text[m_read], 1, size);
+#else
+                size_t readSize = fread(&m_text[m_read], 1, size, (FILE *)m_file);
+#endif
+                if (readSize == 0)
+                    return Fail(ParseResult::ERROR_INVALID_FILE_SIZE, "Cannot read the file!");
+
+                m_read += readSize;
+                if (m_read == m_text.size())
+                {
+#ifdef USE_SDL2_LOAD
+                    file->close(file);
+#else
+                    fclose((FILE *)m_file);
+#endif
+                    m_file = nullptr;
+                    m_phase = PHASE_PARSE;
+                }
+            }
+            else if (m_phase == PHASE_PARSE)
+            {
+                /// The backends can not parse in steps, this is done in one go.
+                m_doc = GetXmlBackend()->CreateDocument();
+                m_doc->Parse(m_text.data(), m_read);
+
+                /// The document does not use the text any more.
+                std::vector<char>().swap(m_text);
+
+                ParseResult result = BeginBuild(*m_doc, m_nodeCount);
+                if (result != ParseResult::OK)
+                    return Fail(result, GetDocumentErrorText());
+
+                m_phase = PHASE_BUILD;
+            }
+            else if (m_phase == PHASE_BUILD)
+            {
+                bool finished = false;
+                ParseResult result = BuildStep(finished);
+                if (result != ParseResult::OK)
+                    return Fail(result, GetDocumentErrorText());
+
+                m_nodeDone++;
+
+                if (finished)
+                {
+                    Release();
+                    m_phase = PHASE_DONE;
+                    m_result = ParseResult::OK;
+                }
+            }
+        }
+
+        return GetStatus();
+    }
+
+    ParseTask::Status ParseTask::GetStatus() const
+    {
+        if (m_phase != PHASE_DONE)
+            return STATUS_IN_PROGRESS;
+
+        return (m_result == ParseResult::OK) ? STATUS_DONE : STATUS_FAILED;
+    }
+
+    float ParseTask::GetProgress() const
+    {
+        switch (m_phase)
+        {
+        case PHASE_READ:
+            return m_text.empty() ? 0.0f : 0.25f * (float)m_read / (float)m_text.size();
+        case PHASE_PARSE:
+            return 0.25f;
+        case PHASE_BUILD:
+            if (m_nodeDone >= m_nodeCount)
+                return 1.0f;
+            return 0.5f + 0.5f * (float)m_nodeDone / (float)m_nodeCount;
+        case PHASE_DONE:
+            return 1.0f;
+        default:
+            return 0.0f;
+        }
+    }
+
+    ParseResult ParseTask::GetResult() const
+    {
+        return m_result;
+    }
+
+    std::string ParseTask::GetErrorText() const
+    {
+        return m_errorText;
+    }
+
+
+
+
+    /// Count the <dir> and <spr> nodes of a tree.
+    static uint32_t CountSpriteNodes(XmlNode node)
+    {
+        uint32_t count = 0;
+        for (; node; node = node.NextSibling())
+        {
+            if (strcmp(node.Value(), "dir") == 0)
+                count += 1 + CountSpriteNodes(node.FirstChild());
+            else if (strcmp(node.Value(), "spr") == 0)
+                count++;
+        }
+        return count;
+    }
+
+    SpriteParseTask::SpriteParseTask(Sprite &sprite)
+        : m_sprite(sprite)
+        , m_rootIndex(0)
+    {}
+
+    void SpriteParseTask::SetFilePath(const std::string &fileName)
+    {
+        m_sprite.SetFilePath(fileName);
+    }
+
+    std::string SpriteParseTask::GetDocumentErrorText() const
+    {
+        return m_sprite.GetErrorText();
+    }
+
+    ParseResult SpriteParseTask::BeginBuild(const XmlDocument &doc, uint32_t &nodeCount)
+    {
+        m_rootNodes.clear();
+        m_rootIndex = 0;
+        m_stack.clear();
+        nodeCount = 0;
+
+        XmlNode node;
+        ParseResult result = m_sprite.ParseRoot(doc, node);
+        if (result != ParseResult::OK)
+            return result;
+
+        for (; node; node = node.NextSibling())
+        {
+            if (strcmp(node.Value(), "definitions") != 0)
+                continue;
+
+            for (XmlNode subnode = node.FirstChild(); subnode; subnode = subnode.NextSibling())
+            {
+                if (strcmp(subnode.Value(), "dir") == 0)
+                {
+                    m_rootNodes.push_back(subnode);
+                    nodeCount += 1 + CountSpriteNodes(subnode.FirstChild());
+                }
+            }
+        }
+
+        return ParseResult::OK;
+    }
+
+    ParseResult SpriteParseTask::BuildStep(bool &finished)
+    {
+        if (m_stack.empty())
+        {
+            if (m_rootIndex >= m_rootNodes.size())
+            {
+                ParseResult result = m_sprite.BuildIndex();
+                if (result != ParseResult::OK)
+                    return result;
+
+                m_sprite.ComputeMemoryUsage();
+                finished = true;
+                return ParseResult::OK;
+            }
+
+            XmlNode node = m_rootNodes[m_rootIndex++];
+
+            std::shared_ptr<Dir> dir = std::make_shared<Dir>();
+            ParseResult result = dir->ParseAttributes(node);
+            if (result != ParseResult::OK)
+                return FailDir(result, "dir", dir->GetErrorText());
+
+            /// A root skipped by the load filter is kept, without its childs.
+            LoadFilter::Decision decision = m_sprite.GetLoadFilter().CheckDir("/");
+
+            Frame frame;
+            frame.node = (decision == LoadFilter::DIR_SKIP) ? XmlNode() : node.FirstChild();
+            frame.dir = dir;
+            frame.path = "/";
+            frame.loadSpr = (decision == LoadFilter::DIR_LOAD);
+            m_stack.push_back(frame);
+
+            return ParseResult::OK;
+        }
+
+        XmlNode node = m_stack.back().node;
+        std::shared_ptr<Dir> parent = m_stack.back().dir;
+        const LoadFilter &filter = m_sprite.GetLoadFilter();
+
+        if (!node)
+        {
+            /// All the childs are done.
+            m_stack.pop_back();
+            if (m_stack.empty())
+                return m_sprite.SetRoot(parent);
+
+            return ParseResult::OK;
+        }
+
+        m_stack.back().node = node.NextSibling();
+
+        if (strcmp(node.Value(), "dir") == 0)
+        {
+            LoadFilter::Decision decision = LoadFilter::DIR_LOAD;
+            std::string path;
+            if (!filter.IsEmpty())
+            {
+                /// Check the name before creating the Dir, so a skipped dir costs nothing.
+                const char *name = node.Attribute("name");
+                path = m_stack.back().path + (name ? name : "") + "/";
+                decision = filter.CheckDir(path);
+                if (decision == LoadFilter::DIR_SKIP)
+                    return ParseResult::OK;
+            }
+
+            std::shared_ptr<Dir> dir = std::make_shared<Dir>();
+
+            ParseResult result = dir->ParseAttributes(node);
+            if (result != ParseResult::OK)
+                return FailDir(result, "dir", dir->GetErrorText());
+
+            parent->m_dir[dir->GetName()] = dir;
+
+            Frame frame;
+            frame.node = node.FirstChild();
+            frame.dir = dir;
+            frame.path = path;
+            frame.loadSpr = (decision == LoadFilter::DIR_LOAD);
+            m_stack.push_back(frame);
+        }
+        else if (strcmp(node.Value(), "spr") == 0 && m_stack.back().loadSpr)
+        {
+            std::shared_ptr<Spr> spr = std::make_shared<Spr>();
+
+            ParseResult result = spr->ParseXML(node);
+            if (result != ParseResult::OK)
+                return FailDir(result, "spr", spr->GetErrorText());
+
+            parent->m_spr[spr->GetName()] = spr;
+        }
+
+        return ParseResult::OK;
+    }
+
+    ParseResult SpriteParseTask::FailDir(ParseResult result, const char *nodeName, std::string errorText)
+    {
+        /// Like Dir::ParseXML, each open <dir> adds its name to the text.
+        std::string name = nodeName;
+        for (size_t i = m_stack.size(); i > 0; i--)
+        {
+            errorText = "Parsing <" + name + "> from <dir name='" + m_stack[i - 1].dir->GetName() + "'> Failed! >> " + errorText;
+            name = "dir";
+        }
+
+        m_sprite.m_errorText = "Parsing <dir> Failed! >> " + errorText;
+        return result;
+    }
+
+
+
+
+    AnimationsParseTask::AnimationsParseTask(Animations &animations)
+        : m_animations(animations)
+    {}
+
+    void AnimationsParseTask::SetFilePath(const std::string &fileName)
+    {
+        m_animations.SetFilePath(fileName);
+    }
+
+    std::string AnimationsParseTask::GetDocumentErrorText() const
+    {
+        return m_animations.GetErrorText();
+    }
+
+    ParseResult AnimationsParseTask::BeginBuild(const XmlDocument &doc, uint32_t &nodeCount)
+    {
+        m_node = XmlNode();
+        nodeCount = 0;
+
+        ParseResult result = m_animations.ParseRoot(doc, m_node);
+        if (result != ParseResult::OK)
+            return result;
+
+        for (XmlNode node = m_node; node; node = node.NextSibling())
+            nodeCount++;
+
+        return ParseResult::OK;
+    }
+
+    ParseResult AnimationsParseTask::BuildStep(bool &finished)
+    {
+        if (!m_node)
+        {
+            ParseResult result = m_animations.BuildIndex();
+            if (result != ParseResult::OK)
+                return result;
+
+            m_animations.ComputeMemoryUsage();
+            finished = true;
+            return ParseResult::OK;
+        }
+
+        XmlNode node = m_node;
+        m_node = m_node.NextSibling();
+
+        return m_animations.ParseChild(node);
+    }
+
+} //namespace dfp
@@ -0,0 +1,273 @@
+#include "DarkFunctionParser/Recorder.h"
+#include "DarkFunctionParser/Animations.h"
+#include "BinaryIO.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+namespace dfp
+{
+    /// The start of a recorded file, then the version.
+    static const char RECORD_MAGIC[4] = { 'D', 'F', 'P', 'R' };
+    static const uint8_t RECORD_VERSION = 1;
+
+    /// The state of the recording, all under s_mutex.
+    static std::mutex s_mutex;
+    static std::vector<uint8_t> s_data;
+    static std::map<std::string, uint32_t> s_animIds;
+    static uint32_t s_nextInstance = 1;
+    static bool s_hasLastUpdate = false;
+    static float s_lastDtSeconds = 0;
+    static float s_lastAnimSpeedFactor = 0;
+
+    /// The instances of an older recording have another session, they
+    /// are ignored. The session 0 is never used.
+    static std::atomic<uint32_t> s_session(0);
+    static std::atomic<bool> s_enabled(false);
+
+    /// Start a new file in s_data.
+    static void ResetData()
+    {
+        s_data.assign(RECORD_MAGIC, RECORD_MAGIC + sizeof(RECORD_MAGIC));
+        s_data.push_back(RECORD_VERSION);
+
+        s_animIds.clear();
+        s_nextInstance = 1;
+        s_hasLastUpdate = false;
+    }
+
+    bool Recorder::IsRecorded(const Anim &anim)
+    {
+        return s_enabled.load(std::memory_order_relaxed) && anim.m_recordId != 0
+            && anim.m_recordSession == s_session.load(std::memory_order_relaxed);
+    }
+
+    void Recorder::Start()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        ResetData();
+        s_session.fetch_add(1);
+        s_enabled.store(true);
+    }
+
+    void Recorder::Stop()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_enabled.store(false);
+    }
+
+    bool Recorder::IsEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    std::vector<uint8_t> Recorder::GetData()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_data.empty())
+            ResetData();
+
+        return s_data;
+    }
+
+    ParseResult Recorder::WriteFile(const std::string &fileName)
+    {
+        std::vector<uint8_t> data = GetData();
+
+        FILE *file = fopen(fileName.c_str(), "wb");
+        if (!file)
+            return ParseResult::ERROR_COULDNT_WRITE;
+
+        size_t written = fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+
+        if (written != data.size())
+            return ParseResult::ERROR_COULDNT_WRITE;
+
+        return ParseResult::OK;
+    }
+
+    ParseResult Recorder::Decode(const uint8_t *data, size_t size, std::vector<Event> &events)
+    {
+        events.clear();
+
+        if (size < sizeof(RECORD_MAGIC) + 1 || memcmp(data, RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0
+            || data[sizeof(RECORD_MAGIC)] != RECORD_VERSION)
+            return ParseResult::ERROR_PARSING_FAILED;
+
+        BinaryReader reader(data + sizeof(RECORD_MAGIC) + 1, size - sizeof(RECORD_MAGIC) - 1);
+
+        Event last;
+        last.dtSeconds = 0;
+        last.animSpeedFactor = 0;
+        while (!reader.IsEnd())
+        {
+            Event event;
+            event.type = (EventType)reader.ReadByte();
+            event.instance = 0;
+            event.anim = 0;
+            event.loops = 0;
+            event.dtSeconds = 0;
+            event.animSpeedFactor = 0;
+            event.cellIndex = 0;
+
+            switch (event.type)
+            {
+            case EVENT_ANIM:
+            {
+                event.anim = (uint32_t)reader.ReadVarint();
+                event.name = reader.ReadString();
+                event.loops = (int)reader.ReadSigned();
+
+                uint64_t count = reader.ReadCount();
+                for (uint64_t i = 0; i < count && !reader.Error(); i++)
+                    event.delays.push_back((int)reader.ReadSigned());
+                break;
+            }
+
+            case EVENT_SPAWN:
+                event.instance = (uint32_t)reader.ReadVarint();
+                event.anim = (uint32_t)reader.ReadVarint();
+                break;
+
+            case EVENT_UPDATE:
+                event.instance = (uint32_t)reader.ReadVarint();
+                event.dtSeconds = reader.ReadFloat();
+                event.animSpeedFactor = reader.ReadFloat();
+                last = event;
+                break;
+
+            case EVENT_UPDATE_REPEAT:
+                event.instance = (uint32_t)reader.ReadVarint();
+                event.dtSeconds = last.dtSeconds;
+                event.animSpeedFactor = last.animSpeedFactor;
+                break;
+
+            case EVENT_CELL:
+                event.instance = (uint32_t)reader.ReadVarint();
+                event.cellIndex = (uint32_t)reader.ReadVarint();
+                break;
+
+            case EVENT_RELEASE:
+                event.instance = (uint32_t)reader.ReadVarint();
+                break;
+
+            default:
+                return ParseResult::ERROR_PARSING_FAILED;
+            }
+
+            if (reader.Error())
+                return ParseResult::ERROR_PARSING_FAILED;
+
+            events.push_back(event);
+        }
+
+        return ParseResult::OK;
+    }
+
+    void Recorder::OnSpawn(Anim &anim)
+    {
+        if (!IsEnabled())
+            return;
+
+        /// The same timing is written once, even if it comes from many
+        /// documents.
+        std::string key = anim.GetName();
+        key += '\0';
+        key += std::to_string(anim.GetLoops());
+        const std::vector< std::shared_ptr<Cell> > &cells = anim.GetCells();
+        for (size_t i = 0; i < cells.size(); i++)
+        {
+            key += ',';
+            key += std::to_string((int)cells[i]->GetDelay());
+        }
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!s_enabled.load(std::memory_order_relaxed))
+            return;
+
+        uint32_t animId;
+        std::map<std::string, uint32_t>::const_iterator it = s_animIds.find(key);
+        if (it != s_animIds.end())
+            animId = it->second;
+        else
+        {
+            animId = (uint32_t)s_animIds.size() + 1;
+            s_animIds[key] = animId;
+
+            s_data.push_back(EVENT_ANIM);
+            WriteVarint(s_data, animId);
+            WriteString(s_data, anim.GetName());
+            WriteSigned(s_data, anim.GetLoops());
+            WriteVarint(s_data, cells.size());
+            for (size_t i = 0; i < cells.size(); i++)
+                WriteSigned(s_data, (int)cells[i]->GetDelay());
+        }
+
+        anim.m_recordSession = s_session.load(std::memory_order_relaxed);
+        anim.m_recordId = s_nextInstance++;
+
+        s_data.push_back(EVENT_SPAWN);
+        WriteVarint(s_data, anim.m_recordId);
+        WriteVarint(s_data, animId);
+    }
+
+    void Recorder::OnUpdate(const Anim &anim, float dtSeconds, float animSpeedFactor)
+    {
+        if (!anim.m_recordId || !IsEnabled())
+            return;
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!IsRecorded(anim))
+            return;
+
+        /// Most of the updates of a frame have the same values.
+        if (s_hasLastUpdate && memcmp(&dtSeconds, &s_lastDtSeconds, sizeof(float)) == 0
+            && memcmp(&animSpeedFactor, &s_lastAnimSpeedFactor, sizeof(float)) == 0)
+        {
+            s_data.push_back(EVENT_UPDATE_REPEAT);
+            WriteVarint(s_data, anim.m_recordId);
+            return;
+        }
+
+        s_data.push_back(EVENT_UPDATE);
+        WriteVarint(s_data, anim.m_recordId);
+        WriteFloat(s_data, dtSeconds);
+        WriteFloat(s_data, animSpeedFactor);
+
+        s_hasLastUpdate = true;
+        s_lastDtSeconds = dtSeconds;
+        s_lastAnimSpeedFactor = animSpeedFactor;
+    }
+
+    void Recorder::OnCell(const Anim &anim, uint32_t cellIndex)
+    {
+        if (!anim.m_recordId || !IsEnabled())
+            return;
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!IsRecorded(anim))
+            return;
+
+        s_data.push_back(EVENT_CELL);
+        WriteVarint(s_data, anim.m_recordId);
+        WriteVarint(s_data, cellIndex);
+    }
+
+    void Recorder::OnRelease(const Anim &anim)
+    {
+        if (!anim.m_recordId || !IsEnabled())
+            return;
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!IsRecorded(anim))
+            return;
+
+        s_data.push_back(EVENT_RELEASE);
+        WriteVarint(s_data, anim.m_recordId);
+    }
+
+} //namespace dfp
@@ -1,16 +1,76 @@
 #include "DarkFunctionParser/Sprite.h"
-
-#if defined(I3D_PLATFORM_S3E)
-#include "tinyxml.h"
-#else
-#include <tinyxml2/tinyxml2.h>
-#endif
+#include "DarkFunctionParser/Trace.h"
+#include "DarkFunctionParser/ParseCache.h"
+#include "DarkFunctionParser/Metrics.h"
+#include "DarkFunctionParser/XmlReader.h"
 
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 namespace dfp
 {
+    LoadFilter::LoadFilter()
+    {}
+
+    void LoadFilter::AddPrefix(const std::string &dirPath)
+    {
+        std::string prefix = dirPath;
+        if (prefix.empty() || prefix[0] != '/')
+            prefix = "/" + prefix;
+        if (*prefix.rbegin() != '/')
+            prefix += "/";
+
+        m_prefix.push_back(prefix);
+    }
+
+    void LoadFilter::SetPredicate(const std::function<bool(const std::string &dirPath)> &predicate)
+    {
+        m_predicate = predicate;
+    }
+
+    bool LoadFilter::IsEmpty() const
+    {
+        return m_prefix.empty() && !m_predicate;
+    }
+
+    LoadFilter::Decision LoadFilter::CheckDir(const std::string &dirPath) const
+    {
+        Decision decision = DIR_LOAD;
+
+        if (!m_prefix.empty())
+        {
+            decision = DIR_SKIP;
+            for (size_t i = 0; i < m_prefix.size(); i++)
+            {
+                const std::string &prefix = m_prefix[i];
+
+                /// The dir is inside a selected dir.
+                if (dirPath.compare(0, prefix.size(), prefix) == 0)
+                {
+                    decision = DIR_LOAD;
+                    break;
+                }
+
+                /// A selected dir is inside this dir.
+                if (prefix.compare(0, dirPath.size(), dirPath) == 0)
+                    decision = DIR_PATH_ONLY;
+            }
+
+            if (decision == DIR_SKIP)
+                return DIR_SKIP;
+        }
+
+        if (m_predicate && !m_predicate(dirPath))
+            return DIR_SKIP;
+
+        return decision;
+    }
+
+
+
+
     Sprite::Sprite() 
         : m_errorText("")
         , m_imagePath("")
@@ -21,14 +81,16 @@ namespace dfp
 
 
 
-    std::string Sprite::GetImageFileName(bool onlyFileName)
+    std::string Sprite::GetImageFileName(bool onlyFileName) const
     { 
         if (onlyFileName)
             return m_imageFileName;
 
-        std::string imagePathFileName = "";
-        if (!m_imagePath.empty())
-            imagePathFileName = m_imagePath;
+        /// The *.sprites file was loaded from the current directory.
+        if (m_imagePath.empty())
+            return m_imageFileName;
+
+        std::string imagePathFileName = m_imagePath;
         if (*m_imagePath.rbegin() != '/')
             imagePathFileName += "/";
 
@@ -37,19 +99,34 @@ namespace dfp
         return imagePathFileName;
     }
 
-    std::string Sprite::GetErrorText(){ return m_errorText; }
+    unsigned int Sprite::GetImageW() const { return m_imageW; }
 
-    ParseResult Sprite::ParseFile(const std::string &fileName)
-    {
-        ParseResult errorsCode = ParseResult::OK;
+    unsigned int Sprite::GetImageH() const { return m_imageH; }
+
+    std::string Sprite::GetErrorText() const { return m_errorText; }
 
+    void Sprite::SetFilePath(const std::string &fileName)
+    {
         int lastSlash = fileName.find_last_of("/");
 
         // Get the directory of the file using substring.
         if (lastSlash > 0)
-        {
             m_imagePath = fileName.substr(0, lastSlash + 1);
-        }
+        else
+            m_imagePath = "";
+    }
+
+    ParseResult Sprite::ParseFile(const std::string &fileName)
+    {
+        DFP_TRACE_SCOPE_FILE("Sprite::ParseFile", fileName);
+
+        ParseResult cachedResult;
+        if (ParseCache::ParseFile(fileName, *this, cachedResult))
+            return cachedResult;
+
+        ParseResult errorsCode = ParseResult::OK;
+
+        SetFilePath(fileName);
 
         char* fileText;
         int fileSize;
@@ -87,57 +164,153 @@ namespace dfp
         // Allocate memory for the file and read it into the memory.
         fileText = new char[fileSize + 1];
         fileText[fileSize] = 0;
+        {
+            DFP_TRACE_SCOPE_FILE("ReadFile", fileName);
 #ifdef USE_SDL2_LOAD
-        file->read(file, fileText, 1, fileSize);
+            file->read(file, fileText, 1, fileSize);
 #else
-        fread(fileText, 1, fileSize, file);
+            fread(fileText, 1, fileSize, file);
 #endif
 
 #ifdef USE_SDL2_LOAD
-        file->close(file);
+            file->close(file);
 #else
-        fclose(file);
+            fclose(file);
 #endif
+        }
 
-        // Copy the contents into a C++ string and delete it from memory.
-        std::string text(fileText, fileText + fileSize);
+        ParseResult result = ParseText(fileText, fileSize);
         delete[] fileText;
 
-        return ParseText(text);
+        return result;
+    }
+
+    ParseResult Sprite::ParseBuffer(const char *data, size_t size, const std::string &fileName)
+    {
+        SetFilePath(fileName);
+
+        return ParseText(data, size);
     }
 
     ParseResult Sprite::ParseText(const std::string &text)
     {
-        // Create a tiny xml document and use it to parse the text.
-		tinyxml2::XMLDocument doc;
-        doc.Parse(text.c_str());
+        return ParseText(text.c_str(), text.size());
+    }
+
+    ParseResult Sprite::ParseText(const char *text, size_t size)
+    {
+        DFP_TRACE_SCOPE("Sprite::ParseText");
+
+        // Create an xml document of the selected backend and use it to parse the text.
+        std::unique_ptr<XmlDocument> doc(GetXmlBackend()->CreateDocument());
+        {
+            DFP_TRACE_SCOPE("XmlDocument::Parse");
+            doc->Parse(text, size);
+        }
+
+        XmlNode node;
+        ParseResult result = ParseRoot(*doc, node);
+        if (result != ParseResult::OK)
+            return result;
+
+        while (node)
+        {
+            // Read the map properties.
+            if (strcmp(node.Value(), "definitions") == 0)
+            {
+                XmlNode subnode = node.FirstChild();
+                while (subnode)
+                {
+                    if (strcmp(subnode.Value(), "dir") == 0)
+                    {
+                        std::shared_ptr<Dir> dir = std::make_shared<Dir>();
 
+                        if (m_loadFilter.IsEmpty())
+                            result = dir->ParseXML(subnode);
+                        else
+                        {
+                            /// A skipped root is kept, empty, like a skipped dir has no childs.
+                            LoadFilter::Decision decision = m_loadFilter.CheckDir("/");
+                            if (decision == LoadFilter::DIR_SKIP)
+                                result = dir->ParseAttributes(subnode);
+                            else
+                                result = dir->ParseXML(subnode, &m_loadFilter, "/", decision == LoadFilter::DIR_LOAD);
+                        }
+                        if (result == ParseResult::OK)
+                        {
+                            result = SetRoot(dir);
+                            if (result != ParseResult::OK)
+                                return result;
+                        }
+                        else
+                        {
+                            m_errorText = "Parsing <dir> Failed! >> " + dir->GetErrorText();
+                            return result;
+                        }
+                    }
+
+                    subnode = subnode.NextSibling();
+                }
+
+            }
+            
+            node = node.NextSibling();
+        }
+
+        result = BuildIndex();
+        if (result != ParseResult::OK)
+            return result;
+
+        ComputeMemoryUsage();
+
+        return ParseResult::OK;
+    }
+
+    ParseResult Sprite::ParseRoot(const XmlDocument &doc, XmlNode &firstChild)
+    {
         // Check for parsing errors.
         if (doc.Error())
         {            
-            m_errorText = doc.GetErrorStr1();
-			m_errorText += doc.GetErrorStr2();
+            m_errorText = doc.GetErrorText();
             return ParseResult::ERROR_PARSING_FAILED;
         }
 
-		tinyxml2::XMLNode *imgNode = doc.FirstChildElement("img");
-        if (!imgNode)
+		XmlNode imgElem = doc.GetRoot();
+        while (imgElem && strcmp(imgElem.Value(), "img") != 0)
+            imgElem = imgElem.NextSibling();
+        if (!imgElem)
         {
             m_errorText = "Cannot find node <img> !";
             return ParseResult::ERROR_MISSING_NODE;
         }
 
-		tinyxml2::XMLElement* imgElem = imgNode->ToElement();
+        ParseResult result = ParseRootAttributes(imgElem);
+        if (result != ParseResult::OK)
+            return result;
+
+        firstChild = imgElem.FirstChild();
+
+        if (!firstChild)
+        {
+            m_errorText = "The <img> node does not have child nodes!";
+            return ParseResult::ERROR_IMAGE_PATHNAME_WRONG;
+        }
 
+        return ParseResult::OK;
+    }
+
+    ParseResult Sprite::ParseRootAttributes(const XmlNode &imgElem)
+    {
         // Read the map attributes.
-        m_imageFileName = imgElem->Attribute("name");
+        const char *name = imgElem.Attribute("name");
+        m_imageFileName = name ? name : "";
         if (m_imageFileName.empty())
         {
             m_errorText = "Cannot find attribute 'name' or the value is empty!";
             return ParseResult::ERROR_IMAGE_PATHNAME_WRONG;
         }
 
-		const char* tempValue = imgElem->Attribute("w");
+		const char* tempValue = imgElem.Attribute("w");
         if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'w' or the value is not numeric!";
@@ -145,7 +318,7 @@ namespace dfp
         }
 		m_imageW = std::stoi(tempValue);
 
-		tempValue = imgElem->Attribute("h");
+		tempValue = imgElem.Attribute("h");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'h' or the value is not numeric!";
@@ -153,79 +326,140 @@ namespace dfp
         }
 		m_imageH = std::stoi(tempValue);
 
-        const tinyxml2::XMLNode *node = imgElem->FirstChild();
+        return ParseResult::OK;
+    }
 
-        if (!node)
+    ParseResult Sprite::SetRoot(std::shared_ptr<Dir> dir)
+    {
+        m_root = dir;
+        if (m_root->GetName().compare("/") != 0)
         {
-            m_errorText = "The <img> node does not have child nodes!";
-            return ParseResult::ERROR_IMAGE_PATHNAME_WRONG;
+            m_errorText = "The root <dir> is missing!";
+            return ParseResult::ERROR_ROOT_MISSING;
         }
 
-        while (node)
+        return ParseResult::OK;
+    }
+
+    ParseResult Sprite::BuildIndex()
+    {
+        m_sprById.clear();
+        m_sprIndex.Clear();
+        m_idCollisions.clear();
+
+        std::vector< std::pair<std::string, std::shared_ptr<Spr> > > sprs = GetAllSprWithPath();
+
+        /// A collision does not fail the parse: the id is removed, so it
+        /// does not find one of the 2 sprites by chance, and the paths are
+        /// reported. They are still found by path.
+        std::vector<uint32_t> collided;
+        m_sprById.reserve(sprs.size());
+        for (size_t i = 0; i < sprs.size(); i++)
         {
-            // Read the map properties.
-            if (strcmp(node->Value(), "definitions") == 0)
+            uint32_t hash = SprId(sprs[i].first).hash;
+            uint32_t other = m_sprIndex.Find(hash);
+            if (other != HashIndex::INVALID_INDEX)
             {
-                const tinyxml2::XMLNode *subnode = node->FirstChild();
-                while (subnode)
+                if (std::find(collided.begin(), collided.end(), hash) == collided.end())
                 {
-                    if (strcmp(subnode->Value(), "dir") == 0)
-                    {
-                        std::shared_ptr<Dir> dir = std::make_shared<Dir>();
-
-                        ParseResult result = dir->ParseXML(subnode);
-                        if (result == ParseResult::OK)
-                        {
-                            m_root = dir;
-                            if (m_root->GetName().compare("/") != 0)
-                            {
-                                m_errorText = "The root <dir> is missing!";
-                                return ParseResult::ERROR_ROOT_MISSING;
-                            }
-                        }
-                        else
-                        {
-                            m_errorText = "Parsing <dir> Failed! >> " + dir->GetErrorText();
-                            return result;
-                        }
-                    }
-
-                    subnode = subnode->NextSibling();
+                    collided.push_back(hash);
+                    m_idCollisions.push_back(sprs[other].first);
                 }
-
+                m_idCollisions.push_back(sprs[i].first);
             }
-            
-            node = node->NextSibling();
+            else
+                m_sprIndex.Insert(hash, (uint32_t)i);
+
+            m_sprById.push_back(sprs[i].second);
         }
 
+        for (size_t i = 0; i < collided.size(); i++)
+            m_sprIndex.Erase(collided[i]);
+
         return ParseResult::OK;
     }
 
-    std::shared_ptr<Spr> Sprite::GetSpr(const std::string& xmlPath)
+    void Sprite::ComputeMemoryUsage()
     {
-        if (xmlPath.empty())
-            return nullptr;
+        MemoryUsage usage;
 
-        if (xmlPath.at(0) != '/')
-            return nullptr;
+        usage.AddObject(MemoryUsage::NODE_DOCUMENT, sizeof(Sprite));
+        usage.AddString(MemoryUsage::NODE_DOCUMENT, m_errorText);
+        usage.AddString(MemoryUsage::NODE_DOCUMENT, m_imagePath);
+        usage.AddString(MemoryUsage::NODE_DOCUMENT, m_imageFileName);
 
         if (m_root)
-            return m_root->GetSpr(xmlPath.substr(1));
-        
-        return nullptr;
+            m_root->AddMemoryUsage(usage);
+
+        usage.AddVectorBuffer(MemoryUsage::NODE_DOCUMENT, m_sprById.capacity(), sizeof(std::shared_ptr<Spr>));
+        usage.AddVectorBuffer(MemoryUsage::NODE_DOCUMENT, m_sprIndex.GetMemoryBytes(), 1);
+
+        m_memoryUsage = usage;
+    }
+
+    MemoryUsage Sprite::GetMemoryUsage() const
+    {
+        return m_memoryUsage;
+    }
+
+    void Sprite::SetLoadFilter(const LoadFilter& filter)
+    {
+        m_loadFilter = filter;
+    }
+
+    const LoadFilter& Sprite::GetLoadFilter() const
+    {
+        return m_loadFilter;
+    }
+
+    std::shared_ptr<Spr> Sprite::GetSpr(const std::string& xmlPath) const
+    {
+        DFP_METRICS_ADD(Metrics::COUNTER_SPR_LOOKUPS, 1);
+
+        std::shared_ptr<Spr> spr;
+        if (!xmlPath.empty() && xmlPath.at(0) == '/' && m_root)
+            spr = m_root->GetSpr(xmlPath.substr(1));
+
+        if (!spr)
+            DFP_METRICS_ADD(Metrics::COUNTER_SPR_LOOKUP_MISSES, 1);
+
+        return spr;
+    }
+
+    std::shared_ptr<Spr> Sprite::GetSpr(SprId id) const
+    {
+        DFP_METRICS_ADD(Metrics::COUNTER_SPR_LOOKUPS, 1);
+
+        uint32_t index = m_sprIndex.Find(id.hash);
+
+        if (index == HashIndex::INVALID_INDEX)
+        {
+            DFP_METRICS_ADD(Metrics::COUNTER_SPR_LOOKUP_MISSES, 1);
+            return nullptr;
+        }
+
+        return m_sprById[index];
+    }
+
+    const std::vector<std::string>& Sprite::GetIdCollisions() const
+    {
+        return m_idCollisions;
     }
 
-	std::vector<std::shared_ptr<Spr> > Sprite::GetAllSpr()
+	std::vector<std::shared_ptr<Spr> > Sprite::GetAllSpr() const
 	{
 		std::vector<std::shared_ptr<Spr> > results;
 
+		if (!m_root)
+			return results;
+
 		std::vector<std::shared_ptr<Spr> > r = GetAllSpr(m_root);
 		for (auto s : r)
 		{
 			results.push_back(s);
 		}
 
-		for (auto sitem : m_root->m_spr)
+		for (const auto& sitem : m_root->m_spr)
 		{
 			std::shared_ptr<Spr> s = sitem.second;
 			results.push_back(s);
@@ -237,7 +471,7 @@ namespace dfp
 	std::vector<std::shared_ptr<Spr> > Sprite::GetAllSpr(std::shared_ptr<Dir> dir)
 	{
 		std::vector<std::shared_ptr<Spr> > results;
-		for (auto ditem : dir->m_dir)
+		for (const auto& ditem : dir->m_dir)
 		{
 			std::shared_ptr<Dir> d = ditem.second;
 
@@ -247,7 +481,7 @@ namespace dfp
 				results.push_back(s);
 			}
 
-			for (auto sitem : d->m_spr)
+			for (const auto& sitem : d->m_spr)
 			{
 				std::shared_ptr<Spr> s = sitem.second;
 				results.push_back(s);
@@ -256,6 +490,26 @@ namespace dfp
 
 		return results;
 	}
+
+	std::vector< std::pair<std::string, std::shared_ptr<Spr> > > Sprite::GetAllSprWithPath() const
+	{
+		std::vector< std::pair<std::string, std::shared_ptr<Spr> > > results;
+
+		if (m_root)
+			GetAllSprWithPath(m_root, "/", results);
+
+		return results;
+	}
+
+	void Sprite::GetAllSprWithPath(const std::shared_ptr<Dir>& dir, const std::string& path,
+		std::vector< std::pair<std::string, std::shared_ptr<Spr> > >& results)
+	{
+		for (const auto& sitem : dir->m_spr)
+			results.push_back(std::make_pair(path + sitem.first, sitem.second));
+
+		for (const auto& ditem : dir->m_dir)
+			GetAllSprWithPath(ditem.second, path + ditem.first + "/", results);
+	}
     
 
 
@@ -265,30 +519,38 @@ namespace dfp
         , m_x(x), m_y(y), m_w(w), m_h(h)
     {}
 
-    std::string Spr::GetName(){ return m_name; }
+    std::string Spr::GetName() const { return m_name; }
 
-    unsigned int Spr::GetX(){ return m_x; }
+    unsigned int Spr::GetX() const { return m_x; }
 
-    unsigned int Spr::GetY(){ return m_y; }
+    unsigned int Spr::GetY() const { return m_y; }
 
-    unsigned int Spr::GetW(){ return m_w; }
+    unsigned int Spr::GetW() const { return m_w; }
 
-    unsigned int Spr::GetH(){ return m_h; }
+    unsigned int Spr::GetH() const { return m_h; }
 
-    std::string Spr::GetErrorText(){ return m_errorText; }
+    std::string Spr::GetErrorText() const { return m_errorText; }
 
-    ParseResult Spr::ParseXML(const tinyxml2::XMLNode *dataNode)
+    void Spr::AddMemoryUsage(MemoryUsage& usage) const
     {
-        const tinyxml2::XMLElement* nodeElm = dataNode->ToElement();
+        usage.AddSharedObject(MemoryUsage::NODE_SPR, sizeof(Spr));
+        usage.AddString(MemoryUsage::NODE_SPR, m_errorText);
+        usage.AddString(MemoryUsage::NODE_SPR, m_name);
+    }
 
-        m_name = nodeElm->Attribute("name");
+    ParseResult Spr::ParseXML(const XmlNode &dataNode)
+    {
+        DFP_TRACE_SCOPE("Spr::ParseXML");
+
+        const char *name = dataNode.Attribute("name");
+        m_name = name ? name : "";
         if (m_name.empty())
         {
             m_errorText = "Cannot find attribute 'name' or the value is empty!";
             return ParseResult::ERROR_NAME_WRONG;
         }
 
-		const char* tempValue = nodeElm->Attribute("x");
+		const char* tempValue = dataNode.Attribute("x");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'x' or the value is not numeric!";
@@ -296,7 +558,7 @@ namespace dfp
         }
 		m_x = std::stoi(tempValue);
 
-		tempValue = nodeElm->Attribute("y");
+		tempValue = dataNode.Attribute("y");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'y' or the value is not numeric!";
@@ -304,7 +566,7 @@ namespace dfp
         }
 		m_y = std::stoi(tempValue);
 
-		tempValue = nodeElm->Attribute("w");
+		tempValue = dataNode.Attribute("w");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'w' or the value is not numeric!";
@@ -312,7 +574,7 @@ namespace dfp
         }
 		m_w = std::stoi(tempValue);
 
-		tempValue = nodeElm->Attribute("h");
+		tempValue = dataNode.Attribute("h");
 		if (!tempValue)
         {
             m_errorText = "Cannot find attribute 'h' or the value is not numeric!";
@@ -330,29 +592,80 @@ namespace dfp
     Dir::Dir() : m_errorText(""), m_name("")
     {}
 
-    std::string Dir::GetName(){ return m_name; }
+    std::string Dir::GetName() const { return m_name; }
 
-    std::string Dir::GetErrorText(){ return m_errorText; }
+    std::string Dir::GetErrorText() const { return m_errorText; }
 
-    ParseResult Dir::ParseXML(const tinyxml2::XMLNode *dataNode)
+    void Dir::AddMemoryUsage(MemoryUsage& usage) const
     {
-        const tinyxml2::XMLElement* nodeElm = dataNode->ToElement();
+        usage.AddSharedObject(MemoryUsage::NODE_DIR, sizeof(Dir));
+        usage.AddString(MemoryUsage::NODE_DIR, m_errorText);
+        usage.AddString(MemoryUsage::NODE_DIR, m_name);
 
-        m_name = nodeElm->Attribute("name");
+        usage.AddMapNodes(MemoryUsage::NODE_DIR, m_dir.size(), sizeof(std::map< std::string, std::shared_ptr<Dir> >::value_type));
+        for (const auto& ditem : m_dir)
+        {
+            usage.AddString(MemoryUsage::NODE_DIR, ditem.first);
+            ditem.second->AddMemoryUsage(usage);
+        }
+
+        usage.AddMapNodes(MemoryUsage::NODE_DIR, m_spr.size(), sizeof(std::map< std::string, std::shared_ptr<Spr> >::value_type));
+        for (const auto& sitem : m_spr)
+        {
+            usage.AddString(MemoryUsage::NODE_DIR, sitem.first);
+            sitem.second->AddMemoryUsage(usage);
+        }
+    }
+
+    ParseResult Dir::ParseAttributes(const XmlNode &dataNode)
+    {
+        const char *name = dataNode.Attribute("name");
+        m_name = name ? name : "";
         if (m_name.empty())
         {
             m_errorText = "Cannot find attribute 'name' or the value is empty!";
             return ParseResult::ERROR_NAME_WRONG;
         }
 
-        const tinyxml2::XMLNode *node = dataNode->FirstChild();
+        return ParseResult::OK;
+    }
+
+    ParseResult Dir::ParseXML(const XmlNode &dataNode)
+    {
+        return ParseXML(dataNode, nullptr, "", true);
+    }
+
+    ParseResult Dir::ParseXML(const XmlNode &dataNode, const LoadFilter *filter, const std::string &path, bool loadSpr)
+    {
+        DFP_TRACE_SCOPE("Dir::ParseXML");
+
+        ParseResult result = ParseAttributes(dataNode);
+        if (result != ParseResult::OK)
+            return result;
+
+        XmlNode node = dataNode.FirstChild();
         while (node)
         {
-            if (strcmp(node->Value(), "dir") == 0)
+            if (strcmp(node.Value(), "dir") == 0)
             {
+                std::string childPath;
+                LoadFilter::Decision decision = LoadFilter::DIR_LOAD;
+                if (filter)
+                {
+                    /// Check the name before creating the Dir, so a skipped dir costs nothing.
+                    const char *name = node.Attribute("name");
+                    childPath = path + (name ? name : "") + "/";
+                    decision = filter->CheckDir(childPath);
+                    if (decision == LoadFilter::DIR_SKIP)
+                    {
+                        node = node.NextSibling();
+                        continue;
+                    }
+                }
+
                 std::shared_ptr<Dir> dir = std::make_shared<Dir>();
 
-                ParseResult result = dir->ParseXML(node);
+                ParseResult result = dir->ParseXML(node, filter, childPath, decision == LoadFilter::DIR_LOAD);
                 if (result == ParseResult::OK)
                     this->m_dir[dir->GetName()] = dir;
                 else
@@ -361,7 +674,7 @@ namespace dfp
                     return result;
                 }
             }
-            else if (strcmp(node->Value(), "spr") == 0)
+            else if (strcmp(node.Value(), "spr") == 0 && loadSpr)
             {
                 std::shared_ptr<Spr> spr = std::make_shared<Spr>();
 
@@ -375,13 +688,13 @@ namespace dfp
                 }
             }
 
-            node = node->NextSibling();
+            node = node.NextSibling();
         }
 
         return ParseResult::OK;
     }
 
-    std::shared_ptr<Spr> Dir::GetSpr(const std::string& xmlPath)
+    std::shared_ptr<Spr> Dir::GetSpr(const std::string& xmlPath) const
     {
         if (xmlPath.empty())
             return nullptr;
@@ -390,8 +703,13 @@ namespace dfp
 
         if (pos == std::string::npos)
         {
-            /// This must be the end of the path, so must be a sprite
-            return m_spr[xmlPath];
+            /// This must be the end of the path, so must be a sprite.
+            /// Use find, operator[] will insert an empty entry on a miss.
+            auto sprIt = m_spr.find(xmlPath);
+            if (sprIt == m_spr.end())
+                return nullptr;
+
+            return sprIt->second;
         }
 
         std::string dirName = xmlPath.substr(0, pos);
@@ -404,7 +722,7 @@ namespace dfp
         if (it == m_dir.end())
             return nullptr;
 
-        std::shared_ptr<Dir> dir = m_dir[dirName];
+        const std::shared_ptr<Dir>& dir = it->second;
         if (!dir)
             return nullptr;
 
@@ -0,0 +1,370 @@
+#include "DarkFunctionParser/SpriteRegistry.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Trace.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace dfp
+{
+    const uint32_t SpriteRegistry::SHARD_COUNT;
+
+    /// The shard of an id is its top bits, HashIndex uses the low bits.
+    static const uint32_t SHARD_SHIFT = 27;
+    static_assert((1u << (32 - SHARD_SHIFT)) == SpriteRegistry::SHARD_COUNT, "SHARD_SHIFT does not match SHARD_COUNT");
+
+    /// One registered sprite. The sheet is kept here, so Find needs only
+    /// the lock of the shard.
+    struct RegistryRecord
+    {
+        std::shared_ptr<const Sprite> sheet;
+
+        /// The key of the record, compared by Find
+        std::string sheetName;
+        std::string path;
+
+        /// The next record with the same id, or INVALID_INDEX
+        uint32_t next;
+
+        /// The registration that added the record
+        uint32_t serial;
+
+        unsigned int x;
+        unsigned int y;
+        unsigned int w;
+        unsigned int h;
+    };
+
+    /// One part of the table, for the ids with the same top bits. Each
+    /// shard is on its own cache line, so 2 threads that use 2 shards do
+    /// not share the line of a lock.
+    struct alignas(64) RegistryShard
+    {
+        std::mutex mutex;
+
+        /// Pair (id, first record of the id in records)
+        HashIndex index;
+
+        std::vector<RegistryRecord> records;
+
+        /// The records that can be used again
+        std::vector<uint32_t> freeRecords;
+    };
+
+    /// One registered sheet, with the ids of its sprites for Unregister.
+    struct RegistrySheet
+    {
+        std::shared_ptr<const Sprite> sheet;
+        uint32_t serial;
+
+        /// Sorted, so the ids of one shard are together. An id is here
+        /// once for each sprite of the sheet that has it.
+        std::vector<uint32_t> ids;
+    };
+
+    static RegistryShard s_shards[SpriteRegistry::SHARD_COUNT];
+
+    /// The sheets, under s_sheetsMutex. Register and Unregister hold it
+    /// from the start to the end, so they are done one at a time and they
+    /// are the only ones that change the shards.
+    static std::mutex s_sheetsMutex;
+    static std::map<std::string, RegistrySheet> s_sheets;
+    static uint32_t s_nextSerial = 1;
+    static std::string s_errorText;
+
+    static RegistryShard &GetShard(uint32_t id)
+    {
+        return s_shards[id >> SHARD_SHIFT];
+    }
+
+    /// The hash of SheetSprId, computed at run time.
+    static uint32_t HashSheetSpr(const std::string &sheetName, const std::string &path)
+    {
+        uint32_t hash = HashPath(sheetName) * HASH_FNV1A_PRIME;
+        for (size_t i = 0; i < path.size(); i++)
+            hash = (hash ^ (uint8_t)path[i]) * HASH_FNV1A_PRIME;
+
+        return hash;
+    }
+
+    /// The record of the key in the chain of the id, or INVALID_INDEX.
+    /// The lock of the shard must be held.
+    static uint32_t FindRecord(const RegistryShard &shard, uint32_t id, const char *sheetName, const char *path)
+    {
+        uint32_t record = shard.index.Find(id);
+        while (record != HashIndex::INVALID_INDEX)
+        {
+            const RegistryRecord &found = shard.records[record];
+            if (found.path == path && found.sheetName == sheetName)
+                return record;
+
+            record = found.next;
+        }
+
+        return HashIndex::INVALID_INDEX;
+    }
+
+    /// The end of the ids that are in the same shard as ids[begin].
+    static size_t GetShardEnd(const std::vector<uint32_t> &ids, size_t begin)
+    {
+        size_t end = begin + 1;
+        while (end < ids.size() && (ids[end] >> SHARD_SHIFT) == (ids[begin] >> SHARD_SHIFT))
+            end++;
+        return end;
+    }
+
+    /// Remove the records of a registration. An id that is now used by
+    /// another registration is not removed.
+    static void RemoveIds(const std::vector<uint32_t> &ids, uint32_t serial)
+    {
+        for (size_t begin = 0; begin < ids.size();)
+        {
+            size_t end = GetShardEnd(ids, begin);
+            RegistryShard &shard = GetShard(ids[begin]);
+
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (size_t i = begin; i < end; i++)
+            {
+                /// Unlink the records of the registration from the chain.
+                uint32_t previous = HashIndex::INVALID_INDEX;
+                uint32_t record = shard.index.Find(ids[i]);
+                while (record != HashIndex::INVALID_INDEX)
+                {
+                    RegistryRecord &removed = shard.records[record];
+                    uint32_t next = removed.next;
+                    if (removed.serial != serial)
+                    {
+                        previous = record;
+                        record = next;
+                        continue;
+                    }
+
+                    if (previous != HashIndex::INVALID_INDEX)
+                        shard.records[previous].next = next;
+                    else
+                    {
+                        shard.index.Erase(ids[i]);
+                        if (next != HashIndex::INVALID_INDEX)
+                            shard.index.Insert(ids[i], next);
+                    }
+
+                    removed.sheet.reset();
+                    removed.sheetName.clear();
+                    removed.path.clear();
+                    shard.freeRecords.push_back(record);
+                    record = next;
+                }
+            }
+
+            begin = end;
+        }
+    }
+
+    ParseResult SpriteRegistry::Register(const std::string &sheetName, const std::shared_ptr<const Sprite> &sheet)
+    {
+        DFP_TRACE_SCOPE_FILE("SpriteRegistry::Register", sheetName);
+
+        if (!sheet)
+        {
+            std::lock_guard<std::mutex> lock(s_sheetsMutex);
+            s_errorText = "The sheet '" + sheetName + "' is null!";
+            return ParseResult::ERROR_NOT_FOUND;
+        }
+
+        /// The ids are computed before taking any lock.
+        std::vector< std::pair<std::string, std::shared_ptr<Spr> > > sprs = sheet->GetAllSprWithPath();
+
+        std::vector< std::pair<uint32_t, size_t> > items;
+        items.reserve(sprs.size());
+        for (size_t i = 0; i < sprs.size(); i++)
+            items.push_back(std::make_pair(HashSheetSpr(sheetName, sprs[i].first), i));
+        std::sort(items.begin(), items.end());
+
+        std::vector<uint32_t> ids;
+        ids.reserve(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+            ids.push_back(items[i].first);
+
+        /// The old sheet is released after the lock.
+        std::shared_ptr<const Sprite> released;
+        std::lock_guard<std::mutex> lock(s_sheetsMutex);
+
+        std::map<std::string, RegistrySheet>::iterator old = s_sheets.find(sheetName);
+        uint32_t oldSerial = (old != s_sheets.end()) ? old->second.serial : 0;
+
+        RegistrySheet registered;
+        registered.sheet = sheet;
+        registered.serial = s_nextSerial++;
+
+        /// The sprites of the old sheet are replaced in place, so a sprite
+        /// that is in both sheets is never missing for the lookups.
+        for (size_t begin = 0; begin < ids.size();)
+        {
+            size_t end = GetShardEnd(ids, begin);
+            RegistryShard &shard = GetShard(ids[begin]);
+
+            std::lock_guard<std::mutex> shardLock(shard.mutex);
+            for (size_t i = begin; i < end; i++)
+            {
+                const std::string &path = sprs[items[i].second].first;
+                const Spr &spr = *sprs[items[i].second].second;
+
+                RegistryRecord entry;
+                entry.sheet = sheet;
+                entry.sheetName = sheetName;
+                entry.path = path;
+                entry.next = HashIndex::INVALID_INDEX;
+                entry.serial = registered.serial;
+                entry.x = spr.GetX();
+                entry.y = spr.GetY();
+                entry.w = spr.GetW();
+                entry.h = spr.GetH();
+
+                uint32_t record = FindRecord(shard, ids[i], sheetName.c_str(), path.c_str());
+                if (record != HashIndex::INVALID_INDEX)
+                {
+                    entry.next = shard.records[record].next;
+                    shard.records[record] = entry;
+                    continue;
+                }
+
+                /// A new key is added at the end of the chain of its id.
+                uint32_t last = shard.index.Find(ids[i]);
+                while (last != HashIndex::INVALID_INDEX && shard.records[last].next != HashIndex::INVALID_INDEX)
+                    last = shard.records[last].next;
+
+                if (!shard.freeRecords.empty())
+                {
+                    record = shard.freeRecords.back();
+                    shard.freeRecords.pop_back();
+                    shard.records[record] = entry;
+                }
+                else
+                {
+                    record = (uint32_t)shard.records.size();
+                    shard.records.push_back(entry);
+                }
+
+                if (last != HashIndex::INVALID_INDEX)
+                    shard.records[last].next = record;
+                else
+                    shard.index.Insert(ids[i], record);
+            }
+
+            begin = end;
+        }
+
+        if (old != s_sheets.end())
+        {
+            /// Only the sprites that are not in the new sheet are still old.
+            RemoveIds(old->second.ids, oldSerial);
+            released = old->second.sheet;
+        }
+
+        registered.ids.swap(ids);
+        s_sheets[sheetName] = registered;
+
+        return ParseResult::OK;
+    }
+
+    bool SpriteRegistry::Unregister(const std::string &sheetName)
+    {
+        DFP_TRACE_SCOPE_FILE("SpriteRegistry::Unregister", sheetName);
+
+        /// The sheet is released after the lock.
+        RegistrySheet released;
+        std::lock_guard<std::mutex> lock(s_sheetsMutex);
+
+        std::map<std::string, RegistrySheet>::iterator it = s_sheets.find(sheetName);
+        if (it == s_sheets.end())
+            return false;
+
+        RemoveIds(it->second.ids, it->second.serial);
+
+        released = it->second;
+        s_sheets.erase(it);
+        return true;
+    }
+
+    void SpriteRegistry::Clear()
+    {
+        std::map<std::string, RegistrySheet> released;
+        std::lock_guard<std::mutex> lock(s_sheetsMutex);
+
+        for (std::map<std::string, RegistrySheet>::const_iterator it = s_sheets.begin(); it != s_sheets.end(); ++it)
+            RemoveIds(it->second.ids, it->second.serial);
+
+        released.swap(s_sheets);
+    }
+
+    /// The common part of the two Find.
+    static bool FindEntry(uint32_t id, const char *sheetName, const char *path, SpriteRegistry::Entry &entry)
+    {
+        RegistryShard &shard = GetShard(id);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        uint32_t record = FindRecord(shard, id, sheetName, path);
+        if (record == HashIndex::INVALID_INDEX)
+            return false;
+
+        const RegistryRecord &found = shard.records[record];
+        entry.sheet = found.sheet;
+        entry.x = found.x;
+        entry.y = found.y;
+        entry.w = found.w;
+        entry.h = found.h;
+        return true;
+    }
+
+    bool SpriteRegistry::Find(SheetSprId id, Entry &entry)
+    {
+        return FindEntry(id.hash, id.sheetName, id.path, entry);
+    }
+
+    bool SpriteRegistry::Find(const std::string &sheetName, const std::string &path, Entry &entry)
+    {
+        return FindEntry(HashSheetSpr(sheetName, path), sheetName.c_str(), path.c_str(), entry);
+    }
+
+    std::shared_ptr<const Sprite> SpriteRegistry::GetSheet(const std::string &sheetName)
+    {
+        std::lock_guard<std::mutex> lock(s_sheetsMutex);
+
+        std::map<std::string, RegistrySheet>::const_iterator it = s_sheets.find(sheetName);
+        if (it == s_sheets.end())
+            return nullptr;
+
+        return it->second.sheet;
+    }
+
+    std::vector<std::string> SpriteRegistry::GetSheetNames()
+    {
+        std::lock_guard<std::mutex> lock(s_sheetsMutex);
+
+        std::vector<std::string> names;
+        names.reserve(s_sheets.size());
+        for (std::map<std::string, RegistrySheet>::const_iterator it = s_sheets.begin(); it != s_sheets.end(); ++it)
+            names.push_back(it->first);
+
+        return names;
+    }
+
+    size_t SpriteRegistry::GetCount()
+    {
+        std::lock_guard<std::mutex> lock(s_sheetsMutex);
+
+        size_t count = 0;
+        for (std::map<std::string, RegistrySheet>::const_iterator it = s_sheets.begin(); it != s_sheets.end(); ++it)
+            count += it->second.ids.size();
+
+        return count;
+    }
+
+    std::string SpriteRegistry::GetErrorText()
+    {
+        std::lock_guard<std::mutex> lock(s_sheetsMutex);
+        return s_errorText;
+    }
+
+} //namespace dfp
@@ -0,0 +1,462 @@
+#include "DarkFunctionParser/StreamParser.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Trace.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace dfp
+{
+    /// The number of bytes read at once by ParseFile.
+    static const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+    StreamParser::StreamParser()
+        : m_result(ParseResult::OK)
+        , m_finished(false)
+    {}
+
+    StreamParser::~StreamParser()
+    {}
+
+    void StreamParser::Start(const std::string &fileName)
+    {
+        m_reader.Reset();
+        m_result = ParseResult::OK;
+        m_finished = false;
+
+        if (!fileName.empty())
+            SetFilePath(fileName);
+
+        BeginDocument();
+    }
+
+    bool StreamParser::Stop(ParseResult result)
+    {
+        m_result = result;
+        return false;
+    }
+
+    ParseResult StreamParser::Fail(ParseResult result, const std::string &errorText)
+    {
+        SetDocumentErrorText(errorText);
+        m_result = result;
+        return result;
+    }
+
+    ParseResult StreamParser::Feed(const char *data, size_t size)
+    {
+        DFP_TRACE_SCOPE("StreamParser::Feed");
+
+        if (m_result != ParseResult::OK)
+            return m_result;
+        if (m_finished)
+            return Fail(ParseResult::ERROR_PARSING_FAILED, "Finish was already called!");
+
+        if (!m_reader.Feed(data, size, *this) && m_reader.Error())
+            return Fail(ParseResult::ERROR_PARSING_FAILED, m_reader.GetErrorText());
+
+        return m_result;
+    }
+
+    ParseResult StreamParser::Finish()
+    {
+        DFP_TRACE_SCOPE("StreamParser::Finish");
+
+        if (m_finished || m_result != ParseResult::OK)
+        {
+            m_finished = true;
+            return m_result;
+        }
+        m_finished = true;
+
+        if (!m_reader.Finish())
+            return Fail(ParseResult::ERROR_PARSING_FAILED, m_reader.GetErrorText());
+
+        m_result = EndDocument();
+        return m_result;
+    }
+
+    ParseResult StreamParser::ParseFile(const std::string &fileName)
+    {
+        DFP_TRACE_SCOPE_FILE("StreamParser::ParseFile", fileName);
+
+        Start(fileName);
+
+        // Open the file for reading.
+#ifdef USE_SDL2_LOAD
+        SDL_RWops * file = SDL_RWFromFile(fileName.c_str(), "rb");
+#else
+        FILE *file = fopen(fileName.c_str(), "rb");
+#endif
+
+        // Check if the file could not be opened.
+        if (!file)
+        {
+            m_finished = true;
+            return Fail(ParseResult::ERROR_COULDNT_OPEN, "Cannot open the file " + fileName);
+        }
+
+        std::vector<char> chunk(READ_CHUNK_SIZE);
+        size_t fileSize = 0;
+        for (;;)
+        {
+#ifdef USE_SDL2_LOAD
+            size_t readSize = file->read(file, chunk.data(), 1, chunk.size());
+#else
+            size_t readSize = fread(chunk.data(), 1, chunk.size(), file);
+#endif
+            if (readSize == 0)
+                break;
+
+            fileSize += readSize;
+            if (Feed(chunk.data(), readSize) != ParseResult::OK)
+                break;
+        }
+
+#ifdef USE_SDL2_LOAD
+        file->close(file);
+#else
+        fclose(file);
+#endif
+
+        // Check if the file size is valid.
+        if (fileSize == 0)
+        {
+            m_finished = true;
+            return Fail(ParseResult::ERROR_INVALID_FILE_SIZE, "Invalid size for " + fileName);
+        }
+
+        return Finish();
+    }
+
+    ParseResult StreamParser::GetResult() const
+    {
+        return m_result;
+    }
+
+    std::string StreamParser::GetErrorText() const
+    {
+        return GetDocumentErrorText();
+    }
+
+
+
+
+    SpriteStreamParser::SpriteStreamParser(Sprite &sprite)
+        : m_sprite(sprite)
+        , m_hasRoot(false)
+    {}
+
+    void SpriteStreamParser::SetFilePath(const std::string &fileName)
+    {
+        m_sprite.SetFilePath(fileName);
+    }
+
+    std::string SpriteStreamParser::GetDocumentErrorText() const
+    {
+        return m_sprite.GetErrorText();
+    }
+
+    void SpriteStreamParser::SetDocumentErrorText(const std::string &errorText)
+    {
+        m_sprite.m_errorText = errorText;
+    }
+
+    void SpriteStreamParser::BeginDocument()
+    {
+        m_stack.clear();
+        m_hasRoot = false;
+    }
+
+    ParseResult SpriteStreamParser::EndDocument()
+    {
+        if (!m_hasRoot)
+        {
+            m_sprite.m_errorText = "Cannot find node <img> !";
+            return ParseResult::ERROR_MISSING_NODE;
+        }
+
+        ParseResult result = m_sprite.BuildIndex();
+        if (result != ParseResult::OK)
+            return result;
+
+        m_sprite.ComputeMemoryUsage();
+
+        return ParseResult::OK;
+    }
+
+    bool SpriteStreamParser::FailDir(ParseResult result, const char *nodeName, std::string errorText)
+    {
+        /// Like Dir::ParseXML, each open <dir> adds its name to the text.
+        std::string name = nodeName;
+        for (size_t i = m_stack.size(); i > 0 && m_stack[i - 1].context == CONTEXT_DIR; i--)
+        {
+            errorText = "Parsing <" + name + "> from <dir name='" + m_stack[i - 1].dir->GetName() + "'> Failed! >> " + errorText;
+            name = "dir";
+        }
+
+        m_sprite.m_errorText = "Parsing <dir> Failed! >> " + errorText;
+        return Stop(result);
+    }
+
+    bool SpriteStreamParser::OnStartElement(const XmlNode &node, size_t depth)
+    {
+        Frame frame;
+        frame.context = CONTEXT_SKIP;
+        frame.loadSpr = false;
+        frame.loadDir = true;
+        frame.hasChild = false;
+
+        const char *name = node.Value();
+        Frame *parent = depth ? &m_stack[depth - 1] : nullptr;
+
+        if (!parent)
+        {
+            /// The first <img> is the document, the other top level elements are skipped.
+            if (!m_hasRoot && strcmp(name, "img") == 0)
+            {
+                m_hasRoot = true;
+
+                ParseResult result = m_sprite.ParseRootAttributes(node);
+                if (result != ParseResult::OK)
+                    return Stop(result);
+
+                frame.context = CONTEXT_IMG;
+            }
+        }
+        else
+        {
+            parent->hasChild = true;
+
+            if (parent->context == CONTEXT_IMG && strcmp(name, "definitions") == 0)
+                frame.context = CONTEXT_DEFINITIONS;
+            else if (parent->context == CONTEXT_DEFINITIONS && strcmp(name, "dir") == 0)
+            {
+                std::shared_ptr<Dir> dir = std::make_shared<Dir>();
+                ParseResult result = dir->ParseAttributes(node);
+                if (result != ParseResult::OK)
+                    return FailDir(result, "dir", dir->GetErrorText());
+
+                /// A root skipped by the load filter is kept, without its childs.
+                LoadFilter::Decision decision = m_sprite.GetLoadFilter().CheckDir("/");
+
+                frame.context = CONTEXT_DIR;
+                frame.dir = dir;
+                frame.path = "/";
+                frame.loadSpr = (decision == LoadFilter::DIR_LOAD);
+                frame.loadDir = (decision != LoadFilter::DIR_SKIP);
+            }
+            else if (parent->context == CONTEXT_DIR && strcmp(name, "dir") == 0 && parent->loadDir)
+            {
+                const LoadFilter &filter = m_sprite.GetLoadFilter();
+                LoadFilter::Decision decision = LoadFilter::DIR_LOAD;
+                if (!filter.IsEmpty())
+                {
+                    /// Check the name before creating the Dir, so a skipped dir costs nothing.
+                    const char *dirName = node.Attribute("name");
+                    frame.path = parent->path + (dirName ? dirName : "") + "/";
+                    decision = filter.CheckDir(frame.path);
+                }
+
+                if (decision != LoadFilter::DIR_SKIP)
+                {
+                    std::shared_ptr<Dir> dir = std::make_shared<Dir>();
+                    ParseResult result = dir->ParseAttributes(node);
+                    if (result != ParseResult::OK)
+                        return FailDir(result, "dir", dir->GetErrorText());
+
+                    parent->dir->m_dir[dir->GetName()] = dir;
+
+                    frame.context = CONTEXT_DIR;
+                    frame.dir = dir;
+                    frame.loadSpr = (decision == LoadFilter::DIR_LOAD);
+                }
+            }
+            else if (parent->context == CONTEXT_DIR && strcmp(name, "spr") == 0 && parent->loadSpr)
+            {
+                std::shared_ptr<Spr> spr = std::make_shared<Spr>();
+                ParseResult result = spr->ParseXML(node);
+                if (result != ParseResult::OK)
+                    return FailDir(result, "spr", spr->GetErrorText());
+
+                parent->dir->m_spr[spr->GetName()] = spr;
+            }
+        }
+
+        m_stack.push_back(frame);
+        return true;
+    }
+
+    bool SpriteStreamParser::OnEndElement(size_t depth)
+    {
+        Frame frame = m_stack.back();
+        m_stack.pop_back();
+
+        if (frame.context == CONTEXT_IMG && !frame.hasChild)
+        {
+            m_sprite.m_errorText = "The <img> node does not have child nodes!";
+            return Stop(ParseResult::ERROR_IMAGE_PATHNAME_WRONG);
+        }
+
+        /// A <dir> of <definitions> is complete, it is the root.
+        if (frame.context == CONTEXT_DIR && depth > 0 && m_stack.back().context == CONTEXT_DEFINITIONS)
+        {
+            ParseResult result = m_sprite.SetRoot(frame.dir);
+            if (result != ParseResult::OK)
+                return Stop(result);
+        }
+
+        return true;
+    }
+
+
+
+
+    AnimationsStreamParser::AnimationsStreamParser(Animations &animations)
+        : m_animations(animations)
+        , m_hasRoot(false)
+    {}
+
+    void AnimationsStreamParser::SetFilePath(const std::string &fileName)
+    {
+        m_animations.SetFilePath(fileName);
+    }
+
+    std::string AnimationsStreamParser::GetDocumentErrorText() const
+    {
+        return m_animations.GetErrorText();
+    }
+
+    void AnimationsStreamParser::SetDocumentErrorText(const std::string &errorText)
+    {
+        m_animations.m_errorText = errorText;
+    }
+
+    void AnimationsStreamParser::BeginDocument()
+    {
+        m_stack.clear();
+        m_anim.reset();
+        m_cell.reset();
+        m_hasRoot = false;
+    }
+
+    ParseResult AnimationsStreamParser::EndDocument()
+    {
+        if (!m_hasRoot)
+        {
+            m_animations.m_errorText = "Cannot find node <animations> !";
+            return ParseResult::ERROR_MISSING_NODE;
+        }
+
+        ParseResult result = m_animations.BuildIndex();
+        if (result != ParseResult::OK)
+            return result;
+
+        m_animations.ComputeMemoryUsage();
+
+        return ParseResult::OK;
+    }
+
+    bool AnimationsStreamParser::FailAnim(ParseResult result)
+    {
+        m_animations.m_errorText = "Parsing <anim> Failed! >> " + m_anim->GetErrorText();
+        return Stop(result);
+    }
+
+    bool AnimationsStreamParser::FailCell(ParseResult result)
+    {
+        m_anim->m_errorText = "Parsing <cell> from <anim name='" + m_anim->GetName() + "'> Failed! >> " + m_cell->GetErrorText();
+        return FailAnim(result);
+    }
+
+    bool AnimationsStreamParser::OnStartElement(const XmlNode &node, size_t depth)
+    {
+        Frame frame;
+        frame.context = CONTEXT_SKIP;
+        frame.hasChild = false;
+
+        const char *name = node.Value();
+        Frame *parent = depth ? &m_stack[depth - 1] : nullptr;
+
+        if (!parent)
+        {
+            /// The first <animations> is the document, the other top level elements are skipped.
+            if (!m_hasRoot && strcmp(name, "animations") == 0)
+            {
+                m_hasRoot = true;
+
+                ParseResult result = m_animations.ParseRootAttributes(node);
+                if (result != ParseResult::OK)
+                    return Stop(result);
+
+                frame.context = CONTEXT_ANIMATIONS;
+            }
+        }
+        else
+        {
+            parent->hasChild = true;
+
+            if (parent->context == CONTEXT_ANIMATIONS && strcmp(name, "anim") == 0)
+            {
+                /// The node has no child here, the cells are added by the next calls.
+                m_anim = std::make_shared<Anim>();
+                ParseResult result = m_anim->ParseXML(node);
+                if (result != ParseResult::OK)
+                    return FailAnim(result);
+
+                frame.context = CONTEXT_ANIM;
+            }
+            else if (parent->context == CONTEXT_ANIM && strcmp(name, "cell") == 0)
+            {
+                m_cell = std::make_shared<Cell>();
+                ParseResult result = m_cell->ParseXML(node);
+                if (result != ParseResult::OK)
+                    return FailCell(result);
+
+                m_anim->m_cell.push_back(m_cell);
+                frame.context = CONTEXT_CELL;
+            }
+            else if (parent->context == CONTEXT_CELL && strcmp(name, "spr") == 0)
+            {
+                std::shared_ptr<CellSpr> cellspr = std::make_shared<CellSpr>();
+                ParseResult result = cellspr->ParseXML(node);
+                if (result != ParseResult::OK)
+                {
+                    m_cell->m_errorText = "Parsing <spr> from <cell index=\"not_set\"> Failed! >> " + cellspr->GetErrorText();
+                    return FailCell(result);
+                }
+
+                m_cell->m_cellsSpr.push_back(cellspr);
+            }
+        }
+
+        m_stack.push_back(frame);
+        return true;
+    }
+
+    bool AnimationsStreamParser::OnEndElement(size_t)
+    {
+        Frame frame = m_stack.back();
+        m_stack.pop_back();
+
+        if (frame.context == CONTEXT_ANIMATIONS && !frame.hasChild)
+        {
+            m_animations.m_errorText = "The <spriteSheet> node does not have child nodes!";
+            return Stop(ParseResult::ERROR_SPRITE_PATHNAME_WRONG);
+        }
+
+        if (frame.context == CONTEXT_ANIM)
+        {
+            /// All the cells are known now.
+            m_anim->ClassifyPlayback();
+            m_animations.m_anim[m_anim->GetName()] = m_anim;
+            m_anim.reset();
+        }
+        else if (frame.context == CONTEXT_CELL)
+            m_cell.reset();
+
+        return true;
+    }
+
+} //namespace dfp
@@ -0,0 +1,363 @@
+#include "DarkFunctionParser/TickEngine.h"
+#include "DarkFunctionParser/Animations.h"
+
+#include <algorithm>
+
+namespace dfp
+{
+    /// 1 millisecond in Q16 microseconds.
+    static const uint64_t Q16_MILLISECOND = (uint64_t)1000 << 16;
+
+    /// (a * b) % m without overflow. a and b must be smaller than m.
+    static uint64_t MulMod(uint64_t a, uint64_t b, uint64_t m)
+    {
+        uint64_t result = 0;
+        while (b)
+        {
+            if (b & 1)
+                result = (result >= m - a) ? result - (m - a) : result + a;
+
+            b >>= 1;
+            if (b)
+                a = (a >= m - a) ? a - (m - a) : a + a;
+        }
+        return result;
+    }
+
+
+
+
+    TickTimeline::TickTimeline()
+        : m_uniformDelay(0)
+    {
+        m_start.push_back(0);
+    }
+
+    ParseResult TickTimeline::Build(std::shared_ptr<Anim> anim)
+    {
+        m_delay.clear();
+        m_start.clear();
+        m_cell.clear();
+        m_start.push_back(0);
+        m_uniformDelay = 0;
+
+        if (!anim)
+            return ParseResult::ERROR_MISSING_NODE;
+
+        for (const auto& cell : anim->GetCells())
+        {
+            /// GetDelay will return the delay in milliseconds.
+            uint64_t delay = (uint64_t)cell->GetDelay() * Q16_MILLISECOND;
+            if (delay == 0)
+                delay = Q16_MILLISECOND;
+
+            m_delay.push_back(delay);
+            m_start.push_back(m_start.back() + delay);
+            m_cell.push_back(cell);
+        }
+
+        if (!m_delay.empty() && std::count(m_delay.begin(), m_delay.end(), m_delay[0]) == (std::ptrdiff_t)m_delay.size())
+            m_uniformDelay = m_delay[0];
+
+        return ParseResult::OK;
+    }
+
+    uint32_t TickTimeline::GetCellCount() const
+    {
+        return (uint32_t)m_delay.size();
+    }
+
+    uint64_t TickTimeline::GetPeriod() const
+    {
+        return m_start.back();
+    }
+
+    uint64_t TickTimeline::GetDelay(uint32_t cellIndex) const
+    {
+        if (cellIndex >= m_delay.size())
+            return 0;
+
+        return m_delay[cellIndex];
+    }
+
+    std::shared_ptr<Cell> TickTimeline::GetCell(uint32_t cellIndex) const
+    {
+        if (cellIndex >= m_cell.size())
+            return nullptr;
+
+        return m_cell[cellIndex];
+    }
+
+    void TickTimeline::Advance(uint32_t& cellIndex, uint64_t& elapsed, uint64_t advance) const
+    {
+        const size_t maxCells = m_delay.size();
+        if (maxCells == 0 || cellIndex >= maxCells)
+            return;
+
+        const uint64_t period = m_start.back();
+
+        /// Only the remainder modulo the period matters once we know that
+        /// at least one full loop is done. This also protects the sum below.
+        if (advance > period)
+            advance = period + advance % period;
+
+        uint64_t t = elapsed + advance;
+
+        /// A full loop is done only when t is strictly bigger than the period,
+        /// so keep t in (0, period].
+        if (t > period)
+            t -= period * ((t - 1) / period);
+
+        /// Position from the start of the first cell. Find the first cell j
+        /// (from cellIndex, looping) with position <= m_start[j + 1].
+        uint64_t position = m_start[cellIndex] + t;
+        if (m_uniformDelay)
+        {
+            /// Nothing to move (the search below would keep the cell too).
+            if (t == 0)
+                return;
+
+            /// m_start[j + 1] == (j + 1) * delay, j is found with a division.
+            if (position > period)
+                position -= period;
+
+            cellIndex = (uint32_t)((position - 1) / m_uniformDelay);
+            elapsed = position - cellIndex * m_uniformDelay;
+            return;
+        }
+
+        std::vector<uint64_t>::const_iterator it;
+        if (position <= period)
+        {
+            it = std::lower_bound(m_start.begin() + cellIndex + 1, m_start.end(), position);
+        }
+        else
+        {
+            position -= period;
+            it = std::lower_bound(m_start.begin() + 1, m_start.begin() + cellIndex + 1, position);
+        }
+
+        cellIndex = (uint32_t)(it - m_start.begin()) - 1;
+        elapsed = position - m_start[cellIndex];
+    }
+
+
+
+
+    TickEngine::TickEngine(uint32_t tickMicroseconds)
+        : m_tickMicroseconds(tickMicroseconds ? tickMicroseconds : 1000)
+        , m_tick(0)
+        , m_instanceGauge(Metrics::GAUGE_TICK_INSTANCES)
+    {}
+
+    uint32_t TickEngine::ToSpeedQ16(float animSpeedFactor)
+    {
+        if (animSpeedFactor <= 0)
+            animSpeedFactor = 1.0f;
+
+        double speed = (double)animSpeedFactor * SPEED_ONE + 0.5;
+        if (speed >= 4294967295.0)
+            return 0xFFFFFFFF;
+        if (speed < 1.0)
+            return 1;
+
+        return (uint32_t)speed;
+    }
+
+    uint32_t TickEngine::GetTickMicroseconds() const
+    {
+        return m_tickMicroseconds;
+    }
+
+    uint64_t TickEngine::GetTick() const
+    {
+        return m_tick;
+    }
+
+    uint32_t TickEngine::AddTimeline(std::shared_ptr<Anim> anim)
+    {
+        TickTimeline timeline;
+        if (timeline.Build(anim) != ParseResult::OK || timeline.GetCellCount() == 0)
+            return INVALID_ID;
+
+        m_timeline.push_back(timeline);
+        return (uint32_t)(m_timeline.size() - 1);
+    }
+
+    const TickTimeline& TickEngine::GetTimeline(uint32_t timelineId) const
+    {
+        return m_timeline.at(timelineId);
+    }
+
+    uint32_t TickEngine::Spawn(uint32_t timelineId, uint32_t speedQ16)
+    {
+        if (timelineId >= m_timeline.size())
+            return INVALID_ID;
+
+        if (speedQ16 == 0)
+            speedQ16 = SPEED_ONE;
+
+        uint32_t id;
+        if (!m_freeIds.empty())
+        {
+            id = m_freeIds.back();
+            m_freeIds.pop_back();
+        }
+        else
+        {
+            id = (uint32_t)m_instAlive.size();
+            m_instTimeline.push_back(0);
+            m_instCell.push_back(0);
+            m_instElapsed.push_back(0);
+            m_instSpeed.push_back(0);
+            m_instAlive.push_back(0);
+            m_instVisible.push_back(0);
+            m_instSyncTick.push_back(0);
+        }
+
+        m_instTimeline[id] = timelineId;
+        m_instCell[id] = 0;
+        m_instElapsed[id] = 0;
+        m_instSpeed[id] = speedQ16;
+        m_instAlive[id] = 1;
+        m_instVisible[id] = 1;
+        m_instSyncTick[id] = m_tick;
+
+        m_instanceGauge.Add(1);
+        return id;
+    }
+
+    void TickEngine::Despawn(uint32_t instanceId)
+    {
+        if (instanceId >= m_instAlive.size() || !m_instAlive[instanceId])
+            return;
+
+        m_instAlive[instanceId] = 0;
+        m_freeIds.push_back(instanceId);
+
+        m_instanceGauge.Add(-1);
+    }
+
+    void TickEngine::SetSpeed(uint32_t instanceId, uint32_t speedQ16)
+    {
+        if (instanceId >= m_instAlive.size())
+            return;
+
+        CatchUp(instanceId);
+
+        m_instSpeed[instanceId] = speedQ16 ? speedQ16 : SPEED_ONE;
+    }
+
+    void TickEngine::SetVisible(uint32_t instanceId, bool visible)
+    {
+        if (instanceId >= m_instAlive.size() || !m_instAlive[instanceId])
+            return;
+
+        if (visible)
+        {
+            CatchUp(instanceId);
+            m_instVisible[instanceId] = 1;
+        }
+        else if (m_instVisible[instanceId])
+        {
+            m_instVisible[instanceId] = 0;
+            m_instSyncTick[instanceId] = m_tick;
+        }
+    }
+
+    bool TickEngine::IsVisible(uint32_t instanceId) const
+    {
+        if (instanceId >= m_instAlive.size())
+            return false;
+
+        return m_instVisible[instanceId] != 0;
+    }
+
+    uint64_t TickEngine::GetAdvance(const TickTimeline& timeline, uint64_t ticks, uint32_t speedQ16) const
+    {
+        /// The time for one tick, scaled by the speed (Q16 microseconds).
+        /// It always fits: both values are 32 bits.
+        const uint64_t step = (uint64_t)m_tickMicroseconds * speedQ16;
+
+        if (ticks <= UINT64_MAX / step)
+            return ticks * step;
+
+        /// Too big to multiply. Keep only the remainder modulo the
+        /// period, plus one full period so the result is the same.
+        const uint64_t period = timeline.GetPeriod();
+        return period + MulMod(ticks % period, step % period, period);
+    }
+
+    void TickEngine::CatchUp(uint32_t instanceId)
+    {
+        if (m_instVisible[instanceId])
+            return;
+
+        uint64_t ticks = m_tick - m_instSyncTick[instanceId];
+        m_instSyncTick[instanceId] = m_tick;
+
+        if (ticks == 0)
+            return;
+
+        DFP_METRICS_ADD(Metrics::COUNTER_TICK_CATCHUPS, 1);
+
+        const TickTimeline& timeline = m_timeline[m_instTimeline[instanceId]];
+        timeline.Advance(m_instCell[instanceId], m_instElapsed[instanceId],
+            GetAdvance(timeline, ticks, m_instSpeed[instanceId]));
+    }
+
+    void TickEngine::Advance(uint32_t ticks)
+    {
+        m_tick += ticks;
+
+        if (ticks == 0)
+            return;
+
+        const size_t count = m_instAlive.size();
+        uint64_t updated = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            /// The hidden instances are updated later, by CatchUp.
+            if (!m_instAlive[i] || !m_instVisible[i])
+                continue;
+
+            const TickTimeline& timeline = m_timeline[m_instTimeline[i]];
+            timeline.Advance(m_instCell[i], m_instElapsed[i], GetAdvance(timeline, ticks, m_instSpeed[i]));
+            updated++;
+        }
+
+        DFP_METRICS_ADD(Metrics::COUNTER_TICK_INSTANCE_UPDATES, updated);
+    }
+
+    uint32_t TickEngine::GetCellIndex(uint32_t instanceId) const
+    {
+        if (instanceId >= m_instAlive.size())
+            return 0;
+
+        if (m_instVisible[instanceId] || m_tick == m_instSyncTick[instanceId])
+            return m_instCell[instanceId];
+
+        /// Hidden: compute the cell on a copy, the instance is not changed.
+        const TickTimeline& timeline = m_timeline[m_instTimeline[instanceId]];
+        uint32_t cellIndex = m_instCell[instanceId];
+        uint64_t elapsed = m_instElapsed[instanceId];
+        timeline.Advance(cellIndex, elapsed,
+            GetAdvance(timeline, m_tick - m_instSyncTick[instanceId], m_instSpeed[instanceId]));
+
+        return cellIndex;
+    }
+
+    std::shared_ptr<Cell> TickEngine::GetCurrentCell(uint32_t instanceId) const
+    {
+        if (instanceId >= m_instAlive.size() || !m_instAlive[instanceId])
+            return nullptr;
+
+        return m_timeline[m_instTimeline[instanceId]].GetCell(GetCellIndex(instanceId));
+    }
+
+    uint32_t TickEngine::GetInstanceCount() const
+    {
+        return (uint32_t)(m_instAlive.size() - m_freeIds.size());
+    }
+
+} //namespace dfp
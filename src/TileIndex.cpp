@@ -0,0 +1,265 @@
+#include "DarkFunctionParser/TileIndex.h"
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+
+#include <map>
+#include <algorithm>
+
+namespace dfp
+{
+    TileSet::TileSet()
+        : m_tileCount(0)
+        , m_count(0)
+    {}
+
+    void TileSet::Reset(uint32_t tileCount)
+    {
+        m_bits.assign((tileCount + 63) / 64, 0);
+        m_tileCount = tileCount;
+        m_count = 0;
+    }
+
+    void TileSet::Clear()
+    {
+        std::fill(m_bits.begin(), m_bits.end(), 0);
+        m_count = 0;
+    }
+
+    void TileSet::Add(uint32_t tile)
+    {
+        if (tile >= m_tileCount)
+            return;
+
+        uint64_t mask = (uint64_t)1 << (tile & 63);
+        uint64_t &word = m_bits[tile >> 6];
+        if (!(word & mask))
+        {
+            word |= mask;
+            m_count++;
+        }
+    }
+
+    bool TileSet::Contains(uint32_t tile) const
+    {
+        if (tile >= m_tileCount)
+            return false;
+
+        return (m_bits[tile >> 6] >> (tile & 63)) & 1;
+    }
+
+    uint32_t TileSet::GetCount() const
+    {
+        return m_count;
+    }
+
+    void TileSet::GetTiles(std::vector<uint32_t> &tiles) const
+    {
+        tiles.clear();
+        tiles.reserve(m_count);
+
+        for (size_t w = 0; w < m_bits.size(); w++)
+        {
+            uint64_t word = m_bits[w];
+            for (uint32_t b = 0; word; b++, word >>= 1)
+            {
+                if (word & 1)
+                    tiles.push_back((uint32_t)(w * 64 + b));
+            }
+        }
+    }
+
+
+
+
+    const uint32_t TileIndex::INVALID_INDEX;
+
+    TileIndex::TileIndex()
+        : m_errorText("")
+        , m_tileSize(0)
+        , m_tilesX(0)
+        , m_tilesY(0)
+    {}
+
+    void TileIndex::AddRectTiles(uint32_t x, uint32_t y, uint32_t w, uint32_t h, std::vector<uint32_t> &tiles) const
+    {
+        if (w == 0 || h == 0)
+            return;
+
+        uint32_t x0 = x / m_tileSize;
+        uint32_t y0 = y / m_tileSize;
+        uint32_t x1 = std::min((x + w - 1) / m_tileSize, m_tilesX - 1);
+        uint32_t y1 = std::min((y + h - 1) / m_tileSize, m_tilesY - 1);
+
+        for (uint32_t ty = y0; ty <= y1; ty++)
+        {
+            for (uint32_t tx = x0; tx <= x1; tx++)
+                tiles.push_back(ty * m_tilesX + tx);
+        }
+    }
+
+    /// Sort a list and remove the duplicates.
+    static void SortUnique(std::vector<uint32_t> &tiles)
+    {
+        std::sort(tiles.begin(), tiles.end());
+        tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+    }
+
+    ParseResult TileIndex::Build(const Animations &animations, const Sprite &sprite, uint32_t tileSize)
+    {
+        m_errorText = "";
+        m_tiles.clear();
+        m_animTiles.clear();
+        m_animCells.clear();
+        m_cellTiles.clear();
+        m_animIndex.Clear();
+        m_missingSprites.clear();
+        m_tileSize = 0;
+        m_tilesX = 0;
+        m_tilesY = 0;
+
+        if (tileSize == 0 || sprite.GetImageW() == 0 || sprite.GetImageH() == 0)
+        {
+            m_errorText = "The tile size and the image size must not be 0!";
+            return ParseResult::ERROR_NUMERIC_ATTRIBUTE_WRONG;
+        }
+
+        m_tileSize = tileSize;
+        m_tilesX = (sprite.GetImageW() + tileSize - 1) / tileSize;
+        m_tilesY = (sprite.GetImageH() + tileSize - 1) / tileSize;
+
+        /// The tiles of each sprite path, computed once.
+        std::map< std::string, std::vector<uint32_t> > rectTiles;
+
+        std::vector<uint32_t> cellTiles;
+        std::vector<uint32_t> animTiles;
+
+        /// The ids of 2 anim names, removed at the end.
+        std::vector<uint32_t> collided;
+
+        const std::map< std::string, std::shared_ptr<Anim> > &anims = animations.GetAnims();
+        for (std::map< std::string, std::shared_ptr<Anim> >::const_iterator it = anims.begin(); it != anims.end(); ++it)
+        {
+            const Anim &anim = *it->second;
+
+            TileRange cells;
+            cells.first = (uint32_t)m_cellTiles.size();
+            cells.count = (uint32_t)anim.GetCells().size();
+
+            animTiles.clear();
+
+            for (size_t c = 0; c < anim.GetCells().size(); c++)
+            {
+                const std::vector< std::shared_ptr<CellSpr> > &cellSprs = anim.GetCells()[c]->GetCellsSpr();
+
+                cellTiles.clear();
+                for (size_t s = 0; s < cellSprs.size(); s++)
+                {
+                    std::string path = cellSprs[s]->GetName();
+
+                    std::map< std::string, std::vector<uint32_t> >::iterator found = rectTiles.find(path);
+                    if (found == rectTiles.end())
+                    {
+                        /// A missing sprite has no tiles, it is reported once.
+                        std::vector<uint32_t> &tiles = rectTiles[path];
+                        std::shared_ptr<Spr> spr = sprite.GetSpr(path);
+                        if (spr)
+                            AddRectTiles(spr->GetX(), spr->GetY(), spr->GetW(), spr->GetH(), tiles);
+                        else
+                            m_missingSprites.push_back(path);
+                        found = rectTiles.find(path);
+                    }
+
+                    cellTiles.insert(cellTiles.end(), found->second.begin(), found->second.end());
+                }
+                SortUnique(cellTiles);
+
+                TileRange range;
+                range.first = (uint32_t)m_tiles.size();
+                range.count = (uint32_t)cellTiles.size();
+                m_tiles.insert(m_tiles.end(), cellTiles.begin(), cellTiles.end());
+                m_cellTiles.push_back(range);
+
+                animTiles.insert(animTiles.end(), cellTiles.begin(), cellTiles.end());
+            }
+            SortUnique(animTiles);
+
+            TileRange range;
+            range.first = (uint32_t)m_tiles.size();
+            range.count = (uint32_t)animTiles.size();
+            m_tiles.insert(m_tiles.end(), animTiles.begin(), animTiles.end());
+
+            /// Same as Animations::BuildIndex, an id of 2 names is removed.
+            uint32_t hash = AnimId(it->first).hash;
+            if (!m_animIndex.Insert(hash, (uint32_t)m_animTiles.size()))
+                collided.push_back(hash);
+            m_animTiles.push_back(range);
+            m_animCells.push_back(cells);
+        }
+
+        for (size_t i = 0; i < collided.size(); i++)
+            m_animIndex.Erase(collided[i]);
+
+        return ParseResult::OK;
+    }
+
+    const std::vector<std::string>& TileIndex::GetMissingSprites() const
+    {
+        return m_missingSprites;
+    }
+
+    std::string TileIndex::GetErrorText() const
+    {
+        return m_errorText;
+    }
+
+    uint32_t TileIndex::GetTileSize() const
+    {
+        return m_tileSize;
+    }
+
+    uint32_t TileIndex::GetTilesX() const
+    {
+        return m_tilesX;
+    }
+
+    uint32_t TileIndex::GetTilesY() const
+    {
+        return m_tilesY;
+    }
+
+    uint32_t TileIndex::GetTileCount() const
+    {
+        return m_tilesX * m_tilesY;
+    }
+
+    uint32_t TileIndex::GetAnimCount() const
+    {
+        return (uint32_t)m_animTiles.size();
+    }
+
+    uint32_t TileIndex::FindAnim(AnimId id) const
+    {
+        return m_animIndex.Find(id.hash);
+    }
+
+    void TileIndex::AddAnimTiles(uint32_t animIndex, TileSet &tiles) const
+    {
+        if (animIndex >= m_animTiles.size())
+            return;
+
+        const TileRange &range = m_animTiles[animIndex];
+        for (uint32_t i = 0; i < range.count; i++)
+            tiles.Add(m_tiles[range.first + i]);
+    }
+
+    void TileIndex::AddCellTiles(uint32_t animIndex, uint32_t cellIndex, TileSet &tiles) const
+    {
+        if (animIndex >= m_animCells.size() || cellIndex >= m_animCells[animIndex].count)
+            return;
+
+        const TileRange &range = m_cellTiles[m_animCells[animIndex].first + cellIndex];
+        for (uint32_t i = 0; i < range.count; i++)
+            tiles.Add(m_tiles[range.first + i]);
+    }
+
+} //namespace dfp
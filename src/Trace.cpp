@@ -0,0 +1,276 @@
+#include "DarkFunctionParser/Trace.h"
+
+#include <cstdio>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+namespace dfp
+{
+    /// One recorded event.
+    struct TraceEvent
+    {
+        const char *name;
+        std::string fileName;
+        uint64_t start;
+        uint64_t duration;
+    };
+
+    /// The events of one thread. The lock is taken only by its thread,
+    /// except when the events are cleared or written.
+    struct TraceBuffer
+    {
+        uint32_t threadId;
+        std::mutex mutex;
+        std::vector<TraceEvent> events;
+    };
+
+    /// All the buffers. The buffer of a thread that has ended is kept
+    /// while it has events, so they are still written, and it is given
+    /// to the next new thread, like the blocks of Metrics. An empty one
+    /// is removed.
+    static std::mutex s_buffersMutex;
+    static std::vector< std::shared_ptr<TraceBuffer> > s_buffers;
+    static std::vector<TraceBuffer *> s_freeBuffers;
+    static uint32_t s_nextThreadId = 1;
+
+    static std::atomic<bool> s_enabled(false);
+
+    /// Remove a buffer from s_buffers, s_buffersMutex must be locked.
+    static void RemoveBuffer(TraceBuffer *buffer)
+    {
+        for (size_t i = 0; i < s_buffers.size(); i++)
+        {
+            if (s_buffers[i].get() == buffer)
+            {
+                s_buffers.erase(s_buffers.begin() + i);
+                return;
+            }
+        }
+    }
+
+    /// The buffer of the current thread, created at the first event and
+    /// released when the thread ends.
+    struct TraceThread
+    {
+        TraceBuffer *buffer;
+
+        TraceThread()
+            : buffer(nullptr)
+        {}
+
+        ~TraceThread()
+        {
+            if (!buffer)
+                return;
+
+            std::lock_guard<std::mutex> lock(s_buffersMutex);
+            bool empty;
+            {
+                std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+                empty = buffer->events.empty();
+            }
+
+            if (empty)
+                RemoveBuffer(buffer);
+            else
+                s_freeBuffers.push_back(buffer);
+        }
+    };
+
+    static thread_local TraceThread t_thread;
+
+    static TraceBuffer& GetThreadBuffer()
+    {
+        if (!t_thread.buffer)
+        {
+            std::lock_guard<std::mutex> lock(s_buffersMutex);
+            if (!s_freeBuffers.empty())
+            {
+                t_thread.buffer = s_freeBuffers.back();
+                s_freeBuffers.pop_back();
+            }
+            else
+            {
+                std::shared_ptr<TraceBuffer> buffer = std::make_shared<TraceBuffer>();
+                buffer->threadId = s_nextThreadId++;
+                s_buffers.push_back(buffer);
+                t_thread.buffer = buffer.get();
+            }
+        }
+
+        return *t_thread.buffer;
+    }
+
+    /// Add a text as a JSON string.
+    static void AppendJsonString(std::string &json, const std::string &text)
+    {
+        json += '"';
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            char c = text[i];
+            if (c == '"' || c == '\\')
+            {
+                json += '\\';
+                json += c;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int)c);
+                json += escaped;
+            }
+            else
+            {
+                json += c;
+            }
+        }
+        json += '"';
+    }
+
+    void Trace::Start()
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_buffersMutex);
+            for (size_t i = 0; i < s_buffers.size(); i++)
+            {
+                std::lock_guard<std::mutex> bufferLock(s_buffers[i]->mutex);
+                s_buffers[i]->events.clear();
+            }
+
+            /// The buffers of the ended threads are now empty.
+            for (size_t i = 0; i < s_freeBuffers.size(); i++)
+                RemoveBuffer(s_freeBuffers[i]);
+            s_freeBuffers.clear();
+        }
+
+        s_enabled.store(true);
+    }
+
+    void Trace::Stop()
+    {
+        s_enabled.store(false);
+    }
+
+    bool Trace::IsEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Trace::Now()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Trace::AddEvent(const char *name, const std::string &fileName, uint64_t start, uint64_t duration)
+    {
+        if (!IsEnabled())
+            return;
+
+        TraceEvent event;
+        event.name = name;
+        event.fileName = fileName;
+        event.start = start;
+        event.duration = duration;
+
+        TraceBuffer &buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events.push_back(event);
+    }
+
+    size_t Trace::GetEventCount()
+    {
+        size_t count = 0;
+
+        std::lock_guard<std::mutex> lock(s_buffersMutex);
+        for (size_t i = 0; i < s_buffers.size(); i++)
+        {
+            std::lock_guard<std::mutex> bufferLock(s_buffers[i]->mutex);
+            count += s_buffers[i]->events.size();
+        }
+
+        return count;
+    }
+
+    std::string Trace::GetJson()
+    {
+        std::string json = "{\"traceEvents\":[";
+        bool first = true;
+        char number[128];
+
+        std::lock_guard<std::mutex> lock(s_buffersMutex);
+        for (size_t i = 0; i < s_buffers.size(); i++)
+        {
+            TraceBuffer &buffer = *s_buffers[i];
+            std::lock_guard<std::mutex> bufferLock(buffer.mutex);
+
+            for (size_t e = 0; e < buffer.events.size(); e++)
+            {
+                const TraceEvent &event = buffer.events[e];
+
+                json += first ? "\n" : ",\n";
+                first = false;
+
+                json += "{\"name\":";
+                AppendJsonString(json, event.name);
+                snprintf(number, sizeof(number), ",\"cat\":\"dfp\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu",
+                    buffer.threadId, (unsigned long long)event.start, (unsigned long long)event.duration);
+                json += number;
+
+                if (!event.fileName.empty())
+                {
+                    json += ",\"args\":{\"file\":";
+                    AppendJsonString(json, event.fileName);
+                    json += "}";
+                }
+                json += "}";
+            }
+        }
+
+        json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return json;
+    }
+
+    ParseResult Trace::WriteJson(const std::string &fileName)
+    {
+        std::string json = GetJson();
+
+        FILE *file = fopen(fileName.c_str(), "wb");
+        if (!file)
+            return ParseResult::ERROR_COULDNT_WRITE;
+
+        size_t written = fwrite(json.data(), 1, json.size(), file);
+        fclose(file);
+
+        if (written != json.size())
+            return ParseResult::ERROR_COULDNT_WRITE;
+
+        return ParseResult::OK;
+    }
+
+
+
+
+    TraceScope::TraceScope(const char *name)
+        : m_name(name)
+        , m_start(Trace::IsEnabled() ? Trace::Now() : 0)
+    {}
+
+    TraceScope::TraceScope(const char *name, const std::string &fileName)
+        : m_name(name)
+        , m_start(Trace::IsEnabled() ? Trace::Now() : 0)
+    {
+        if (m_start)
+            m_fileName = fileName;
+    }
+
+    TraceScope::~TraceScope()
+    {
+        if (m_start && Trace::IsEnabled())
+            Trace::AddEvent(m_name, m_fileName, m_start, Trace::Now() - m_start);
+    }
+
+} //namespace dfp
@@ -0,0 +1,117 @@
+#include "DarkFunctionParser/XmlReader.h"
+
+#ifdef DFP_USE_PUGIXML
+
+#include <pugixml.hpp>
+
+namespace dfp
+{
+    /** Skip the nodes that are not elements (text, comments...) */
+    static pugi::xml_node FirstElement(pugi::xml_node node)
+    {
+        while (node && node.type() != pugi::node_element)
+            node = node.next_sibling();
+        return node;
+    }
+
+    /** A pugi::xml_document, the nodes are pugi::xml_node_struct */
+    class PugiXmlDocument : public XmlDocument
+    {
+    public:
+
+        PugiXmlDocument(const XmlBackend *backend)
+            : m_backend(backend)
+        {}
+
+        virtual bool Parse(const char *text, size_t size)
+        {
+            /// load_buffer makes its own copy of the text.
+            m_result = m_doc.load_buffer(text, size);
+            return (bool)m_result;
+        }
+
+        virtual bool Error() const
+        {
+            return !m_result;
+        }
+
+        virtual std::string GetErrorText() const
+        {
+            return m_result ? std::string() : std::string(m_result.description());
+        }
+
+        virtual XmlNode GetRoot() const
+        {
+            return XmlNode(m_backend, FirstElement(m_doc.first_child()).internal_object());
+        }
+
+    private:
+
+        const XmlBackend *m_backend;
+        pugi::xml_document m_doc;
+        pugi::xml_parse_result m_result;
+    };
+
+    class PugiXmlBackend : public XmlBackend
+    {
+    public:
+
+        virtual const char *GetName() const
+        {
+            return "pugixml";
+        }
+
+        virtual XmlDocument *CreateDocument() const
+        {
+            return new PugiXmlDocument(this);
+        }
+
+        virtual const char *GetNodeName(const void *node) const
+        {
+            return ToNode(node).name();
+        }
+
+        virtual const char *GetAttribute(const void *node, const char *name) const
+        {
+            pugi::xml_attribute attribute = ToNode(node).attribute(name);
+            return attribute ? attribute.value() : nullptr;
+        }
+
+        virtual const void *GetFirstChild(const void *node) const
+        {
+            return FirstElement(ToNode(node).first_child()).internal_object();
+        }
+
+        virtual const void *GetNextSibling(const void *node) const
+        {
+            return FirstElement(ToNode(node).next_sibling()).internal_object();
+        }
+
+    private:
+
+        static pugi::xml_node ToNode(const void *node)
+        {
+            return pugi::xml_node((pugi::xml_node_struct *)node);
+        }
+    };
+
+    const XmlBackend *GetPugiXmlBackend()
+    {
+        static PugiXmlBackend backend;
+        return &backend;
+    }
+
+} //namespace dfp
+
+#else
+
+namespace dfp
+{
+    const XmlBackend *GetPugiXmlBackend()
+    {
+        return nullptr;
+    }
+
+} //namespace dfp
+
+#endif //DFP_USE_PUGIXML
@@ -0,0 +1,136 @@
+#include "DarkFunctionParser/XmlReader.h"
+
+#ifdef DFP_USE_RAPIDXML
+
+#include <rapidxml.hpp>
+
+namespace dfp
+{
+    /** Skip the nodes that are not elements (text, comments...) */
+    static const rapidxml::xml_node<> *FirstElement(const rapidxml::xml_node<> *node)
+    {
+        while (node && node->type() != rapidxml::node_element)
+            node = node->next_sibling();
+        return node;
+    }
+
+    /** A rapidxml::xml_document, the nodes are rapidxml::xml_node */
+    class RapidXmlDocument : public XmlDocument
+    {
+    public:
+
+        RapidXmlDocument(const XmlBackend *backend)
+            : m_backend(backend)
+            , m_error(false)
+        {}
+
+        virtual bool Parse(const char *text, size_t size)
+        {
+            m_doc.clear();
+            m_error = false;
+            m_errorText.clear();
+
+            /// rapidxml parses in place, it needs its own copy with a '\0'.
+            m_text.assign(text, text + size);
+            m_text.push_back('\0');
+
+            try
+            {
+                m_doc.parse<rapidxml::parse_no_data_nodes>(m_text.data());
+            }
+            catch (const rapidxml::parse_error &error)
+            {
+                m_doc.clear();
+                m_error = true;
+                m_errorText = error.what();
+            }
+            return !m_error;
+        }
+
+        virtual bool Error() const
+        {
+            return m_error;
+        }
+
+        virtual std::string GetErrorText() const
+        {
+            return m_errorText;
+        }
+
+        virtual XmlNode GetRoot() const
+        {
+            return XmlNode(m_backend, FirstElement(m_doc.first_node()));
+        }
+
+    private:
+
+        const XmlBackend *m_backend;
+        std::vector<char> m_text;
+        rapidxml::xml_document<> m_doc;
+        bool m_error;
+        std::string m_errorText;
+    };
+
+    class RapidXmlBackend : public XmlBackend
+    {
+    public:
+
+        virtual const char *GetName() const
+        {
+            return "rapidxml";
+        }
+
+        virtual XmlDocument *CreateDocument() const
+        {
+            return new RapidXmlDocument(this);
+        }
+
+        virtual const char *GetNodeName(const void *node) const
+        {
+            return ToNode(node)->name();
+        }
+
+        virtual const char *GetAttribute(const void *node, const char *name) const
+        {
+            const rapidxml::xml_attribute<> *attribute = ToNode(node)->first_attribute(name);
+            return attribute ? attribute->value() : nullptr;
+        }
+
+        virtual const void *GetFirstChild(const void *node) const
+        {
+            return FirstElement(ToNode(node)->first_node());
+        }
+
+        virtual const void *GetNextSibling(const void *node) const
+        {
+            return FirstElement(ToNode(node)->next_sibling());
+        }
+
+    private:
+
+        static const rapidxml::xml_node<> *ToNode(const void *node)
+        {
+            return (const rapidxml::xml_node<> *)node;
+        }
+    };
+
+    const XmlBackend *GetRapidXmlBackend()
+    {
+        static RapidXmlBackend backend;
+        return &backend;
+    }
+
+} //namespace dfp
+
+#else
+
+namespace dfp
+{
+    const XmlBackend *GetRapidXmlBackend()
+    {
+        return nullptr;
+    }
+
+} //namespace dfp
+
+#endif //DFP_USE_RAPIDXML
@@ -0,0 +1,913 @@
+#include "DarkFunctionParser/XmlReader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
+namespace dfp
+{
+    std::vector<const XmlBackend *> GetXmlBackends()
+    {
+        std::vector<const XmlBackend *> backends;
+        const XmlBackend *all[] = { GetTinyXml2Backend(), GetScannerBackend(), GetPugiXmlBackend(), GetRapidXmlBackend() };
+        for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++)
+        {
+            if (all[i])
+                backends.push_back(all[i]);
+        }
+        return backends;
+    }
+
+    const XmlBackend *FindXmlBackend(const std::string &name)
+    {
+        std::vector<const XmlBackend *> backends = GetXmlBackends();
+        for (size_t i = 0; i < backends.size(); i++)
+        {
+            if (name == backends[i]->GetName())
+                return backends[i];
+        }
+        return nullptr;
+    }
+
+    /** The selected backend, nullptr for the default one */
+    static std::atomic<const XmlBackend *> s_backend(nullptr);
+
+    void SetXmlBackend(const XmlBackend *backend)
+    {
+        s_backend.store(backend);
+    }
+
+    const XmlBackend *GetXmlBackend()
+    {
+        const XmlBackend *backend = s_backend.load();
+        if (backend)
+            return backend;
+
+        backend = GetTinyXml2Backend();
+        return backend ? backend : GetScannerBackend();
+    }
+
+
+
+    /** The built-in parser. The text is copied once, the names and the
+    * values are ended with a '\0' in the copy and the nodes are stored in
+    * a flat array, so a document is 3 allocations. */
+    class ScannerDocument : public XmlDocument
+    {
+    public:
+
+        static const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+        struct Attr
+        {
+            const char *name;
+            const char *value;
+        };
+
+        struct Node
+        {
+            const ScannerDocument *doc;
+            const char *name;
+            uint32_t firstAttr;
+            uint32_t attrCount;
+            uint32_t firstChild;
+            uint32_t nextSibling;
+        };
+
+        ScannerDocument()
+            : m_error(false)
+        {}
+
+        virtual bool Parse(const char *text, size_t size);
+
+        virtual bool Error() const
+        {
+            return m_error;
+        }
+
+        virtual std::string GetErrorText() const
+        {
+            return m_errorText;
+        }
+
+        virtual XmlNode GetRoot() const
+        {
+            if (m_nodes.empty())
+                return XmlNode();
+            return XmlNode(GetScannerBackend(), &m_nodes[0]);
+        }
+
+        const Node *GetNode(uint32_t index) const
+        {
+            return index == INVALID_INDEX ? nullptr : &m_nodes[index];
+        }
+
+        const Attr *GetAttr(uint32_t index) const
+        {
+            return &m_attrs[index];
+        }
+
+    private:
+
+        /** Stop with an error at the position p */
+        bool Fail(const char *p, const char *message);
+
+        /** Skip to the end of a markup, after the terminator.
+        * @return nullptr if the terminator is not found */
+        const char *SkipTo(const char *p, const char *terminator) const;
+
+        std::vector<char> m_text;
+        std::vector<Node> m_nodes;
+        std::vector<Attr> m_attrs;
+        bool m_error;
+        std::string m_errorText;
+    };
+
+    const uint32_t ScannerDocument::INVALID_INDEX;
+
+    static bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    bool ScannerDocument::Fail(const char *p, const char *message)
+    {
+        uint32_t line = 1;
+        for (const char *c = m_text.data(); c < p; c++)
+        {
+            if (*c == '\n')
+                line++;
+        }
+
+        std::ostringstream ss;
+        ss << message << " at line " << line;
+
+        m_error = true;
+        m_errorText = ss.str();
+        m_nodes.clear();
+        m_attrs.clear();
+        return false;
+    }
+
+    const char *ScannerDocument::SkipTo(const char *p, const char *terminator) const
+    {
+        const char *end = m_text.data() + m_text.size() - 1;
+        size_t length = strlen(terminator);
+        for (; p + length <= end; p++)
+        {
+            if (memcmp(p, terminator, length) == 0)
+                return p + length;
+        }
+        return nullptr;
+    }
+
+    /// Read a name, it ends at a space, '=', '/' or '>'.
+    static char *ReadName(char *p)
+    {
+        while (*p && !IsSpace(*p) && *p != '=' && *p != '/' && *p != '>')
+            p++;
+        return p;
+    }
+
+    static char *EncodeUtf8(char *out, uint32_t code)
+    {
+        if (code < 0x80)
+        {
+            *out++ = (char)code;
+        }
+        else if (code < 0x800)
+        {
+            *out++ = (char)(0xC0 | (code >> 6));
+            *out++ = (char)(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000)
+        {
+            *out++ = (char)(0xE0 | (code >> 12));
+            *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+            *out++ = (char)(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            *out++ = (char)(0xF0 | (code >> 18));
+            *out++ = (char)(0x80 | ((code >> 12) & 0x3F));
+            *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+            *out++ = (char)(0x80 | (code & 0x3F));
+        }
+        return out;
+    }
+
+    /// Decode the entities of [begin, end) in place.
+    /// @return the new end, or nullptr if an entity is not valid.
+    static char *DecodeEntities(char *begin, char *end)
+    {
+        static const struct
+        {
+            const char *name;
+            size_t length;
+            char value;
+        } entities[] = {
+            { "lt;", 3, '<' }, { "gt;", 3, '>' }, { "amp;", 4, '&' },
+            { "quot;", 5, '"' }, { "apos;", 5, '\'' },
+        };
+
+        char *out = begin;
+        for (char *in = begin; in < end;)
+        {
+            if (*in != '&')
+            {
+                *out++ = *in++;
+                continue;
+            }
+            in++;
+
+            if (*in == '#')
+            {
+                /// A character reference, &#123; or &#x7B;
+                in++;
+                int base = 10;
+                if (*in == 'x')
+                {
+                    base = 16;
+                    in++;
+                }
+
+                uint32_t code = 0;
+                char *digits = in;
+                for (; in < end && *in != ';'; in++)
+                {
+                    uint32_t digit;
+                    if (*in >= '0' && *in <= '9')
+                        digit = *in - '0';
+                    else if (base == 16 && *in >= 'a' && *in <= 'f')
+                        digit = *in - 'a' + 10;
+                    else if (base == 16 && *in >= 'A' && *in <= 'F')
+                        digit = *in - 'A' + 10;
+                    else
+                        return nullptr;
+
+                    code = code * base + digit;
+                    if (code > 0x10FFFF)
+                        return nullptr;
+                }
+
+                if (in == end || in == digits)
+                    return nullptr;
+                in++;
+
+                /// The UTF-8 encoding is never longer than the reference.
+                out = EncodeUtf8(out, code);
+                continue;
+            }
+
+            size_t i = 0;
+            size_t count = sizeof(entities) / sizeof(entities[0]);
+            for (; i < count; i++)
+            {
+                if ((size_t)(end - in) >= entities[i].length && memcmp(in, entities[i].name, entities[i].length) == 0)
+                    break;
+            }
+            if (i == count)
+                return nullptr;
+
+            *out++ = entities[i].value;
+            in += entities[i].length;
+        }
+        return out;
+    }
+
+    /// What ReadTagPart found in a start tag.
+    enum TagPart
+    {
+        TAG_ATTRIBUTE,      ///< An attribute, in name and value
+        TAG_END,            ///< The '>' of the tag
+        TAG_END_CLOSED,     ///< The '/>' of an empty element
+        TAG_UNTERMINATED,   ///< The end of the text, before the end of the tag
+        TAG_ERROR,          ///< A broken attribute, the message is in error
+    };
+
+    /// Read the next attribute of a start tag, or its end. The name and
+    /// the value are ended with a '\0' in place and the entities of the
+    /// value are decoded. Used by ScannerDocument and XmlStreamReader.
+    /// @param c is the position in the tag, it is moved after the part
+    ///        read, or to the error.
+    /// @param end is the end of the text, *end must be a '\0'.
+    static TagPart ReadTagPart(char *&c, char *end, const char *&name, const char *&value, const char *&error)
+    {
+        while (IsSpace(*c))
+            c++;
+
+        if (*c == '/' && c[1] == '>')
+        {
+            c += 2;
+            return TAG_END_CLOSED;
+        }
+        if (*c == '>')
+        {
+            c++;
+            return TAG_END;
+        }
+        if (c >= end)
+            return TAG_UNTERMINATED;
+
+        char *attrName = c;
+        char *attrNameEnd = ReadName(c);
+        if (attrNameEnd == attrName)
+        {
+            error = "Malformed attribute";
+            return TAG_ERROR;
+        }
+        c = attrNameEnd;
+        while (IsSpace(*c))
+            c++;
+        if (*c != '=')
+        {
+            error = "Attribute without value";
+            return TAG_ERROR;
+        }
+        c++;
+        while (IsSpace(*c))
+            c++;
+        if (*c != '"' && *c != '\'')
+        {
+            error = "Attribute value without quotes";
+            return TAG_ERROR;
+        }
+
+        char quote = *c++;
+        char *attrValue = c;
+        char *valueEnd = (char *)memchr(c, quote, end - c);
+        if (!valueEnd)
+        {
+            error = "Unterminated attribute value";
+            return TAG_ERROR;
+        }
+        c = valueEnd + 1;
+
+        char *decodedEnd = DecodeEntities(attrValue, valueEnd);
+        if (!decodedEnd)
+        {
+            c = attrValue;
+            error = "Invalid entity";
+            return TAG_ERROR;
+        }
+
+        /// The terminators are already read, they can be replaced.
+        *attrNameEnd = '\0';
+        *decodedEnd = '\0';
+
+        name = attrName;
+        value = attrValue;
+        return TAG_ATTRIBUTE;
+    }
+
+    bool ScannerDocument::Parse(const char *text, size_t size)
+    {
+        m_error = false;
+        m_errorText.clear();
+        m_nodes.clear();
+        m_attrs.clear();
+
+        m_text.assign(text, text + size);
+        m_text.push_back('\0');
+
+        /// A guess to avoid most of the reallocations.
+        m_nodes.reserve(size / 48 + 1);
+        m_attrs.reserve(size / 12 + 1);
+
+        /// The open elements, and the last child of each one.
+        std::vector<uint32_t> open;
+        std::vector<uint32_t> lastChild;
+        uint32_t lastRoot = INVALID_INDEX;
+
+        char *p = m_text.data();
+        char *end = p + size;
+        while (p < end)
+        {
+            if (*p != '<')
+            {
+                /// The text content is not used.
+                p = (char *)memchr(p, '<', end - p);
+                if (!p)
+                    break;
+                continue;
+            }
+
+            if (p[1] == '?' || p[1] == '!')
+            {
+                const char *next;
+                if (p[1] == '?')
+                    next = SkipTo(p, "?>");
+                else if (strncmp(p, "<!--", 4) == 0)
+                    next = SkipTo(p + 4, "-->");
+                else if (strncmp(p, "<![CDATA[", 9) == 0)
+                    next = SkipTo(p, "]]>");
+                else
+                    next = SkipTo(p, ">");
+
+                if (!next)
+                    return Fail(p, "Unterminated markup");
+                p = (char *)next;
+                continue;
+            }
+
+            if (p[1] == '/')
+            {
+                /// The end of an element.
+                char *name = p + 2;
+                char *nameEnd = ReadName(name);
+                char *c = nameEnd;
+                while (IsSpace(*c))
+                    c++;
+                if (*c != '>')
+                    return Fail(p, "Malformed end tag");
+                if (open.empty())
+                    return Fail(p, "End tag without start tag");
+
+                const char *openName = m_nodes[open.back()].name;
+                size_t length = nameEnd - name;
+                if (strncmp(openName, name, length) != 0 || openName[length] != '\0')
+                    return Fail(p, "Mismatched end tag");
+
+                open.pop_back();
+                lastChild.pop_back();
+                p = c + 1;
+                continue;
+            }
+
+            /// The start of an element.
+            char *name = p + 1;
+            char *nameEnd = ReadName(name);
+            if (nameEnd == name)
+                return Fail(p, "Element without name");
+            if (m_nodes.size() >= INVALID_INDEX - 1)
+                return Fail(p, "Too many elements");
+
+            uint32_t index = (uint32_t)m_nodes.size();
+            Node node;
+            node.doc = this;
+            node.name = name;
+            node.firstAttr = (uint32_t)m_attrs.size();
+            node.attrCount = 0;
+            node.firstChild = INVALID_INDEX;
+            node.nextSibling = INVALID_INDEX;
+
+            /// The attributes.
+            char *c = nameEnd;
+            bool closed = false;
+            for (;;)
+            {
+                Attr attr;
+                const char *error = nullptr;
+                TagPart part = ReadTagPart(c, end, attr.name, attr.value, error);
+                if (part == TAG_END || part == TAG_END_CLOSED)
+                {
+                    closed = (part == TAG_END_CLOSED);
+                    break;
+                }
+                if (part == TAG_UNTERMINATED)
+                    return Fail(p, "Unterminated start tag");
+                if (part == TAG_ERROR)
+                    return Fail(c, error);
+
+                m_attrs.push_back(attr);
+                node.attrCount++;
+            }
+            *nameEnd = '\0';
+
+            /// Link the node to its parent.
+            if (open.empty())
+            {
+                if (lastRoot != INVALID_INDEX)
+                    m_nodes[lastRoot].nextSibling = index;
+                lastRoot = index;
+            }
+            else
+            {
+                uint32_t &last = lastChild.back();
+                if (last == INVALID_INDEX)
+                    m_nodes[open.back()].firstChild = index;
+                else
+                    m_nodes[last].nextSibling = index;
+                last = index;
+            }
+            m_nodes.push_back(node);
+
+            if (!closed)
+            {
+                open.push_back(index);
+                lastChild.push_back(INVALID_INDEX);
+            }
+            p = c;
+        }
+
+        if (!open.empty())
+            return Fail(end, "Unterminated element");
+        if (m_nodes.empty())
+            return Fail(end, "No root element");
+
+        return true;
+    }
+
+    /** The backend of ScannerDocument, a node is a ScannerDocument::Node */
+    class ScannerBackend : public XmlBackend
+    {
+    public:
+
+        virtual const char *GetName() const
+        {
+            return "scanner";
+        }
+
+        virtual XmlDocument *CreateDocument() const
+        {
+            return new ScannerDocument();
+        }
+
+        virtual const char *GetNodeName(const void *node) const
+        {
+            return ((const ScannerDocument::Node *)node)->name;
+        }
+
+        virtual const char *GetAttribute(const void *node, const char *name) const
+        {
+            const ScannerDocument::Node *n = (const ScannerDocument::Node *)node;
+            for (uint32_t i = 0; i < n->attrCount; i++)
+            {
+                const ScannerDocument::Attr *attr = n->doc->GetAttr(n->firstAttr + i);
+                if (strcmp(attr->name, name) == 0)
+                    return attr->value;
+            }
+            return nullptr;
+        }
+
+        virtual const void *GetFirstChild(const void *node) const
+        {
+            const ScannerDocument::Node *n = (const ScannerDocument::Node *)node;
+            return n->doc->GetNode(n->firstChild);
+        }
+
+        virtual const void *GetNextSibling(const void *node) const
+        {
+            const ScannerDocument::Node *n = (const ScannerDocument::Node *)node;
+            return n->doc->GetNode(n->nextSibling);
+        }
+    };
+
+    const XmlBackend *GetScannerBackend()
+    {
+        static ScannerBackend backend;
+        return &backend;
+    }
+
+
+
+
+    /** The backend of the nodes given by XmlStreamReader to its handler.
+    * A node is the reader itself, it has no child and no sibling. It is
+    * not in GetXmlBackends, it can not create a document. */
+    class StreamNodeBackend : public XmlBackend
+    {
+    public:
+
+        virtual const char *GetName() const
+        {
+            return "stream";
+        }
+
+        virtual XmlDocument *CreateDocument() const
+        {
+            return nullptr;
+        }
+
+        virtual const char *GetNodeName(const void *node) const
+        {
+            return ((const XmlStreamReader *)node)->m_tag.c_str();
+        }
+
+        virtual const char *GetAttribute(const void *node, const char *name) const
+        {
+            const std::vector<const char *> &attrs = ((const XmlStreamReader *)node)->m_attrs;
+            for (size_t i = 0; i + 1 < attrs.size(); i += 2)
+            {
+                if (strcmp(attrs[i], name) == 0)
+                    return attrs[i + 1];
+            }
+            return nullptr;
+        }
+
+        virtual const void *GetFirstChild(const void *) const
+        {
+            return nullptr;
+        }
+
+        virtual const void *GetNextSibling(const void *) const
+        {
+            return nullptr;
+        }
+    };
+
+    static StreamNodeBackend s_streamNodeBackend;
+
+    const size_t XmlStreamReader::MAX_TAG_SIZE;
+
+    XmlStreamReader::XmlStreamReader()
+    {
+        Reset();
+    }
+
+    void XmlStreamReader::Reset()
+    {
+        m_state = STATE_TEXT;
+        m_tag.clear();
+        m_attrs.clear();
+        m_quote = 0;
+        m_terminator = "";
+        m_matched = 0;
+        m_openNames.clear();
+        m_openStart.clear();
+        m_line = 1;
+        m_markupLine = 1;
+        m_hasRoot = false;
+        m_stopped = false;
+        m_error = false;
+        m_errorText.clear();
+    }
+
+    bool XmlStreamReader::Error() const
+    {
+        return m_error;
+    }
+
+    std::string XmlStreamReader::GetErrorText() const
+    {
+        return m_errorText;
+    }
+
+    bool XmlStreamReader::Fail(const char *message)
+    {
+        std::ostringstream ss;
+        ss << message << " at line " << m_markupLine;
+
+        m_stopped = true;
+        m_error = true;
+        m_errorText = ss.str();
+        return false;
+    }
+
+    /// The number of chars of a terminator that are matched after one more
+    /// char, like in a KMP search ("--" then '-' is still "--").
+    static size_t MatchTerminator(const char *terminator, size_t matched, char c)
+    {
+        for (size_t length = matched + 1; length > 0; length--)
+        {
+            if (terminator[length - 1] == c && memcmp(terminator, terminator + matched + 1 - length, length - 1) == 0)
+                return length;
+        }
+        return 0;
+    }
+
+    bool XmlStreamReader::Feed(const char *data, size_t size, XmlStreamHandler &handler)
+    {
+        if (m_stopped)
+            return false;
+
+        const char *p = data;
+        const char *end = data + size;
+        while (p < end)
+        {
+            if (m_state == STATE_TEXT)
+            {
+                /// The text content is not used.
+                const char *next = (const char *)memchr(p, '<', end - p);
+                const char *stop = next ? next : end;
+                for (; p < stop; p++)
+                {
+                    if (*p == '\n')
+                        m_line++;
+                }
+                if (!next)
+                    break;
+
+                p++;
+                m_markupLine = m_line;
+                m_tag.clear();
+                m_state = STATE_MARKUP;
+            }
+            else if (m_state == STATE_MARKUP)
+            {
+                /// Find the kind of markup from its first chars.
+                char c = *p;
+                if (m_tag.empty() && c == '?')
+                {
+                    m_terminator = "?>";
+                    m_matched = 1;
+                    m_state = STATE_SKIP;
+                    p++;
+                    continue;
+                }
+                if (m_tag.empty() && c != '!')
+                {
+                    m_quote = 0;
+                    m_state = STATE_TAG;
+                    continue;
+                }
+
+                m_tag += c;
+                if (c == '\n')
+                    m_line++;
+                p++;
+
+                static const char comment[] = "!--";
+                static const char cdata[] = "![CDATA[";
+                if (m_tag == comment)
+                {
+                    m_terminator = "-->";
+                    m_matched = 0;
+                    m_state = STATE_SKIP;
+                }
+                else if (m_tag == cdata)
+                {
+                    m_terminator = "]]>";
+                    m_matched = 0;
+                    m_state = STATE_SKIP;
+                }
+                else if (m_tag.compare(0, m_tag.size(), comment, std::min(m_tag.size(), sizeof(comment) - 1)) != 0
+                    && m_tag.compare(0, m_tag.size(), cdata, std::min(m_tag.size(), sizeof(cdata) - 1)) != 0)
+                {
+                    /// A declaration (<!DOCTYPE ...>), without DTD.
+                    if (c == '>')
+                        m_state = STATE_TEXT;
+                    else
+                    {
+                        m_terminator = ">";
+                        m_matched = 0;
+                        m_state = STATE_SKIP;
+                    }
+                }
+            }
+            else if (m_state == STATE_SKIP)
+            {
+                size_t length = strlen(m_terminator);
+                for (; p < end && m_matched < length; p++)
+                {
+                    if (*p == '\n')
+                        m_line++;
+                    m_matched = MatchTerminator(m_terminator, m_matched, *p);
+                }
+                if (m_matched == length)
+                    m_state = STATE_TEXT;
+            }
+            else
+            {
+                /// Find the '>' of the tag. In a start tag, a '>' can be
+                /// in the value of an attribute.
+                bool isEndTag = !m_tag.empty() ? m_tag[0] == '/' : *p == '/';
+                const char *c = p;
+                bool complete = false;
+                for (; c < end; c++)
+                {
+                    if (*c == '\n')
+                        m_line++;
+                    else if (m_quote)
+                    {
+                        if (*c == m_quote)
+                            m_quote = 0;
+                    }
+                    else if (*c == '>')
+                    {
+                        complete = true;
+                        c++;
+                        break;
+                    }
+                    else if ((*c == '"' || *c == '\'') && !isEndTag)
+                        m_quote = *c;
+                }
+
+                m_tag.append(p, c);
+                p = c;
+                if (m_tag.size() > MAX_TAG_SIZE)
+                    return Fail("Tag too long");
+
+                if (complete)
+                {
+                    m_state = STATE_TEXT;
+                    if (!ProcessTag(handler))
+                        return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool XmlStreamReader::ProcessTag(XmlStreamHandler &handler)
+    {
+        char *p = &m_tag[0];
+        char *end = p + m_tag.size();
+
+        if (*p == '/')
+        {
+            /// The end of an element.
+            char *name = p + 1;
+            char *nameEnd = ReadName(name);
+            char *c = nameEnd;
+            while (IsSpace(*c))
+                c++;
+            if (*c != '>')
+                return Fail("Malformed end tag");
+            if (m_openStart.empty())
+                return Fail("End tag without start tag");
+
+            size_t start = m_openStart.back();
+            size_t length = nameEnd - name;
+            if (m_openNames.size() - start != length || m_openNames.compare(start, length, name, length) != 0)
+                return Fail("Mismatched end tag");
+
+            m_openNames.resize(start);
+            m_openStart.pop_back();
+
+            if (!handler.OnEndElement(m_openStart.size()))
+            {
+                m_stopped = true;
+                return false;
+            }
+            return true;
+        }
+
+        /// The start of an element.
+        char *nameEnd = ReadName(p);
+        if (nameEnd == p)
+            return Fail("Element without name");
+
+        m_attrs.clear();
+        char *c = nameEnd;
+        bool closed = false;
+        for (;;)
+        {
+            const char *name = nullptr;
+            const char *value = nullptr;
+            const char *error = nullptr;
+            TagPart part = ReadTagPart(c, end, name, value, error);
+            if (part == TAG_END || part == TAG_END_CLOSED)
+            {
+                closed = (part == TAG_END_CLOSED);
+                break;
+            }
+            if (part == TAG_UNTERMINATED)
+                return Fail("Malformed start tag");
+            if (part == TAG_ERROR)
+                return Fail(error);
+
+            m_attrs.push_back(name);
+            m_attrs.push_back(value);
+        }
+        if (c != end)
+            return Fail("Malformed start tag");
+        *nameEnd = '\0';
+
+        size_t depth = m_openStart.size();
+        m_hasRoot = true;
+
+        if (!handler.OnStartElement(XmlNode(&s_streamNodeBackend, this), depth))
+        {
+            m_stopped = true;
+            return false;
+        }
+
+        if (closed)
+        {
+            if (!handler.OnEndElement(depth))
+            {
+                m_stopped = true;
+                return false;
+            }
+        }
+        else
+        {
+            m_openStart.push_back(m_openNames.size());
+            m_openNames.append(p, nameEnd);
+        }
+        return true;
+    }
+
+    bool XmlStreamReader::Finish()
+    {
+        if (m_stopped)
+            return false;
+
+        if (m_state != STATE_TEXT)
+            return Fail("Unterminated markup");
+
+        m_markupLine = m_line;
+        if (!m_openStart.empty())
+            return Fail("Unterminated element");
+        if (!m_hasRoot)
+            return Fail("No root element");
+
+        m_stopped = true;
+        return true;
+    }
+
+} //namespace dfp
@@ -0,0 +1,109 @@
+#include "DarkFunctionParser/XmlReader.h"
+
+#ifndef DFP_NO_TINYXML2
+
+#if defined(I3D_PLATFORM_S3E)
+#include "tinyxml.h"
+#else
+#include <tinyxml2/tinyxml2.h>
+#endif
+
+namespace dfp
+{
+    /** A tinyxml2::XMLDocument, the nodes are tinyxml2::XMLElement */
+    class TinyXml2Document : public XmlDocument
+    {
+    public:
+
+        TinyXml2Document(const XmlBackend *backend)
+            : m_backend(backend)
+        {}
+
+        virtual bool Parse(const char *text, size_t size)
+        {
+            /// tinyxml2 has its own copy of the text.
+            m_doc.Parse(text, size);
+            return !m_doc.Error();
+        }
+
+        virtual bool Error() const
+        {
+            return m_doc.Error();
+        }
+
+        virtual std::string GetErrorText() const
+        {
+            std::string text;
+            if (m_doc.GetErrorStr1())
+                text = m_doc.GetErrorStr1();
+            if (m_doc.GetErrorStr2())
+                text += m_doc.GetErrorStr2();
+            return text;
+        }
+
+        virtual XmlNode GetRoot() const
+        {
+            return XmlNode(m_backend, m_doc.FirstChildElement());
+        }
+
+    private:
+
+        const XmlBackend *m_backend;
+        tinyxml2::XMLDocument m_doc;
+    };
+
+    class TinyXml2Backend : public XmlBackend
+    {
+    public:
+
+        virtual const char *GetName() const
+        {
+            return "tinyxml2";
+        }
+
+        virtual XmlDocument *CreateDocument() const
+        {
+            return new TinyXml2Document(this);
+        }
+
+        virtual const char *GetNodeName(const void *node) const
+        {
+            return ((const tinyxml2::XMLElement *)node)->Value();
+        }
+
+        virtual const char *GetAttribute(const void *node, const char *name) const
+        {
+            return ((const tinyxml2::XMLElement *)node)->Attribute(name);
+        }
+
+        virtual const void *GetFirstChild(const void *node) const
+        {
+            return ((const tinyxml2::XMLElement *)node)->FirstChildElement();
+        }
+
+        virtual const void *GetNextSibling(const void *node) const
+        {
+            return ((const tinyxml2::XMLElement *)node)->NextSiblingElement();
+        }
+    };
+
+    const XmlBackend *GetTinyXml2Backend()
+    {
+        static TinyXml2Backend backend;
+        return &backend;
+    }
+
+} //namespace dfp
+
+#else
+
+namespace dfp
+{
+    const XmlBackend *GetTinyXml2Backend()
+    {
+        return nullptr;
+    }
+
+} //namespace dfp
+
+#endif //DFP_NO_TINYXML2
@@ -0,0 +1,66 @@
+/** dfp-bundle
+* Packs many *.sprites and *.anim files in one bundle file (see
+* DarkFunctionParser/Bundle.h).
+*
+* Usage:
+*   dfp-bundle -o assets.dfpb [-z] [-r data/] data/chars/hero.anim data/chars/hero.sprites ...
+*
+*   -z       compress the entries with LZ4 (if the library is built with DFP_USE_LZ4)
+*   -r root  remove this prefix from the file names to make the logical paths
+*            (data/chars/hero.anim => chars/hero.anim)*/
+
+#include "DarkFunctionParser/Bundle.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    std::string outputFileName;
+    std::string root;
+    bool compress = false;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outputFileName = argv[++i];
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            root = argv[++i];
+        else if (strcmp(argv[i], "-z") == 0)
+            compress = true;
+        else
+            inputs.push_back(argv[i]);
+    }
+
+    if (outputFileName.empty() || inputs.empty())
+    {
+        printf("Usage: dfp-bundle -o <output.dfpb> [-z] [-r <root>] <files> ...\n");
+        return 1;
+    }
+
+    dfp::BundleWriter writer;
+    for (const auto& input : inputs)
+    {
+        std::string path = input;
+        if (!root.empty() && path.compare(0, root.size(), root) == 0)
+            path = path.substr(root.size());
+
+        if (writer.AddFile(path, input) != dfp::ParseResult::OK)
+        {
+            fprintf(stderr, "dfp-bundle: %s\n", writer.GetErrorText().c_str());
+            return 1;
+        }
+    }
+
+    if (writer.Write(outputFileName, compress) != dfp::ParseResult::OK)
+    {
+        fprintf(stderr, "dfp-bundle: %s\n", writer.GetErrorText().c_str());
+        return 1;
+    }
+
+    printf("dfp-bundle: %d files written to %s\n", (int)inputs.size(), outputFileName.c_str());
+    return 0;
+}
@@ -0,0 +1,371 @@
+/** dfp-embed
+* Reads *.sprites and *.anim files with the DarkFunctionParser library and
+* writes a C++ header with constexpr tables (see DarkFunctionParser/Embedded.h).
+* The generated header does not need tinyxml2 or the parser at run time.
+*
+* Usage:
+*   dfp-embed -o assets.h [-n namespace] hero.anim items.sprites ...
+*
+* For each *.anim file, the sprite sheet from the attribute 'spriteSheet'
+* is embedded too, and each cell sprite is linked to its sprite index.*/
+
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Hash.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <sstream>
+
+namespace
+{
+    /** One sprite sheet to write */
+    struct SheetOut
+    {
+        std::string fileName;
+        std::string symbol;
+        std::shared_ptr<dfp::Sprite> sprite;
+
+        /** (hash, path, Spr) sorted by hash */
+        std::vector< std::pair<std::string, std::shared_ptr<dfp::Spr> > > spr;
+    };
+
+    /** One animations file to write */
+    struct AnimationsOut
+    {
+        std::string fileName;
+        std::string symbol;
+        std::shared_ptr<dfp::Animations> animations;
+
+        /** The index in the sheets vector OR -1 */
+        int sheet;
+    };
+
+    std::string GetExtension(const std::string& fileName)
+    {
+        size_t dot = fileName.find_last_of('.');
+        if (dot == std::string::npos)
+            return "";
+
+        return fileName.substr(dot + 1);
+    }
+
+    /** Make a C++ identifier from a file name: "data/hero.anim" => "hero_anim" */
+    std::string MakeSymbol(const std::string& fileName)
+    {
+        size_t slash = fileName.find_last_of("/\\");
+        std::string name = (slash == std::string::npos) ? fileName : fileName.substr(slash + 1);
+
+        std::string symbol;
+        for (char c : name)
+        {
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+                symbol += c;
+            else
+                symbol += '_';
+        }
+
+        if (symbol.empty() || (symbol[0] >= '0' && symbol[0] <= '9'))
+            symbol = "_" + symbol;
+
+        return symbol;
+    }
+
+    /** Make a C++ string literal. The other control characters are written
+    * as 3 digit octal escapes (a hex escape would take the digits after
+    * it), and '?' is escaped so "??=" is not a trigraph. */
+    std::string Quote(const std::string& text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            switch (c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '?': out += "\\?"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20 || c == 0x7f)
+                {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\%03o", (unsigned char)c);
+                    out += buffer;
+                }
+                else
+                    out += c;
+            }
+        }
+        out += "\"";
+        return out;
+    }
+
+    std::string Hex(uint32_t value)
+    {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "0x%08Xu", value);
+        return buffer;
+    }
+
+    bool ByHash(const std::pair<std::string, std::shared_ptr<dfp::Spr> >& a,
+        const std::pair<std::string, std::shared_ptr<dfp::Spr> >& b)
+    {
+        return dfp::HashPath(a.first) < dfp::HashPath(b.first);
+    }
+
+    /** Load a sheet, or return the index of the one already loaded */
+    int AddSheet(std::vector<SheetOut>& sheets, const std::string& fileName)
+    {
+        for (size_t i = 0; i < sheets.size(); i++)
+            if (sheets[i].fileName == fileName)
+                return (int)i;
+
+        SheetOut sheet;
+        sheet.fileName = fileName;
+        sheet.symbol = MakeSymbol(fileName);
+        sheet.sprite = std::make_shared<dfp::Sprite>();
+
+        dfp::ParseResult result = sheet.sprite->ParseFile(fileName);
+        if (result != dfp::ParseResult::OK)
+        {
+            fprintf(stderr, "dfp-embed: cannot parse '%s' (error %d) %s\n", fileName.c_str(), (int)result, sheet.sprite->GetErrorText().c_str());
+            return -1;
+        }
+
+        sheet.spr = sheet.sprite->GetAllSprWithPath();
+        std::sort(sheet.spr.begin(), sheet.spr.end(), ByHash);
+
+        for (size_t i = 1; i < sheet.spr.size(); i++)
+        {
+            if (dfp::HashPath(sheet.spr[i].first) == dfp::HashPath(sheet.spr[i - 1].first))
+            {
+                fprintf(stderr, "dfp-embed: '%s': hash collision between '%s' and '%s'\n", fileName.c_str(),
+                    sheet.spr[i].first.c_str(), sheet.spr[i - 1].first.c_str());
+                return -1;
+            }
+        }
+
+        sheets.push_back(sheet);
+        return (int)sheets.size() - 1;
+    }
+
+    void WriteSheet(std::ostream& out, const SheetOut& sheet)
+    {
+        out << "    // " << sheet.fileName << "\n";
+        if (!sheet.spr.empty())
+        {
+            out << "    static constexpr dfp::embedded::SprRect " << sheet.symbol << "_spr[] =\n    {\n";
+            for (const auto& item : sheet.spr)
+            {
+                out << "        { " << Hex(dfp::HashPath(item.first)) << ", " << Quote(item.first) << ", "
+                    << item.second->GetX() << ", " << item.second->GetY() << ", "
+                    << item.second->GetW() << ", " << item.second->GetH() << " },\n";
+            }
+            out << "    };\n";
+        }
+
+        out << "    static constexpr dfp::embedded::SpriteSheet " << sheet.symbol << " =\n    {\n"
+            << "        " << Quote(sheet.sprite->GetImageFileName(true)) << ", "
+            << sheet.sprite->GetImageW() << ", " << sheet.sprite->GetImageH() << ",\n"
+            << "        " << (sheet.spr.empty() ? "nullptr" : sheet.symbol + "_spr") << ", " << sheet.spr.size() << "\n"
+            << "    };\n\n";
+    }
+
+    bool WriteAnimations(std::ostream& out, const AnimationsOut& anims, const std::vector<SheetOut>& sheets)
+    {
+        std::map<std::string, uint32_t> sprIndex;
+        if (anims.sheet >= 0)
+        {
+            const SheetOut& sheet = sheets[anims.sheet];
+            for (size_t i = 0; i < sheet.spr.size(); i++)
+                sprIndex[sheet.spr[i].first] = (uint32_t)i;
+        }
+
+        /// Sort the anims by hash, and check for collisions.
+        std::vector< std::pair<uint32_t, std::shared_ptr<dfp::Anim> > > sorted;
+        for (const auto& item : anims.animations->GetAnims())
+            sorted.push_back(std::make_pair(dfp::HashPath(item.first), item.second));
+
+        std::sort(sorted.begin(), sorted.end(),
+            [](const std::pair<uint32_t, std::shared_ptr<dfp::Anim> >& a, const std::pair<uint32_t, std::shared_ptr<dfp::Anim> >& b)
+            { return a.first < b.first; });
+
+        for (size_t i = 1; i < sorted.size(); i++)
+        {
+            if (sorted[i].first == sorted[i - 1].first)
+            {
+                fprintf(stderr, "dfp-embed: '%s': hash collision between '%s' and '%s'\n", anims.fileName.c_str(),
+                    sorted[i].second->GetName().c_str(), sorted[i - 1].second->GetName().c_str());
+                return false;
+            }
+        }
+
+        std::ostringstream animText, cellText, cellSprText;
+        uint32_t cellCount = 0;
+        uint32_t cellSprCount = 0;
+
+        for (const auto& item : sorted)
+        {
+            const std::shared_ptr<dfp::Anim>& anim = item.second;
+            const std::vector< std::shared_ptr<dfp::Cell> >& cells = anim->GetCells();
+
+            animText << "        { " << Hex(item.first) << ", " << Quote(anim->GetName()) << ", "
+                << anim->GetLoops() << ", " << cellCount << ", " << cells.size() << " },\n";
+
+            for (const auto& cell : cells)
+            {
+                const std::vector< std::shared_ptr<dfp::CellSpr> >& cellsSpr = cell->GetCellsSpr();
+
+                cellText << "        { " << cell->GetIndex() << ", " << cell->GetDelay() << ", "
+                    << cellSprCount << ", " << cellsSpr.size() << " },\n";
+
+                for (const auto& cellSpr : cellsSpr)
+                {
+                    auto it = sprIndex.find(cellSpr->GetName());
+                    std::string index = (it == sprIndex.end()) ? "dfp::embedded::INVALID_INDEX" : std::to_string(it->second);
+
+                    cellSprText << "        { " << Quote(cellSpr->GetName()) << ", " << index << ", "
+                        << cellSpr->GetX() << ", " << cellSpr->GetY() << ", " << cellSpr->GetZ() << " },\n";
+                    cellSprCount++;
+                }
+
+                cellCount++;
+            }
+        }
+
+        out << "    // " << anims.fileName << "\n";
+        if (!sorted.empty())
+            out << "    static constexpr dfp::embedded::Anim " << anims.symbol << "_anim[] =\n    {\n" << animText.str() << "    };\n";
+        if (cellCount)
+            out << "    static constexpr dfp::embedded::Cell " << anims.symbol << "_cell[] =\n    {\n" << cellText.str() << "    };\n";
+        if (cellSprCount)
+            out << "    static constexpr dfp::embedded::CellSpr " << anims.symbol << "_cellspr[] =\n    {\n" << cellSprText.str() << "    };\n";
+
+        out << "    static constexpr dfp::embedded::Animations " << anims.symbol << " =\n    {\n"
+            << "        " << Quote(anims.animations->GetSpriteFileName(true)) << ", "
+            << (anims.sheet >= 0 ? "&" + sheets[anims.sheet].symbol : std::string("nullptr")) << ",\n"
+            << "        " << (sorted.empty() ? "nullptr" : anims.symbol + "_anim") << ", " << sorted.size() << ",\n"
+            << "        " << (cellCount ? anims.symbol + "_cell" : std::string("nullptr")) << ", " << cellCount << ",\n"
+            << "        " << (cellSprCount ? anims.symbol + "_cellspr" : std::string("nullptr")) << ", " << cellSprCount << "\n"
+            << "    };\n\n";
+
+        return true;
+    }
+
+    void PrintUsage()
+    {
+        printf("Usage: dfp-embed -o <output.h> [-n <namespace>] <file.sprites|file.anim> ...\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string outputFileName;
+    std::string nameSpace = "dfp_assets";
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outputFileName = argv[++i];
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            nameSpace = argv[++i];
+        else
+            inputs.push_back(argv[i]);
+    }
+
+    if (outputFileName.empty() || inputs.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<SheetOut> sheets;
+    std::vector<AnimationsOut> animations;
+
+    for (const auto& input : inputs)
+    {
+        std::string extension = GetExtension(input);
+        if (extension == "sprites")
+        {
+            if (AddSheet(sheets, input) < 0)
+                return 1;
+        }
+        else if (extension == "anim")
+        {
+            AnimationsOut anims;
+            anims.fileName = input;
+            anims.symbol = MakeSymbol(input);
+            anims.animations = std::make_shared<dfp::Animations>();
+
+            dfp::ParseResult result = anims.animations->ParseFile(input);
+            if (result != dfp::ParseResult::OK)
+            {
+                fprintf(stderr, "dfp-embed: cannot parse '%s' (error %d) %s\n", input.c_str(), (int)result, anims.animations->GetErrorText().c_str());
+                return 1;
+            }
+
+            anims.sheet = AddSheet(sheets, anims.animations->GetSpriteFileName());
+            if (anims.sheet < 0)
+                fprintf(stderr, "dfp-embed: warning: '%s' is embedded without its sprite sheet\n", input.c_str());
+
+            animations.push_back(anims);
+        }
+        else
+        {
+            fprintf(stderr, "dfp-embed: unknown file type '%s'\n", input.c_str());
+            return 1;
+        }
+    }
+
+    std::set<std::string> symbols;
+    for (const auto& sheet : sheets)
+        symbols.insert(sheet.symbol);
+    for (const auto& anims : animations)
+        symbols.insert(anims.symbol);
+    if (symbols.size() != sheets.size() + animations.size())
+    {
+        fprintf(stderr, "dfp-embed: two input files have the same name\n");
+        return 1;
+    }
+
+    std::string guard = "DFP_EMBEDDED_" + MakeSymbol(outputFileName);
+    std::transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+
+    std::ostringstream out;
+    out << "// Generated by dfp-embed. Do not edit.\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n\n"
+        << "#include \"DarkFunctionParser/Embedded.h\"\n\n"
+        << "namespace " << nameSpace << "\n{\n";
+
+    for (const auto& sheet : sheets)
+        WriteSheet(out, sheet);
+
+    for (const auto& anims : animations)
+        if (!WriteAnimations(out, anims, sheets))
+            return 1;
+
+    out << "}; //namespace " << nameSpace << "\n\n"
+        << "#endif //" << guard << "\n";
+
+    FILE* file = fopen(outputFileName.c_str(), "wb");
+    if (!file)
+    {
+        fprintf(stderr, "dfp-embed: cannot write '%s'\n", outputFileName.c_str());
+        return 1;
+    }
+
+    std::string text = out.str();
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+
+    return 0;
+}
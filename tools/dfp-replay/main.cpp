@@ -0,0 +1,256 @@
+/** dfp-replay
+* Replays a recording made with dfp::Recorder (see
+* include/DarkFunctionParser/Recorder.h) against the current build: the
+* anims are rebuilt from the delays in the file, then every GetAnim,
+* Update and GetCurrentCell of the session is done again, in the same
+* order. Each cell index is compared with the recorded one, a difference
+* is reported as an error (exit code 1). The time of the replay is the
+* best of all the iterations.
+*
+* Usage:
+*   dfp-replay [-n iterations] session.dfpr*/
+
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/Recorder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+namespace
+{
+    /** The counts of one replay */
+    struct Result
+    {
+        double seconds;
+        size_t spawns;
+        size_t updates;
+        size_t cells;
+        size_t mismatches;
+        size_t unknown;
+    };
+
+    bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        bool ok = size > 0;
+        if (ok)
+        {
+            data.resize((size_t)size);
+            ok = fread(data.data(), 1, data.size(), file) == data.size();
+        }
+
+        fclose(file);
+        return ok;
+    }
+
+    double Now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::string EscapeXml(const std::string& text)
+    {
+        std::string escaped;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            switch (text[i])
+            {
+            case '&': escaped += "&amp;"; break;
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '"': escaped += "&quot;"; break;
+            default: escaped += text[i]; break;
+            }
+        }
+        return escaped;
+    }
+
+    /** Build a document with only one anim, from an EVENT_ANIM.
+    * @return false if the current build cannot parse it. */
+    bool BuildAnim(const dfp::Recorder::Event& event, dfp::Animations& animations)
+    {
+        std::string xml = "<animations spriteSheet=\"replay.sprites\" ver=\"1.2\">\n";
+        xml += "<anim name=\"" + EscapeXml(event.name) + "\" loops=\"" + std::to_string(event.loops) + "\">\n";
+        for (size_t i = 0; i < event.delays.size(); i++)
+            xml += "<cell index=\"" + std::to_string(i) + "\" delay=\"" + std::to_string(event.delays[i]) + "\"/>\n";
+        xml += "</anim>\n</animations>\n";
+
+        if (animations.ParseText(xml) != dfp::ParseResult::OK)
+        {
+            fprintf(stderr, "Cannot build the anim '%s': %s\n", event.name.c_str(), animations.GetErrorText().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /** Do all the events once.
+    * @param report is true to print the mismatches. */
+    Result Replay(const std::vector<dfp::Recorder::Event>& events, const std::vector<std::unique_ptr<dfp::Animations> >& animations,
+        uint32_t instanceCount, bool report)
+    {
+        Result result;
+        memset(&result, 0, sizeof(result));
+
+        std::vector<std::shared_ptr<dfp::Anim> > instances(instanceCount + 1);
+
+        double start = Now();
+        for (size_t i = 0; i < events.size(); i++)
+        {
+            const dfp::Recorder::Event& event = events[i];
+            if (event.type == dfp::Recorder::EVENT_ANIM)
+                continue;
+
+            if (event.instance > instanceCount)
+            {
+                result.unknown++;
+                continue;
+            }
+            std::shared_ptr<dfp::Anim>& anim = instances[event.instance];
+
+            if (event.type == dfp::Recorder::EVENT_SPAWN)
+            {
+                const dfp::Animations* document = event.anim < animations.size() ? animations[event.anim].get() : nullptr;
+                if (document)
+                    anim = document->GetAnim(document->GetAnims().begin()->first);
+                result.spawns++;
+                continue;
+            }
+
+            if (!anim)
+            {
+                result.unknown++;
+                continue;
+            }
+
+            switch (event.type)
+            {
+            case dfp::Recorder::EVENT_UPDATE:
+            case dfp::Recorder::EVENT_UPDATE_REPEAT:
+                anim->Update(event.dtSeconds, event.animSpeedFactor);
+                result.updates++;
+                break;
+
+            case dfp::Recorder::EVENT_CELL:
+                anim->GetCurrentCell();
+                if (anim->GetCurrentCellIndex() != event.cellIndex)
+                {
+                    if (report && result.mismatches < 10)
+                        fprintf(stderr, "Event %u: the instance %u of '%s' is at the cell %u, it was %u\n",
+                            (unsigned)i, event.instance, anim->GetName().c_str(), anim->GetCurrentCellIndex(), event.cellIndex);
+                    result.mismatches++;
+                }
+                result.cells++;
+                break;
+
+            case dfp::Recorder::EVENT_RELEASE:
+                anim.reset();
+                break;
+
+            default:
+                break;
+            }
+        }
+        result.seconds = Now() - start;
+
+        return result;
+    }
+
+    void PrintUsage()
+    {
+        fprintf(stderr, "Usage: dfp-replay [-n iterations] session.dfpr\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 10;
+    std::string path;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (argv[i][0] == '-' || !path.empty())
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+            path = argv[i];
+    }
+
+    if (path.empty() || iterations < 1)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    if (!ReadFile(path, data))
+    {
+        fprintf(stderr, "Cannot read %s\n", path.c_str());
+        return 1;
+    }
+
+    std::vector<dfp::Recorder::Event> events;
+    if (dfp::Recorder::Decode(data.data(), data.size(), events) != dfp::ParseResult::OK)
+    {
+        fprintf(stderr, "%s is not a valid recording\n", path.c_str());
+        return 1;
+    }
+
+    /// The anims are indexed by their id in the file.
+    std::vector<std::unique_ptr<dfp::Animations> > animations;
+    uint32_t instanceCount = 0;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const dfp::Recorder::Event& event = events[i];
+        if (event.type == dfp::Recorder::EVENT_ANIM)
+        {
+            if (event.anim >= animations.size())
+                animations.resize(event.anim + 1);
+
+            animations[event.anim].reset(new dfp::Animations());
+            if (!BuildAnim(event, *animations[event.anim]))
+                return 1;
+        }
+        else if (event.type == dfp::Recorder::EVENT_SPAWN && event.instance > instanceCount)
+            instanceCount = event.instance;
+    }
+
+    Result best;
+    for (int it = 0; it < iterations; it++)
+    {
+        Result result = Replay(events, animations, instanceCount, it == 0);
+        if (it == 0 || result.seconds < best.seconds)
+            best = result;
+    }
+
+    printf("%u events, %u bytes, %u anims, %u instances\n", (unsigned)events.size(), (unsigned)data.size(),
+        (unsigned)(animations.empty() ? 0 : animations.size() - 1), (unsigned)best.spawns);
+    printf("%u updates, %u cells checked, best of %d: %.3f ms (%.1f ns/event)\n", (unsigned)best.updates, (unsigned)best.cells,
+        iterations, best.seconds * 1000.0, events.empty() ? 0.0 : best.seconds * 1e9 / events.size());
+
+    if (best.unknown)
+        printf("%u events for instances that were not spawned in the recording\n", (unsigned)best.unknown);
+
+    if (best.mismatches)
+    {
+        printf("%u cells are not the same as in the recording\n", (unsigned)best.mismatches);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,417 @@
+/** dfp-validate
+* Scans a directory tree, parses all the *.sprites and *.anim files in
+* parallel and checks them:
+*   - the files must parse;
+*   - the <spr> rects must be inside the image (w and h from <img>);
+*   - the sprite sheet from 'spriteSheet' must exist;
+*   - each <spr> from a <cell> must exist in the sprite sheet;
+*   - warnings for <anim> without cells and for cells with delay 0;
+*   - warnings for names with the same SprId or AnimId.
+* The report is written as JSON. The exit code is 1 if there are errors.
+*
+* Usage:
+*   dfp-validate [-j threads] [-o report.json] <directory> ...*/
+
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    /** One problem found in a file */
+    struct Issue
+    {
+        std::string file;
+        std::string severity;
+        std::string code;
+        std::string message;
+
+        bool operator<(const Issue& other) const
+        {
+            if (file != other.file)
+                return file < other.file;
+            if (code != other.code)
+                return code < other.code;
+            return message < other.message;
+        }
+    };
+
+    /** The issues are collected from all the threads */
+    class Report
+    {
+    public:
+
+        void Add(const std::string& file, const char* severity, const char* code, const std::string& message)
+        {
+            Issue issue;
+            issue.file = file;
+            issue.severity = severity;
+            issue.code = code;
+            issue.message = message;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_issues.push_back(issue);
+        }
+
+        std::vector<Issue>& GetIssues() { return m_issues; }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<Issue> m_issues;
+    };
+
+    bool EndsWith(const std::string& text, const char* suffix)
+    {
+        size_t size = strlen(suffix);
+        return text.size() >= size && text.compare(text.size() - size, size, suffix) == 0;
+    }
+
+    /** Find all the *.sprites and *.anim files */
+    void Scan(const std::string& directory, std::vector<std::string>& sprites, std::vector<std::string>& anims)
+    {
+#if defined(_WIN32)
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA((directory + "/*").c_str(), &data);
+        if (find == INVALID_HANDLE_VALUE)
+            return;
+
+        do
+        {
+            std::string name = data.cFileName;
+            if (name == "." || name == "..")
+                continue;
+
+            std::string path = directory + "/" + name;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                Scan(path, sprites, anims);
+            else if (EndsWith(name, ".sprites"))
+                sprites.push_back(path);
+            else if (EndsWith(name, ".anim"))
+                anims.push_back(path);
+        } while (FindNextFileA(find, &data));
+
+        FindClose(find);
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (!dir)
+            return;
+
+        while (struct dirent* entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+
+            std::string path = directory + "/" + name;
+            struct stat info;
+            if (stat(path.c_str(), &info) != 0)
+                continue;
+
+            if (S_ISDIR(info.st_mode))
+                Scan(path, sprites, anims);
+            else if (EndsWith(name, ".sprites"))
+                sprites.push_back(path);
+            else if (EndsWith(name, ".anim"))
+                anims.push_back(path);
+        }
+
+        closedir(dir);
+#endif
+    }
+
+    /** Remove "." and ".." from a path, so the same file has the same key */
+    std::string NormalizePath(const std::string& path)
+    {
+        std::vector<std::string> parts;
+        std::stringstream stream(path);
+        std::string part;
+        while (std::getline(stream, part, '/'))
+        {
+            if (part.empty() || part == ".")
+                continue;
+
+            if (part == ".." && !parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else
+                parts.push_back(part);
+        }
+
+        std::string result = (!path.empty() && path[0] == '/') ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            if (i)
+                result += "/";
+            result += parts[i];
+        }
+        return result;
+    }
+
+    /** Call job(i) for i in [0, count) from "threads" threads */
+    template <class Job>
+    void ParallelFor(size_t count, unsigned int threads, Job job)
+    {
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < threads; t++)
+        {
+            workers.push_back(std::thread([&]()
+            {
+                for (size_t i = next++; i < count; i = next++)
+                    job(i);
+            }));
+        }
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    std::string ToString(int value)
+    {
+        std::ostringstream out;
+        out << value;
+        return out.str();
+    }
+
+    std::string JsonQuote(const std::string& text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            switch (c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out += buffer;
+                }
+                else
+                    out += c;
+            }
+        }
+        out += "\"";
+        return out;
+    }
+
+    /** The numeric attributes are read with std::stoi, which throws
+    * on text that is not a number. Report it as a parse error. */
+    template <class Document>
+    dfp::ParseResult ParseSafe(Document& document, const std::string& file)
+    {
+        try
+        {
+            return document.ParseFile(file);
+        }
+        catch (const std::exception&)
+        {
+            return dfp::ParseResult::ERROR_NUMERIC_ATTRIBUTE_WRONG;
+        }
+    }
+
+    void ValidateSprite(const std::string& file, const dfp::Sprite& sprite, Report& report)
+    {
+        const unsigned int imageW = sprite.GetImageW();
+        const unsigned int imageH = sprite.GetImageH();
+
+        for (const auto& item : sprite.GetAllSprWithPath())
+        {
+            const std::shared_ptr<dfp::Spr>& spr = item.second;
+            if ((uint64_t)spr->GetX() + spr->GetW() > imageW || (uint64_t)spr->GetY() + spr->GetH() > imageH)
+            {
+                report.Add(file, "error", "rect_out_of_bounds", "<spr name='" + item.first + "'> is outside the image ("
+                    + ToString(imageW) + "x" + ToString(imageH) + ")");
+            }
+        }
+
+        for (const auto& path : sprite.GetIdCollisions())
+            report.Add(file, "warning", "id_collision", "<spr name='" + path + "'> has the same SprId as another sprite, it is found only by path");
+    }
+
+    void ValidateAnimations(const std::string& file, const dfp::Animations& animations,
+        const std::map<std::string, std::shared_ptr<dfp::Sprite> >& sheets, Report& report)
+    {
+        std::string sheetName = NormalizePath(animations.GetSpriteFileName());
+        auto sheetIt = sheets.find(sheetName);
+        const dfp::Sprite* sheet = (sheetIt == sheets.end()) ? nullptr : sheetIt->second.get();
+
+        if (!sheet)
+            report.Add(file, "error", "missing_sprite_sheet", "The sprite sheet '" + sheetName + "' is missing or cannot be parsed");
+
+        for (const auto& name : animations.GetIdCollisions())
+            report.Add(file, "warning", "id_collision", "<anim name='" + name + "'> has the same AnimId as another anim, it is found only by name");
+
+        for (const auto& item : animations.GetAnims())
+        {
+            const std::shared_ptr<dfp::Anim>& anim = item.second;
+            const std::vector< std::shared_ptr<dfp::Cell> >& cells = anim->GetCells();
+
+            if (cells.empty())
+                report.Add(file, "warning", "empty_anim", "<anim name='" + anim->GetName() + "'> has no cells");
+
+            for (const auto& cell : cells)
+            {
+                std::string where = "<anim name='" + anim->GetName() + "'> <cell index='" + ToString(cell->GetIndex()) + "'>";
+
+                if (cell->GetDelay() == 0)
+                    report.Add(file, "warning", "zero_delay", where + " has delay 0");
+
+                if (!sheet)
+                    continue;
+
+                for (const auto& cellSpr : cell->GetCellsSpr())
+                {
+                    if (!sheet->GetSpr(cellSpr->GetName()))
+                        report.Add(file, "error", "missing_sprite", where + " uses '" + cellSpr->GetName() + "' which is not in " + sheetName);
+                }
+            }
+        }
+    }
+
+    void PrintUsage()
+    {
+        printf("Usage: dfp-validate [-j threads] [-o report.json] <directory> ...\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int threads = std::thread::hardware_concurrency();
+    std::string outputFileName;
+    std::vector<std::string> directories;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = (unsigned int)atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outputFileName = argv[++i];
+        else
+            directories.push_back(argv[i]);
+    }
+
+    if (directories.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (threads == 0)
+        threads = 1;
+
+    std::vector<std::string> spriteFiles;
+    std::vector<std::string> animFiles;
+    for (const auto& directory : directories)
+        Scan(directory, spriteFiles, animFiles);
+
+    Report report;
+
+    /// Pass 1: all the sprite sheets, they are needed by the anims.
+    std::vector< std::shared_ptr<dfp::Sprite> > sprites(spriteFiles.size());
+    ParallelFor(spriteFiles.size(), threads, [&](size_t i)
+    {
+        std::shared_ptr<dfp::Sprite> sprite = std::make_shared<dfp::Sprite>();
+        dfp::ParseResult result = ParseSafe(*sprite, spriteFiles[i]);
+        if (result != dfp::ParseResult::OK)
+        {
+            report.Add(spriteFiles[i], "error", "parse_failed", "Error " + ToString(result) + ": " + sprite->GetErrorText());
+            return;
+        }
+
+        ValidateSprite(spriteFiles[i], *sprite, report);
+        sprites[i] = sprite;
+    });
+
+    std::map<std::string, std::shared_ptr<dfp::Sprite> > sheets;
+    for (size_t i = 0; i < spriteFiles.size(); i++)
+        if (sprites[i])
+            sheets[NormalizePath(spriteFiles[i])] = sprites[i];
+
+    /// Pass 2: the anims. The sheets are only read, so they are shared by all the threads.
+    ParallelFor(animFiles.size(), threads, [&](size_t i)
+    {
+        dfp::Animations animations;
+        dfp::ParseResult result = ParseSafe(animations, animFiles[i]);
+        if (result != dfp::ParseResult::OK)
+        {
+            report.Add(animFiles[i], "error", "parse_failed", "Error " + ToString(result) + ": " + animations.GetErrorText());
+            return;
+        }
+
+        ValidateAnimations(animFiles[i], animations, sheets, report);
+    });
+
+    std::vector<Issue>& issues = report.GetIssues();
+    std::sort(issues.begin(), issues.end());
+
+    int errors = 0;
+    int warnings = 0;
+    for (const auto& issue : issues)
+    {
+        if (issue.severity == "error")
+            errors++;
+        else
+            warnings++;
+    }
+
+    std::ostringstream out;
+    out << "{\n"
+        << "  \"spriteFiles\": " << spriteFiles.size() << ",\n"
+        << "  \"animFiles\": " << animFiles.size() << ",\n"
+        << "  \"errors\": " << errors << ",\n"
+        << "  \"warnings\": " << warnings << ",\n"
+        << "  \"issues\": [";
+    for (size_t i = 0; i < issues.size(); i++)
+    {
+        out << (i ? ",\n" : "\n")
+            << "    { \"file\": " << JsonQuote(issues[i].file)
+            << ", \"severity\": " << JsonQuote(issues[i].severity)
+            << ", \"code\": " << JsonQuote(issues[i].code)
+            << ", \"message\": " << JsonQuote(issues[i].message) << " }";
+    }
+    out << (issues.empty() ? "]\n" : "\n  ]\n") << "}\n";
+
+    std::string text = out.str();
+    if (outputFileName.empty())
+    {
+        fwrite(text.data(), 1, text.size(), stdout);
+    }
+    else
+    {
+        FILE* file = fopen(outputFileName.c_str(), "wb");
+        if (!file)
+        {
+            fprintf(stderr, "dfp-validate: cannot write '%s'\n", outputFileName.c_str());
+            return 1;
+        }
+        fwrite(text.data(), 1, text.size(), file);
+        fclose(file);
+    }
+
+    return errors ? 1 : 0;
+}
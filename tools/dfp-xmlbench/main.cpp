@@ -0,0 +1,412 @@
+/** dfp-xmlbench
+* Compares the XML backends (see include/DarkFunctionParser/XmlReader.h)
+* on a corpus of *.sprites and *.anim files. The files are loaded in
+* memory first, then for each backend that is built:
+*   - xml: the throughput of the parse alone (XmlDocument::Parse);
+*   - full: the throughput of Sprite/Animations::ParseBuffer;
+*   - dom: the heap used by the parsed documents, and the peak while parsing.
+* The documents built with each backend are compared with the ones of the
+* first backend (the image, the paths and rects of the sprites, the anims
+* with their cells and cell sprites), a difference is reported as an error
+* (exit code 1).
+*
+* Usage:
+*   dfp-xmlbench [-n iterations] [-b backend] <file or directory> ...*/
+
+#include "DarkFunctionParser/Sprite.h"
+#include "DarkFunctionParser/Animations.h"
+#include "DarkFunctionParser/XmlReader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+/// The heap used by the program, counted by the global new and delete.
+static std::atomic<size_t> s_liveBytes(0);
+static std::atomic<size_t> s_peakBytes(0);
+
+/// The size is stored before the block, the header keeps the alignment.
+static const size_t HEADER_SIZE = 16;
+
+void *operator new(size_t size)
+{
+    char *block = (char *)malloc(size + HEADER_SIZE);
+    if (!block)
+        throw std::bad_alloc();
+    *(size_t *)block = size;
+
+    size_t live = s_liveBytes.fetch_add(size) + size;
+    size_t peak = s_peakBytes.load();
+    while (live > peak && !s_peakBytes.compare_exchange_weak(peak, live))
+        ;
+    return block + HEADER_SIZE;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    if (!pointer)
+        return;
+    char *block = (char *)pointer - HEADER_SIZE;
+    s_liveBytes.fetch_sub(*(size_t *)block);
+    free(block);
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+/// The sized forms (C++14) are used by the compiler when they exist, the
+/// size of the block is read from its header anyway.
+void operator delete(void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+namespace
+{
+    /** One file of the corpus */
+    struct File
+    {
+        std::string path;
+        std::vector<char> data;
+        bool isSprite;
+
+        /** The content of the document built by the first backend */
+        std::string reference;
+    };
+
+    /** The results of one backend */
+    struct Result
+    {
+        double xmlSeconds;
+        double fullSeconds;
+        size_t domBytes;
+        size_t peakBytes;
+        size_t failures;
+        size_t mismatches;
+    };
+
+    bool EndsWith(const std::string& text, const char* suffix)
+    {
+        size_t size = strlen(suffix);
+        return text.size() >= size && text.compare(text.size() - size, size, suffix) == 0;
+    }
+
+    bool IsDocument(const std::string& path)
+    {
+        return EndsWith(path, ".sprites") || EndsWith(path, ".anim");
+    }
+
+    /** Find all the *.sprites and *.anim files */
+    void Scan(const std::string& directory, std::vector<std::string>& files)
+    {
+#if defined(_WIN32)
+        WIN32_FIND_DATAA data;
+        HANDLE find = FindFirstFileA((directory + "/*").c_str(), &data);
+        if (find == INVALID_HANDLE_VALUE)
+            return;
+
+        do
+        {
+            std::string name = data.cFileName;
+            if (name == "." || name == "..")
+                continue;
+
+            std::string path = directory + "/" + name;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                Scan(path, files);
+            else if (IsDocument(name))
+                files.push_back(path);
+        } while (FindNextFileA(find, &data));
+
+        FindClose(find);
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (!dir)
+            return;
+
+        while (struct dirent* entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+
+            std::string path = directory + "/" + name;
+            struct stat info;
+            if (stat(path.c_str(), &info) != 0)
+                continue;
+
+            if (S_ISDIR(info.st_mode))
+                Scan(path, files);
+            else if (IsDocument(name))
+                files.push_back(path);
+        }
+
+        closedir(dir);
+#endif
+    }
+
+    bool IsDirectory(const std::string& path)
+    {
+#if defined(_WIN32)
+        DWORD attributes = GetFileAttributesA(path.c_str());
+        return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+    }
+
+    bool ReadFile(const std::string& path, std::vector<char>& data)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        bool ok = size > 0;
+        if (ok)
+        {
+            data.resize((size_t)size);
+            ok = fread(data.data(), 1, data.size(), file) == data.size();
+        }
+
+        fclose(file);
+        return ok;
+    }
+
+    double Now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /** Build the document of a file with the selected backend.
+    * @param content if not null, gets all the content of the document
+    *        as text, so the documents of 2 backends can be compared.
+    * @return false if the parse failed. */
+    bool ParseDocument(const File& file, std::string* content)
+    {
+        std::ostringstream out;
+
+        if (file.isSprite)
+        {
+            dfp::Sprite sprite;
+            if (sprite.ParseBuffer(file.data.data(), file.data.size(), file.path) != dfp::ParseResult::OK)
+                return false;
+
+            if (content)
+            {
+                out << "img " << sprite.GetImageFileName(true) << " " << sprite.GetImageW() << " " << sprite.GetImageH() << "\n";
+                for (const auto& item : sprite.GetAllSprWithPath())
+                {
+                    const dfp::Spr& spr = *item.second;
+                    out << "spr " << item.first << " " << spr.GetX() << " " << spr.GetY() << " " << spr.GetW() << " " << spr.GetH() << "\n";
+                }
+                *content = out.str();
+            }
+            return true;
+        }
+
+        dfp::Animations animations;
+        if (animations.ParseBuffer(file.data.data(), file.data.size(), file.path) != dfp::ParseResult::OK)
+            return false;
+
+        if (content)
+        {
+            out << "animations " << animations.GetSpriteFileName(true) << "\n";
+            for (const auto& anim : animations.GetAnims())
+            {
+                out << "anim " << anim.first << " " << anim.second->GetLoops() << "\n";
+                for (const auto& cell : anim.second->GetCells())
+                {
+                    out << " cell " << cell->GetIndex() << " " << cell->GetDelay() << "\n";
+                    for (const auto& cellSpr : cell->GetCellsSpr())
+                        out << "  spr " << cellSpr->GetName() << " " << cellSpr->GetX() << " " << cellSpr->GetY() << " " << cellSpr->GetZ() << "\n";
+                }
+            }
+            *content = out.str();
+        }
+        return true;
+    }
+
+    Result Run(const dfp::XmlBackend* backend, const dfp::XmlBackend* reference, std::vector<File>& files, int iterations)
+    {
+        Result result;
+        memset(&result, 0, sizeof(result));
+
+        /// The heap of the documents, one at a time.
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            size_t before = s_liveBytes.load();
+            s_peakBytes.store(before);
+
+            std::unique_ptr<dfp::XmlDocument> doc(backend->CreateDocument());
+            if (!doc->Parse(files[i].data.data(), files[i].data.size()))
+            {
+                fprintf(stderr, "%s: %s: %s\n", backend->GetName(), files[i].path.c_str(), doc->GetErrorText().c_str());
+                result.failures++;
+            }
+
+            result.domBytes += s_liveBytes.load() - before;
+            size_t peak = s_peakBytes.load() - before;
+            if (peak > result.peakBytes)
+                result.peakBytes = peak;
+        }
+
+        double start = Now();
+        for (int it = 0; it < iterations; it++)
+        {
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                std::unique_ptr<dfp::XmlDocument> doc(backend->CreateDocument());
+                doc->Parse(files[i].data.data(), files[i].data.size());
+            }
+        }
+        result.xmlSeconds = Now() - start;
+
+        dfp::SetXmlBackend(backend);
+
+        /// The documents must be the same with all the backends.
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            std::string content;
+            ParseDocument(files[i], &content);
+            if (backend == reference)
+                files[i].reference = content;
+            else if (content != files[i].reference)
+            {
+                fprintf(stderr, "%s: %s: the document is not the same as with %s\n",
+                    backend->GetName(), files[i].path.c_str(), reference->GetName());
+                result.mismatches++;
+            }
+        }
+
+        start = Now();
+        for (int it = 0; it < iterations; it++)
+        {
+            for (size_t i = 0; i < files.size(); i++)
+                ParseDocument(files[i], nullptr);
+        }
+        result.fullSeconds = Now() - start;
+
+        dfp::SetXmlBackend(nullptr);
+        return result;
+    }
+
+    void PrintUsage()
+    {
+        fprintf(stderr, "Usage: dfp-xmlbench [-n iterations] [-b backend] <file or directory> ...\n");
+
+        fprintf(stderr, "Backends:");
+        std::vector<const dfp::XmlBackend*> backends = dfp::GetXmlBackends();
+        for (size_t i = 0; i < backends.size(); i++)
+            fprintf(stderr, " %s", backends[i]->GetName());
+        fprintf(stderr, "\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 20;
+    std::vector<const dfp::XmlBackend*> backends;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+        {
+            const dfp::XmlBackend* backend = dfp::FindXmlBackend(argv[++i]);
+            if (!backend)
+            {
+                fprintf(stderr, "The backend '%s' is not built\n", argv[i]);
+                PrintUsage();
+                return 1;
+            }
+            backends.push_back(backend);
+        }
+        else if (argv[i][0] == '-')
+        {
+            PrintUsage();
+            return 1;
+        }
+        else if (IsDirectory(argv[i]))
+            Scan(argv[i], paths);
+        else
+            paths.push_back(argv[i]);
+    }
+
+    if (paths.empty() || iterations < 1)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (backends.empty())
+        backends = dfp::GetXmlBackends();
+
+    std::vector<File> files;
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        File file;
+        file.path = paths[i];
+        file.isSprite = EndsWith(paths[i], ".sprites");
+        if (!ReadFile(paths[i], file.data))
+        {
+            fprintf(stderr, "Cannot read %s\n", paths[i].c_str());
+            return 1;
+        }
+
+        totalBytes += file.data.size();
+        files.push_back(file);
+    }
+
+    printf("%u files, %.2f MB, %d iterations\n", (unsigned)files.size(), totalBytes / (1024.0 * 1024.0), iterations);
+    printf("%-10s %12s %12s %12s %10s %12s\n", "backend", "xml MB/s", "full MB/s", "dom bytes", "dom/input", "peak bytes");
+
+    double megabytes = (double)totalBytes * iterations / (1024.0 * 1024.0);
+    bool errors = false;
+    for (size_t b = 0; b < backends.size(); b++)
+    {
+        Result result = Run(backends[b], backends[0], files, iterations);
+        errors = errors || result.failures != 0 || result.mismatches != 0;
+
+        printf("%-10s %12.1f %12.1f %12u %10.2f %12u\n", backends[b]->GetName(),
+            result.xmlSeconds > 0 ? megabytes / result.xmlSeconds : 0.0,
+            result.fullSeconds > 0 ? megabytes / result.fullSeconds : 0.0,
+            (unsigned)result.domBytes, totalBytes ? (double)result.domBytes / totalBytes : 0.0,
+            (unsigned)result.peakBytes);
+    }
+
+    return errors ? 1 : 0;
+}